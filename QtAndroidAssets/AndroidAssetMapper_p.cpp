@@ -0,0 +1,170 @@
+/*
+  Memory mapping of Android assets for QFile::map()
+
+  Author:
+  Sergey A. Galin <sergey.galin@gmail.com>
+
+  Distrbuted under The LGPL License
+
+  Copyright (c) 2015, DoubleGIS, LLC.
+  All rights reserved.
+
+  GNU Lesser General Public License Usage
+  This file is be used under the terms of the GNU Lesser
+  General Public License version 2.1 or version 3 as published by the Free
+  Software Foundation and appearing in the file LICENSE.LGPLv21 and
+  LICENSE.LGPLv3 included in the packaging of this file. Please review the
+  following information to ensure the GNU Lesser General Public License
+  requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+  http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+*/
+
+#include <errno.h>
+#include <string.h>
+#include <sys/mman.h>
+#include <unistd.h>
+#include <algorithm>
+#include "AndroidAssetMapper_p.h"
+
+AndroidAssetMapper::AndroidAssetMapper()
+    : m_error(NoError)
+    , m_systemError(0)
+{
+}
+
+AndroidAssetMapper::~AndroidAssetMapper()
+{
+    for (std::map<unsigned char *, Mapping>::const_iterator it = m_maps.begin(); it != m_maps.end(); ++it) {
+        if (it->second.start)
+            munmap(it->second.start, it->second.length);
+    }
+    m_maps.clear();
+    for (size_t i = 0; i < m_retainedAssets.size(); ++i)
+        AAsset_close(m_retainedAssets[i]);
+    m_retainedAssets.clear();
+}
+
+const char *AndroidAssetMapper::errorString() const
+{
+    switch (m_error) {
+    case NoError:
+        return "No error";
+    case NotOpenError:
+        return "Asset is not open";
+    case InvalidRangeError:
+        return "Invalid offset or size";
+    case PrivateCompressedError:
+        return "Private mapping of a compressed asset is not supported";
+    case BufferError:
+        return "Failed to get asset buffer";
+    case NotMappedError:
+        return "Not mapped";
+    case UnmapError:
+        return strerror(m_systemError);
+    }
+    return "Unknown error";
+}
+
+unsigned char *AndroidAssetMapper::fail(Error error, int systemError)
+{
+    m_error = error;
+    m_systemError = systemError;
+    return 0;
+}
+
+bool AndroidAssetMapper::hasBufferMaps(AAsset *asset) const
+{
+    for (std::map<unsigned char *, Mapping>::const_iterator it = m_maps.begin(); it != m_maps.end(); ++it) {
+        if (!it->second.start && it->second.asset == asset)
+            return true;
+    }
+    return false;
+}
+
+unsigned char *AndroidAssetMapper::map(AAsset *asset, long long offset, long long size, bool isPrivate)
+{
+    if (!asset)
+        return fail(NotOpenError);
+    const long long length = AAsset_getLength(asset);
+    if (offset < 0 || size <= 0 || offset + size > length)
+        return fail(InvalidRangeError);
+
+    // Uncompressed assets are stored in the package as is: map them directly from the file.
+    off_t start = 0;
+    off_t fdLength = 0;
+    int fd = AAsset_openFileDescriptor(asset, &start, &fdLength);
+    if (fd >= 0) {
+        const long long pageSize = sysconf(_SC_PAGESIZE);
+        const long long fileOffset = static_cast<long long>(start) + offset;
+        const long long extra = fileOffset % pageSize;
+        const size_t mapLength = static_cast<size_t>(size + extra);
+        void *mapAddress = mmap(0, mapLength,
+                                isPrivate ? PROT_READ | PROT_WRITE : PROT_READ,
+                                isPrivate ? MAP_PRIVATE : MAP_SHARED,
+                                fd, static_cast<off_t>(fileOffset - extra));
+        ::close(fd);
+        if (mapAddress != MAP_FAILED) {
+            unsigned char *address = static_cast<unsigned char *>(mapAddress) + extra;
+            Mapping mapping = { mapAddress, mapLength, asset, 1 };
+            m_maps[address] = mapping;
+            return address;
+        }
+        // Falling back to the buffer
+    }
+
+    // Compressed asset: AAsset_getBuffer() inflates it once and keeps the data
+    // until the asset is closed. The buffer must not be written to.
+    if (isPrivate)
+        return fail(PrivateCompressedError);
+    const void *buffer = AAsset_getBuffer(asset);
+    if (!buffer)
+        return fail(BufferError);
+    unsigned char *address = const_cast<unsigned char *>(static_cast<const unsigned char *>(buffer)) + offset;
+    std::map<unsigned char *, Mapping>::iterator it = m_maps.find(address);
+    if (it != m_maps.end()) {
+        // The same part of the buffer mapped again
+        ++it->second.refs;
+    } else {
+        Mapping mapping = { 0, 0, asset, 1 };
+        m_maps[address] = mapping;
+    }
+    return address;
+}
+
+bool AndroidAssetMapper::unmap(unsigned char *address)
+{
+    std::map<unsigned char *, Mapping>::iterator it = m_maps.find(address);
+    if (it == m_maps.end()) {
+        fail(NotMappedError);
+        return false;
+    }
+    if (--it->second.refs > 0)
+        return true;
+    const Mapping mapping = it->second;
+    m_maps.erase(it);
+    if (mapping.start) {
+        if (munmap(mapping.start, mapping.length) == -1) {
+            fail(UnmapError, errno);
+            return false;
+        }
+        return true;
+    }
+    std::vector<AAsset *>::iterator retained = std::find(m_retainedAssets.begin(), m_retainedAssets.end(), mapping.asset);
+    if (retained != m_retainedAssets.end() && !hasBufferMaps(mapping.asset)) {
+        m_retainedAssets.erase(retained);
+        AAsset_close(mapping.asset);
+    }
+    return true;
+}
+
+void AndroidAssetMapper::closeAsset(AAsset *asset)
+{
+    if (!asset)
+        return;
+    if (hasBufferMaps(asset)) {
+        if (std::find(m_retainedAssets.begin(), m_retainedAssets.end(), asset) == m_retainedAssets.end())
+            m_retainedAssets.push_back(asset);
+    } else {
+        AAsset_close(asset);
+    }
+}
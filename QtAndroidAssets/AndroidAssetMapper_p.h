@@ -0,0 +1,93 @@
+/*
+  Memory mapping of Android assets for QFile::map()
+
+  Author:
+  Sergey A. Galin <sergey.galin@gmail.com>
+
+  Distrbuted under The LGPL License
+
+  Copyright (c) 2015, DoubleGIS, LLC.
+  All rights reserved.
+
+  GNU Lesser General Public License Usage
+  This file is be used under the terms of the GNU Lesser
+  General Public License version 2.1 or version 3 as published by the Free
+  Software Foundation and appearing in the file LICENSE.LGPLv21 and
+  LICENSE.LGPLv3 included in the packaging of this file. Please review the
+  following information to ensure the GNU Lesser General Public License
+  requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+  http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+*/
+
+#pragma once
+
+#include <stddef.h>
+#include <map>
+#include <vector>
+#include <android/asset_manager.h>
+
+/*
+    Maps parts of AAssets into memory for AndroidAbstractFileEngine's MapExtension.
+
+    Uncompressed assets are mmap()'ed straight from the package file, so the data is
+    never copied. Compressed assets use AAsset_getBuffer(), which inflates the whole
+    asset once and keeps it until the asset is closed; such mappings of the same
+    address are reference counted, and an asset passed to closeAsset() while its buffer
+    is mapped is kept open until the last of its mappings is unmapped.
+
+    Only the NDK asset API and POSIX are used, so it can be tested on a host.
+    Not thread-safe, like the file engine which owns it.
+*/
+class AndroidAssetMapper
+{
+public:
+    enum Error {
+        NoError,
+        NotOpenError,
+        InvalidRangeError,
+        PrivateCompressedError,
+        BufferError,
+        NotMappedError,
+        UnmapError
+    };
+
+    AndroidAssetMapper();
+    // Unmaps all regions and closes the retained assets.
+    ~AndroidAssetMapper();
+
+    unsigned char *map(AAsset *asset, long long offset, long long size, bool isPrivate);
+    bool unmap(unsigned char *address);
+
+    // AAsset_close() the asset now, or when its last buffer mapping is unmapped.
+    void closeAsset(AAsset *asset);
+
+    // Error of the last failed map() or unmap(); for UnmapError errno is saved as well.
+    Error error() const { return m_error; }
+    int systemError() const { return m_systemError; }
+    const char *errorString() const;
+
+    size_t mappingCount() const { return m_maps.size(); }
+    size_t retainedAssetCount() const { return m_retainedAssets.size(); }
+
+private:
+    // For mmap()'ed regions, start and length are the page aligned region passed to
+    // munmap(); for AAsset_getBuffer() ones, start is 0 and refs counts the map() calls.
+    struct Mapping
+    {
+        void *start;
+        size_t length;
+        AAsset *asset;
+        int refs;
+    };
+
+    bool hasBufferMaps(AAsset *asset) const;
+    unsigned char *fail(Error error, int systemError = 0);
+
+    std::map<unsigned char *, Mapping> m_maps;
+    std::vector<AAsset *> m_retainedAssets;
+    Error m_error;
+    int m_systemError;
+
+    AndroidAssetMapper(const AndroidAssetMapper &);
+    AndroidAssetMapper &operator=(const AndroidAssetMapper &);
+};
@@ -40,6 +40,7 @@
 #include <QtCore/QCoreApplication>
 #include <QtCore/QDataStream>
 #include <QtCore/QVector>
+#include "AndroidAssetMapper_p.h"
 #include "AndroidAssetsFileEngineHandler_p.h"
 
 typedef QVector<QString> FilesList;
@@ -131,6 +132,7 @@ public:
 
     ~AndroidAbstractFileEngine()
     {
+        // m_mapper unmaps the remaining regions and closes the asset if it still has them
         close();
     }
 
@@ -144,7 +146,9 @@ public:
     virtual bool close()
     {
         if (m_assetFile) {
-            AAsset_close(m_assetFile);
+            // Memory returned by AAsset_getBuffer() belongs to the asset, so the mapper
+            // keeps it until the last such mapping is gone (mmap()'ed regions survive close).
+            m_mapper.closeAsset(m_assetFile);
             m_assetFile = 0;
             return true;
         }
@@ -249,8 +253,53 @@ public:
         return 0;
     }
 
+    virtual bool extension(Extension extension, const ExtensionOption *option = 0, ExtensionReturn *output = 0)
+    {
+        if (extension == MapExtension) {
+            const MapExtensionOption *options = static_cast<const MapExtensionOption *>(option);
+            MapExtensionReturn *returnValue = static_cast<MapExtensionReturn *>(output);
+            returnValue->address = m_mapper.map(m_assetFile, options->offset, options->size,
+                                                (options->flags & QFile::MapPrivateOption) != 0);
+            if (!returnValue->address)
+                setMapperError();
+            return returnValue->address != 0;
+        }
+        if (extension == UnMapExtension) {
+            const UnMapExtensionOption *options = static_cast<const UnMapExtensionOption *>(option);
+            if (!m_mapper.unmap(options->address)) {
+                setMapperError();
+                return false;
+            }
+            return true;
+        }
+        return false;
+    }
+
+    virtual bool supportsExtension(Extension extension) const
+    {
+        return extension == MapExtension || extension == UnMapExtension;
+    }
+
 private:
+    void setMapperError()
+    {
+        QFile::FileError error = QFile::UnspecifiedError;
+        switch (m_mapper.error()) {
+        case AndroidAssetMapper::NotOpenError:
+        case AndroidAssetMapper::NotMappedError:
+            error = QFile::PermissionsError;
+            break;
+        case AndroidAssetMapper::BufferError:
+            error = QFile::ReadError;
+            break;
+        default:
+            break;
+        }
+        setError(error, QString::fromLocal8Bit(m_mapper.errorString()));
+    }
+
     AAsset *m_assetFile;
+    AndroidAssetMapper m_mapper;
     QSharedPointer<AndroidAssetDir> m_assetDir;
     QString m_fileName;
 };
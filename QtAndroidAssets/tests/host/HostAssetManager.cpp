@@ -0,0 +1,127 @@
+/*
+  Host stand-in for the NDK asset manager
+
+  Author:
+  Sergey A. Galin <sergey.galin@gmail.com>
+
+  Distrbuted under The LGPL License
+
+  Copyright (c) 2015, DoubleGIS, LLC.
+  All rights reserved.
+
+  GNU Lesser General Public License Usage
+  This file is be used under the terms of the GNU Lesser
+  General Public License version 2.1 or version 3 as published by the Free
+  Software Foundation and appearing in the file LICENSE.LGPLv21 and
+  LICENSE.LGPLv3 included in the packaging of this file. Please review the
+  following information to ensure the GNU Lesser General Public License
+  requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+  http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+*/
+
+#include <fcntl.h>
+#include <stdlib.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#include <string>
+#include <android/asset_manager.h>
+
+struct AAssetManager
+{
+    std::string root;
+    bool compressed;
+    int openAssets;
+};
+
+struct AAsset
+{
+    AAssetManager *manager;
+    int fd;
+    off_t length;
+    void *buffer;
+};
+
+AAssetManager *hostAssetManagerCreate(const char *rootDir, bool compressed)
+{
+    AAssetManager *mgr = new AAssetManager;
+    mgr->root = rootDir;
+    mgr->compressed = compressed;
+    mgr->openAssets = 0;
+    return mgr;
+}
+
+void hostAssetManagerDestroy(AAssetManager *mgr)
+{
+    delete mgr;
+}
+
+int hostAssetManagerOpenAssets(AAssetManager *mgr)
+{
+    return mgr->openAssets;
+}
+
+AAsset *AAssetManager_open(AAssetManager *mgr, const char *filename, int /*mode*/)
+{
+    const std::string path = mgr->root + "/" + filename;
+    int fd = open(path.c_str(), O_RDONLY);
+    if (fd < 0)
+        return 0;
+    struct stat st;
+    if (fstat(fd, &st) != 0 || !S_ISREG(st.st_mode)) {
+        close(fd);
+        return 0;
+    }
+    AAsset *asset = new AAsset;
+    asset->manager = mgr;
+    asset->fd = fd;
+    asset->length = st.st_size;
+    asset->buffer = 0;
+    ++mgr->openAssets;
+    return asset;
+}
+
+off_t AAsset_getLength(AAsset *asset)
+{
+    return asset->length;
+}
+
+int AAsset_read(AAsset *asset, void *buf, size_t count)
+{
+    return static_cast<int>(read(asset->fd, buf, count));
+}
+
+off_t AAsset_seek(AAsset *asset, off_t offset, int whence)
+{
+    return lseek(asset->fd, offset, whence);
+}
+
+const void *AAsset_getBuffer(AAsset *asset)
+{
+    if (!asset->buffer) {
+        // Like inflating a compressed entry: a private copy that lives until AAsset_close()
+        void *buffer = malloc(asset->length > 0 ? static_cast<size_t>(asset->length) : 1);
+        if (!buffer || pread(asset->fd, buffer, static_cast<size_t>(asset->length), 0) != asset->length) {
+            free(buffer);
+            return 0;
+        }
+        asset->buffer = buffer;
+    }
+    return asset->buffer;
+}
+
+int AAsset_openFileDescriptor(AAsset *asset, off_t *outStart, off_t *outLength)
+{
+    if (asset->manager->compressed)
+        return -1;
+    *outStart = 0;
+    *outLength = asset->length;
+    return dup(asset->fd);
+}
+
+void AAsset_close(AAsset *asset)
+{
+    --asset->manager->openAssets;
+    close(asset->fd);
+    free(asset->buffer);
+    delete asset;
+}
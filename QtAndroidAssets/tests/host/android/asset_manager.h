@@ -0,0 +1,57 @@
+/*
+  Host stand-in for the NDK asset manager
+
+  Author:
+  Sergey A. Galin <sergey.galin@gmail.com>
+
+  Distrbuted under The LGPL License
+
+  Copyright (c) 2015, DoubleGIS, LLC.
+  All rights reserved.
+
+  GNU Lesser General Public License Usage
+  This file is be used under the terms of the GNU Lesser
+  General Public License version 2.1 or version 3 as published by the Free
+  Software Foundation and appearing in the file LICENSE.LGPLv21 and
+  LICENSE.LGPLv3 included in the packaging of this file. Please review the
+  following information to ensure the GNU Lesser General Public License
+  requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+  http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+*/
+
+#pragma once
+
+// Replaces <android/asset_manager.h> in host tests. The assets are the files of a
+// directory; see HostAssetManager.cpp.
+
+#include <stddef.h>
+#include <sys/types.h>
+
+struct AAssetManager;
+typedef struct AAssetManager AAssetManager;
+
+struct AAsset;
+typedef struct AAsset AAsset;
+
+enum {
+    AASSET_MODE_UNKNOWN = 0,
+    AASSET_MODE_RANDOM = 1,
+    AASSET_MODE_STREAMING = 2,
+    AASSET_MODE_BUFFER = 3
+};
+
+AAsset *AAssetManager_open(AAssetManager *mgr, const char *filename, int mode);
+
+off_t AAsset_getLength(AAsset *asset);
+int AAsset_read(AAsset *asset, void *buf, size_t count);
+off_t AAsset_seek(AAsset *asset, off_t offset, int whence);
+const void *AAsset_getBuffer(AAsset *asset);
+int AAsset_openFileDescriptor(AAsset *asset, off_t *outStart, off_t *outLength);
+void AAsset_close(AAsset *asset);
+
+// Host only: assets of a "compressed" manager can't be opened as a file descriptor,
+// like the deflated entries of an APK, and AAsset_getBuffer() reads them into memory.
+AAssetManager *hostAssetManagerCreate(const char *rootDir, bool compressed);
+void hostAssetManagerDestroy(AAssetManager *mgr);
+// Number of assets opened and not closed yet, for leak checks.
+int hostAssetManagerOpenAssets(AAssetManager *mgr);
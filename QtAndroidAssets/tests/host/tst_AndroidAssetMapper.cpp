@@ -0,0 +1,287 @@
+/*
+  Host test of AndroidAssetMapper
+
+  Author:
+  Sergey A. Galin <sergey.galin@gmail.com>
+
+  Distrbuted under The LGPL License
+
+  Copyright (c) 2015, DoubleGIS, LLC.
+  All rights reserved.
+
+  GNU Lesser General Public License Usage
+  This file is be used under the terms of the GNU Lesser
+  General Public License version 2.1 or version 3 as published by the Free
+  Software Foundation and appearing in the file LICENSE.LGPLv21 and
+  LICENSE.LGPLv3 included in the packaging of this file. Please review the
+  following information to ensure the GNU Lesser General Public License
+  requirements will be met: https://www.gnu.org/licenses/lgpl.html and
+  http://www.gnu.org/licenses/old-licenses/lgpl-2.1.html.
+*/
+
+// The assets are served from a temporary directory by the stand-in asset manager
+// (HostAssetManager.cpp): "uncompressed" ones are mmap()'ed, "compressed" ones
+// go through AAsset_getBuffer().
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <string>
+#include <android/asset_manager.h>
+#include "AndroidAssetMapper_p.h"
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+    do { \
+        if (!(condition)) { \
+            fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+            ++s_failures; \
+        } \
+    } while (0)
+
+static const char c_assetName[] = "data.bin";
+static const long long c_assetSize = 3 * 4096 + 123;
+
+static std::string s_rootDir;
+static AAssetManager *s_plain = 0;
+static AAssetManager *s_compressed = 0;
+
+static unsigned char expectedByte(long long offset)
+{
+    return static_cast<unsigned char>((offset * 7 + 3) & 0xff);
+}
+
+static bool contentMatches(const unsigned char *data, long long offset, long long size)
+{
+    for (long long i = 0; i < size; ++i) {
+        if (data[i] != expectedByte(offset + i))
+            return false;
+    }
+    return true;
+}
+
+static bool createAssets()
+{
+    char dir[] = "/tmp/tst_AndroidAssetMapper.XXXXXX";
+    if (!mkdtemp(dir))
+        return false;
+    s_rootDir = dir;
+    const std::string path = s_rootDir + "/" + c_assetName;
+    FILE *file = fopen(path.c_str(), "wb");
+    if (!file)
+        return false;
+    for (long long i = 0; i < c_assetSize; ++i)
+        fputc(expectedByte(i), file);
+    fclose(file);
+    s_plain = hostAssetManagerCreate(s_rootDir.c_str(), false);
+    s_compressed = hostAssetManagerCreate(s_rootDir.c_str(), true);
+    return true;
+}
+
+static void removeAssets()
+{
+    hostAssetManagerDestroy(s_plain);
+    hostAssetManagerDestroy(s_compressed);
+    unlink((s_rootDir + "/" + c_assetName).c_str());
+    rmdir(s_rootDir.c_str());
+}
+
+static AAsset *openAsset(AAssetManager *mgr)
+{
+    return AAssetManager_open(mgr, c_assetName, AASSET_MODE_RANDOM);
+}
+
+static void testUncompressedMap()
+{
+    AndroidAssetMapper mapper;
+    AAsset *asset = openAsset(s_plain);
+    CHECK(asset != 0);
+
+    // Neither the offset nor the size is page aligned
+    const long long offset = 4096 + 17;
+    const long long size = 5000;
+    unsigned char *data = mapper.map(asset, offset, size, false);
+    CHECK(data != 0);
+    CHECK(data && contentMatches(data, offset, size));
+    CHECK(mapper.mappingCount() == 1);
+
+    // The mmap()'ed region doesn't need the asset
+    mapper.closeAsset(asset);
+    CHECK(hostAssetManagerOpenAssets(s_plain) == 0);
+    CHECK(mapper.retainedAssetCount() == 0);
+    CHECK(data && contentMatches(data, offset, size));
+    CHECK(mapper.unmap(data));
+    CHECK(mapper.mappingCount() == 0);
+}
+
+static void testPrivateMap()
+{
+    AndroidAssetMapper mapper;
+    AAsset *asset = openAsset(s_plain);
+    unsigned char *data = mapper.map(asset, 10, 100, true);
+    CHECK(data != 0);
+    if (data) {
+        data[0] = static_cast<unsigned char>(~expectedByte(10));
+        CHECK(contentMatches(data + 1, 11, 99));
+    }
+
+    // Not written through to the package
+    unsigned char *shared = mapper.map(asset, 10, 100, false);
+    CHECK(shared != 0);
+    CHECK(shared && contentMatches(shared, 10, 100));
+    CHECK(mapper.unmap(data));
+    CHECK(mapper.unmap(shared));
+    mapper.closeAsset(asset);
+    CHECK(hostAssetManagerOpenAssets(s_plain) == 0);
+}
+
+static void testCompressedSameOffset()
+{
+    AndroidAssetMapper mapper;
+    AAsset *asset = openAsset(s_compressed);
+    CHECK(asset != 0);
+
+    const long long offset = 100;
+    const long long size = 200;
+    unsigned char *first = mapper.map(asset, offset, size, false);
+    unsigned char *second = mapper.map(asset, offset, size, false);
+    CHECK(first != 0);
+    CHECK(first == second); // Both point into the buffer of the asset
+    CHECK(mapper.mappingCount() == 1);
+
+    mapper.closeAsset(asset);
+    CHECK(mapper.retainedAssetCount() == 1);
+    CHECK(hostAssetManagerOpenAssets(s_compressed) == 1);
+
+    // The second mapping is still in use
+    CHECK(mapper.unmap(first));
+    CHECK(mapper.retainedAssetCount() == 1);
+    CHECK(hostAssetManagerOpenAssets(s_compressed) == 1);
+    CHECK(second && contentMatches(second, offset, size));
+
+    CHECK(mapper.unmap(second));
+    CHECK(mapper.mappingCount() == 0);
+    CHECK(mapper.retainedAssetCount() == 0);
+    CHECK(hostAssetManagerOpenAssets(s_compressed) == 0);
+
+    // Not mapped anymore
+    CHECK(!mapper.unmap(second));
+    CHECK(mapper.error() == AndroidAssetMapper::NotMappedError);
+}
+
+static void testCompressedDifferentOffsets()
+{
+    AndroidAssetMapper mapper;
+    AAsset *asset = openAsset(s_compressed);
+    unsigned char *first = mapper.map(asset, 0, 10, false);
+    unsigned char *second = mapper.map(asset, c_assetSize - 10, 10, false);
+    CHECK(first != 0);
+    CHECK(second != 0);
+    CHECK(second && contentMatches(second, c_assetSize - 10, 10));
+
+    // An asset without buffer mappings is closed right away
+    CHECK(mapper.unmap(first));
+    CHECK(mapper.unmap(second));
+    mapper.closeAsset(asset);
+    CHECK(mapper.retainedAssetCount() == 0);
+    CHECK(hostAssetManagerOpenAssets(s_compressed) == 0);
+}
+
+static void testReopenedAssetsAreRetained()
+{
+    // The file engine closes an asset, then is reopened and closed again,
+    // each time with a buffer mapping left.
+    AndroidAssetMapper mapper;
+    AAsset *first = openAsset(s_compressed);
+    unsigned char *firstData = mapper.map(first, 0, 16, false);
+    CHECK(firstData != 0);
+    mapper.closeAsset(first);
+
+    AAsset *second = openAsset(s_compressed);
+    unsigned char *secondData = mapper.map(second, 0, 16, false);
+    CHECK(secondData != 0);
+    CHECK(secondData != firstData);
+    mapper.closeAsset(second);
+
+    CHECK(mapper.retainedAssetCount() == 2);
+    CHECK(hostAssetManagerOpenAssets(s_compressed) == 2);
+    CHECK(firstData && contentMatches(firstData, 0, 16));
+
+    CHECK(mapper.unmap(secondData));
+    CHECK(hostAssetManagerOpenAssets(s_compressed) == 1);
+    CHECK(firstData && contentMatches(firstData, 0, 16));
+    CHECK(mapper.unmap(firstData));
+    CHECK(mapper.retainedAssetCount() == 0);
+    CHECK(hostAssetManagerOpenAssets(s_compressed) == 0);
+}
+
+static void testErrors()
+{
+    AndroidAssetMapper mapper;
+    CHECK(mapper.map(0, 0, 1, false) == 0);
+    CHECK(mapper.error() == AndroidAssetMapper::NotOpenError);
+
+    AAsset *asset = openAsset(s_plain);
+    CHECK(mapper.map(asset, -1, 10, false) == 0);
+    CHECK(mapper.error() == AndroidAssetMapper::InvalidRangeError);
+    CHECK(mapper.map(asset, 0, 0, false) == 0);
+    CHECK(mapper.error() == AndroidAssetMapper::InvalidRangeError);
+    CHECK(mapper.map(asset, c_assetSize - 10, 11, false) == 0);
+    CHECK(mapper.error() == AndroidAssetMapper::InvalidRangeError);
+    mapper.closeAsset(asset);
+
+    AAsset *compressed = openAsset(s_compressed);
+    CHECK(mapper.map(compressed, 0, 10, true) == 0);
+    CHECK(mapper.error() == AndroidAssetMapper::PrivateCompressedError);
+    CHECK(strlen(mapper.errorString()) > 0);
+    mapper.closeAsset(compressed);
+
+    unsigned char byte = 0;
+    CHECK(!mapper.unmap(&byte));
+    CHECK(mapper.error() == AndroidAssetMapper::NotMappedError);
+    CHECK(mapper.mappingCount() == 0);
+    CHECK(hostAssetManagerOpenAssets(s_plain) == 0);
+    CHECK(hostAssetManagerOpenAssets(s_compressed) == 0);
+}
+
+static void testDestructorReleasesEverything()
+{
+    {
+        AndroidAssetMapper mapper;
+        AAsset *plain = openAsset(s_plain);
+        CHECK(mapper.map(plain, 1, 4096, false) != 0);
+        mapper.closeAsset(plain);
+
+        AAsset *compressed = openAsset(s_compressed);
+        CHECK(mapper.map(compressed, 1, 10, false) != 0);
+        CHECK(mapper.map(compressed, 1, 10, false) != 0);
+        mapper.closeAsset(compressed);
+        CHECK(hostAssetManagerOpenAssets(s_compressed) == 1);
+    }
+    CHECK(hostAssetManagerOpenAssets(s_plain) == 0);
+    CHECK(hostAssetManagerOpenAssets(s_compressed) == 0);
+}
+
+int main()
+{
+    if (!createAssets()) {
+        fprintf(stderr, "tst_AndroidAssetMapper: failed to create the test assets\n");
+        return 1;
+    }
+    testUncompressedMap();
+    testPrivateMap();
+    testCompressedSameOffset();
+    testCompressedDifferentOffsets();
+    testReopenedAssetsAreRetained();
+    testErrors();
+    testDestructorReleasesEverything();
+    removeAssets();
+    if (s_failures) {
+        fprintf(stderr, "tst_AndroidAssetMapper: %d check(s) failed\n", s_failures);
+        return 1;
+    }
+    printf("tst_AndroidAssetMapper: OK\n");
+    return 0;
+}
@@ -0,0 +1,18 @@
+# Host test: built with the desktop compiler, the NDK asset manager is replaced
+# by a directory backed stand-in (android/asset_manager.h, HostAssetManager.cpp).
+#   qmake && make check
+
+TEMPLATE = app
+TARGET = tst_AndroidAssetMapper
+CONFIG += console testcase
+CONFIG -= qt app_bundle
+
+INCLUDEPATH += . ../..
+
+HEADERS += \
+    android/asset_manager.h \
+    ../../AndroidAssetMapper_p.h
+SOURCES += \
+    tst_AndroidAssetMapper.cpp \
+    HostAssetManager.cpp \
+    ../../AndroidAssetMapper_p.cpp
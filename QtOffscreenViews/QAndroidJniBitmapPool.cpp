@@ -0,0 +1,252 @@
+/*
+  Offscreen Android Views library for Qt
+
+  Author:
+  Sergey A. Galin <sergey.galin@gmail.com>
+
+  Contributor:
+  Ivan 'w23' Avdeev <marflon@gmail.com>
+
+  Distrbuted under The BSD License
+
+  Copyright (c) 2014, DoubleGIS, LLC.
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+	this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright notice,
+	this list of conditions and the following disclaimer in the documentation
+	and/or other materials provided with the distribution.
+  * Neither the name of the DoubleGIS, LLC nor the names of its contributors
+	may be used to endorse or promote products derived from this software
+	without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS
+  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+  THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <android/bitmap.h>
+#include <QtCore/QDebug>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QPointer>
+#include "QAndroidJniBitmapPool.h"
+
+// Keep enough idle memory for a couple of full-screen 32-bit double-buffered views.
+static const qint64 c_default_memory_limit = 16 * 1024 * 1024;
+static const int c_default_granularity = 32;
+
+// A pooled bitmap is not reused for a request which is much smaller than the bitmap.
+static const qint64 c_max_waste_factor = 2;
+
+QString QAndroidJniBitmapPool::Statistics::toString() const
+{
+	return QString("hits: %1, misses: %2, evictions: %3 (%4 bytes), idle: %5 (%6 bytes), used: %7 (%8 bytes)")
+		.arg(hits).arg(misses).arg(evictions).arg(evicted_bytes)
+		.arg(idle_bitmaps).arg(idle_bytes).arg(used_bitmaps).arg(used_bytes);
+}
+
+QAndroidJniBitmapPool::QAndroidJniBitmapPool()
+	: mutex_()
+	, granularity_(c_default_granularity)
+	, memory_limit_(c_default_memory_limit)
+{
+}
+
+QAndroidJniBitmapPool::~QAndroidJniBitmapPool()
+{
+	clear();
+}
+
+QAndroidJniBitmapPool * QAndroidJniBitmapPool::instance()
+{
+	// Not deleted by static destructors: the bitmaps are unlocked via JNI,
+	// which is not available after the application is gone.
+	static QMutex mymutex;
+	static QPointer<QAndroidJniBitmapPool> instance;
+	QMutexLocker locker(&mymutex);
+	if (instance.isNull())
+	{
+		instance = new QAndroidJniBitmapPool();
+		if (QCoreApplication * app = QCoreApplication::instance())
+		{
+			// May be created in a non-GUI thread
+			instance->moveToThread(app->thread());
+			instance->setParent(app);
+			connect(app, SIGNAL(aboutToQuit()), instance.data(), SLOT(clear()));
+		}
+		else
+		{
+			qWarning("QAndroidJniBitmapPool: created before QCoreApplication; the idle bitmaps will not be released.");
+		}
+	}
+	return instance.data();
+}
+
+QSize QAndroidJniBitmapPool::roundUp(const QSize & size, int granularity)
+{
+	int g = granularity;
+	return QSize(((size.width() + g - 1) / g) * g, ((size.height() + g - 1) / g) * g);
+}
+
+QSize QAndroidJniBitmapPool::bucketSize(const QSize & size) const
+{
+	QMutexLocker locker(&mutex_);
+	return roundUp(size, granularity_);
+}
+
+int QAndroidJniBitmapPool::bucketGranularity() const
+{
+	QMutexLocker locker(&mutex_);
+	return granularity_;
+}
+
+void QAndroidJniBitmapPool::setBucketGranularity(int pixels)
+{
+	QMutexLocker locker(&mutex_);
+	granularity_ = qMax(1, pixels);
+}
+
+void QAndroidJniBitmapPool::setMemoryLimit(qint64 bytes)
+{
+	QMutexLocker locker(&mutex_);
+	memory_limit_ = qMax(qint64(0), bytes);
+	trim(memory_limit_);
+}
+
+bool QAndroidJniBitmapPool::acquire(const QSize & size, int bitness, Bitmap & out_bitmap)
+{
+	QMutexLocker locker(&mutex_);
+	QSize bucket = roundUp(size, granularity_);
+	qint64 bucket_area = qint64(bucket.width()) * qint64(bucket.height());
+
+	// Looking for the smallest fitting bitmap; among the equal ones prefer
+	// the most recently released, so a view resizing within the same bucket
+	// gets its own bitmap back.
+	int best = -1;
+	qint64 best_area = 0;
+	for (int i = idle_.size() - 1; i >= 0; --i)
+	{
+		const Bitmap & b = idle_.at(i);
+		if (b.bitness != bitness || b.size.width() < bucket.width() || b.size.height() < bucket.height())
+		{
+			continue;
+		}
+		qint64 area = qint64(b.size.width()) * qint64(b.size.height());
+		if (area > bucket_area * c_max_waste_factor)
+		{
+			continue;
+		}
+		if (best < 0 || area < best_area)
+		{
+			best = i;
+			best_area = area;
+			if (area == bucket_area)
+			{
+				break;
+			}
+		}
+	}
+
+	if (best < 0)
+	{
+		++stats_.misses;
+		return false;
+	}
+
+	out_bitmap = idle_.takeAt(best);
+	++stats_.hits;
+	--stats_.idle_bitmaps;
+	stats_.idle_bytes -= out_bitmap.bytes();
+	++stats_.used_bitmaps;
+	stats_.used_bytes += out_bitmap.bytes();
+	return true;
+}
+
+void QAndroidJniBitmapPool::allocated(const Bitmap & bitmap)
+{
+	QMutexLocker locker(&mutex_);
+	++stats_.used_bitmaps;
+	stats_.used_bytes += bitmap.bytes();
+}
+
+void QAndroidJniBitmapPool::release(const Bitmap & bitmap)
+{
+	if (bitmap.isNull())
+	{
+		return;
+	}
+	QMutexLocker locker(&mutex_);
+	--stats_.used_bitmaps;
+	stats_.used_bytes -= bitmap.bytes();
+	idle_.append(bitmap);
+	++stats_.idle_bitmaps;
+	stats_.idle_bytes += bitmap.bytes();
+	trim(memory_limit_);
+}
+
+void QAndroidJniBitmapPool::discard(const Bitmap & bitmap)
+{
+	if (bitmap.isNull())
+	{
+		return;
+	}
+	QMutexLocker locker(&mutex_);
+	--stats_.used_bitmaps;
+	stats_.used_bytes -= bitmap.bytes();
+	Bitmap b = bitmap;
+	unlockAndDispose(b);
+}
+
+void QAndroidJniBitmapPool::clear()
+{
+	QMutexLocker locker(&mutex_);
+	trim(0);
+}
+
+QAndroidJniBitmapPool::Statistics QAndroidJniBitmapPool::statistics() const
+{
+	QMutexLocker locker(&mutex_);
+	return stats_;
+}
+
+void QAndroidJniBitmapPool::trim(qint64 limit)
+{
+	// Called with mutex_ locked
+	while (!idle_.isEmpty() && stats_.idle_bytes > limit)
+	{
+		Bitmap b = idle_.takeFirst();
+		qint64 bytes = b.bytes();
+		--stats_.idle_bitmaps;
+		stats_.idle_bytes -= bytes;
+		++stats_.evictions;
+		stats_.evicted_bytes += bytes;
+		unlockAndDispose(b);
+	}
+}
+
+void QAndroidJniBitmapPool::unlockAndDispose(Bitmap & bitmap)
+{
+	if (!bitmap.isNull())
+	{
+		QJniEnvPtr jep;
+		int result = AndroidBitmap_unlockPixels(jep.env(), bitmap.bitmap->jObject());
+		if (result != 0)
+		{
+			qWarning() << __FUNCTION__ << "Failed to unlock bitmap pixels, error:" << result;
+		}
+	}
+	bitmap = Bitmap();
+}
+
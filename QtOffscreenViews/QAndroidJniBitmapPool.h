@@ -0,0 +1,158 @@
+/*
+  Offscreen Android Views library for Qt
+
+  Author:
+  Sergey A. Galin <sergey.galin@gmail.com>
+
+  Contributor:
+  Ivan 'w23' Avdeev <marflon@gmail.com>
+
+  Distrbuted under The BSD License
+
+  Copyright (c) 2014, DoubleGIS, LLC.
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+	this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright notice,
+	this list of conditions and the following disclaimer in the documentation
+	and/or other materials provided with the distribution.
+  * Neither the name of the DoubleGIS, LLC nor the names of its contributors
+	may be used to endorse or promote products derived from this software
+	without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS
+  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+  THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include <jni.h>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QObject>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QSize>
+#include <QtCore/QString>
+#include <QtGui/QImage>
+#include <QJniHelpers.h>
+
+/*!
+ * A process-wide pool of Android Bitmaps with locked pixels, used by
+ * QAndroidJniImagePair to avoid creating a new Java Bitmap on every resize.
+ *
+ * Bitmaps are allocated with their size rounded up to bucketGranularity()
+ * pixels, so a view which changes its size by a few pixels (e.g. during
+ * rotation or soft keyboard animation) keeps using the same bitmap, and
+ * the bitmaps released by one view can be picked up by another one.
+ * The total size of idle (released) bitmaps is limited by memoryLimit();
+ * the least recently released bitmaps are evicted first.
+ * The pool belongs to the application object and drops the idle bitmaps
+ * on aboutToQuit(), while JNI is still available.
+ */
+class QAndroidJniBitmapPool: public QObject
+{
+	Q_OBJECT
+public:
+	//! Pooled bitmap with its pixels locked.
+	struct Bitmap
+	{
+		Bitmap(): pixels(0), stride(0), format(QImage::Format_Invalid), bitness(0) {}
+		bool isNull() const { return bitmap.isNull() || bitmap->jObject() == 0 || pixels == 0; }
+		qint64 bytes() const { return qint64(stride) * qint64(size.height()); }
+
+		QSharedPointer<QJniObject> bitmap;
+		uchar * pixels;
+		QSize size;
+		int stride;
+		QImage::Format format;
+		int bitness;
+	};
+
+	struct Statistics
+	{
+		Statistics()
+			: hits(0), misses(0), evictions(0), evicted_bytes(0)
+			, idle_bitmaps(0), idle_bytes(0), used_bitmaps(0), used_bytes(0)
+		{}
+		QString toString() const;
+
+		qint64 hits;
+		qint64 misses;
+		qint64 evictions;
+		qint64 evicted_bytes;
+		int idle_bitmaps;
+		qint64 idle_bytes;
+		int used_bitmaps;
+		qint64 used_bytes;
+	};
+
+	~QAndroidJniBitmapPool();
+
+	static QAndroidJniBitmapPool * instance();
+
+	/*!
+	 * Get a pooled bitmap of at least bucketSize(size) for the given bitness.
+	 * \return true and fills out_bitmap on success, false if the pool has no
+	 * suitable bitmap and a new one should be allocated by the caller
+	 * (and reported via allocated()).
+	 */
+	bool acquire(const QSize & size, int bitness, Bitmap & out_bitmap);
+
+	//! Register a bitmap newly created by the caller as being in use.
+	void allocated(const Bitmap & bitmap);
+
+	/*!
+	 * Return bitmap to the pool. The bitmap must not be used by the caller
+	 * after this call. If the pool grows over memoryLimit() the oldest idle
+	 * bitmaps are unlocked and released.
+	 */
+	void release(const Bitmap & bitmap);
+
+	/*!
+	 * Unlock and drop a bitmap which can't be reused because somebody else
+	 * (e.g. Java UI thread) may still be using it.
+	 */
+	void discard(const Bitmap & bitmap);
+
+	//! Size rounded up to the bucket granularity.
+	QSize bucketSize(const QSize & size) const;
+
+	int bucketGranularity() const;
+	void setBucketGranularity(int pixels);
+
+	qint64 memoryLimit() const { return memory_limit_; }
+	void setMemoryLimit(qint64 bytes);
+
+	Statistics statistics() const;
+
+public slots:
+	//! Release all idle bitmaps.
+	void clear();
+
+private:
+	QAndroidJniBitmapPool();
+	static QSize roundUp(const QSize & size, int granularity);
+	void trim(qint64 limit);
+	static void unlockAndDispose(Bitmap & bitmap);
+
+private:
+	mutable QMutex mutex_;
+	QList<Bitmap> idle_;
+	Statistics stats_;
+	int granularity_;
+	qint64 memory_limit_;
+	Q_DISABLE_COPY(QAndroidJniBitmapPool)
+};
+
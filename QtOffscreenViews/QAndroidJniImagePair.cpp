@@ -79,6 +79,8 @@ static QImage::Format qtImageFormatForBitness(int bitness)
 
 QAndroidJniImagePair::QAndroidJniImagePair(int bitness)
 	: mBitmap()
+	, mRetiredBitmaps()
+	, mDeferredRelease(false)
 	, mImageOnBitmap()
 	, bitness_(bitness)
 {
@@ -87,6 +89,13 @@ QAndroidJniImagePair::QAndroidJniImagePair(int bitness)
 
 QAndroidJniImagePair::~QAndroidJniImagePair()
 {
+	dispose();
+	// The owner should have taken them already
+	QList<QAndroidJniBitmapPool::Bitmap> retired = takeRetiredBitmaps();
+	for (int i = 0; i < retired.size(); ++i)
+	{
+		QAndroidJniBitmapPool::instance()->release(retired.at(i));
+	}
 }
 
 void QAndroidJniImagePair::preloadJavaClasses()
@@ -98,13 +107,47 @@ void QAndroidJniImagePair::preloadJavaClasses()
 
 void QAndroidJniImagePair::dispose()
 {
-	if (mImageOnBitmap.width() == 1 && mImageOnBitmap.height() == 1 && !mBitmap)
+	if (mImageOnBitmap.width() == 1 && mImageOnBitmap.height() == 1 && mBitmap.isNull())
 	{
 		return; // Already a dispose
 	}
 
+	// Detach QImage from the bitmap memory before the bitmap goes to the pool
 	mImageOnBitmap = QImage(1, 1, qtImageFormatForBitness(bitness_));
-	mBitmap.reset();
+	if (!mBitmap.isNull())
+	{
+		if (mDeferredRelease)
+		{
+			mRetiredBitmaps.append(mBitmap);
+		}
+		else
+		{
+			QAndroidJniBitmapPool::instance()->release(mBitmap);
+		}
+	}
+	mBitmap = QAndroidJniBitmapPool::Bitmap();
+}
+
+QList<QAndroidJniBitmapPool::Bitmap> QAndroidJniImagePair::takeRetiredBitmaps()
+{
+	QList<QAndroidJniBitmapPool::Bitmap> result = mRetiredBitmaps;
+	mRetiredBitmaps.clear();
+	return result;
+}
+
+void QAndroidJniImagePair::setBitness(int bitness)
+{
+	if (bitness != 32 && bitness != 16)
+	{
+		qWarning() << __FUNCTION__ << "Invalid pixel bit depth:" << bitness;
+		return;
+	}
+	if (bitness != bitness_)
+	{
+		dispose();
+		bitness_ = bitness;
+		mImageOnBitmap = QImage(1, 1, qtImageFormatForBitness(bitness_));
+	}
 }
 
 QJniObject * QAndroidJniImagePair::createBitmap(const QSize & size)
@@ -168,19 +211,42 @@ bool QAndroidJniImagePair::doResize(const QSize & size)
 		return false;
 	}
 
+	// Give the old bitmap back first, so it can be picked again if it still fits
+	// (unless its release is deferred).
+	dispose();
+
+	QAndroidJniBitmapPool * pool = QAndroidJniBitmapPool::instance();
+	QAndroidJniBitmapPool::Bitmap pooled;
+	if (pool->acquire(size, bitness_, pooled))
+	{
+		mImageOnBitmap = QImage(pooled.pixels, size.width(), size.height(), pooled.stride, pooled.format);
+		if (mImageOnBitmap.isNull())
+		{
+			qCritical() << "Error: called QImage constructor but got null image! Memory error?";
+			pool->release(pooled);
+			dispose();
+			return false;
+		}
+		// The bitmap may contain a picture left from another view
+		mImageOnBitmap.fill(0);
+		mBitmap = pooled;
+		return true;
+	}
+
 	QJniEnvPtr jep;
+	QSize bucket = pool->bucketSize(size);
 
 	// We'll need a new bitmap for the new size
 	QImage::Format format = qtImageFormatForBitness(bitness_);
 
 	// Create new Android bitmap
-	QScopedPointer<QJniObject> newBitmap(createBitmap(size));
+	QSharedPointer<QJniObject> newBitmap(createBitmap(bucket));
 
 	if (!newBitmap || newBitmap->jObject() == 0)
 	{
 		qCritical("Could not create %dx%d bitmap! bitmap=%p, jbitmap=%p"
-			, size.width()
-			, size.height()
+			, bucket.width()
+			, bucket.height()
 			, reinterpret_cast<void*>(newBitmap.data())
 			, reinterpret_cast<void*>((newBitmap.data()) ? newBitmap->jObject() : 0));
 		dispose();
@@ -217,9 +283,9 @@ bool QAndroidJniImagePair::doResize(const QSize & size)
 			<< "Invalid AndroidBitmapInfo. Will fall back to standard bitmap properties: "
 				"width:" << bwidth << "height:" << bheight
 			<< "stride:" << bstride << "format:" << binfo.format << "flags:" << binfo.flags;
-		bwidth = static_cast<uint32_t>(size.width());
-		bheight = static_cast<uint32_t>(size.height());
-		bstride = static_cast<uint32_t>(size.width() * ((bitness_ == 32) ? 4 : 2));
+		bwidth = static_cast<uint32_t>(bucket.width());
+		bheight = static_cast<uint32_t>(bucket.height());
+		bstride = static_cast<uint32_t>(bucket.width() * ((bitness_ == 32) ? 4 : 2));
 		format = qtImageFormatForBitness(static_cast<int>(bitness_));
 	}
 	else
@@ -234,17 +300,24 @@ bool QAndroidJniImagePair::doResize(const QSize & size)
 		}
 	}
 
-	if (uint32_t(size.width()) != bwidth || uint32_t(size.height()) != bheight)
+	if (uint32_t(bucket.width()) != bwidth || uint32_t(bucket.height()) != bheight)
 	{
 		qWarning() << "Android bitmap size:" << bwidth << "x" << bheight
-				   << "is different than the requested size:" << size.width() << "x" << size.height();
+				   << "is different than the requested size:" << bucket.width() << "x" << bucket.height();
+		if (uint32_t(size.width()) > bwidth || uint32_t(size.height()) > bheight)
+		{
+			qCritical() << "Android bitmap is too small for the image:" << size;
+			dispose();
+			return false;
+		}
 	}
 
 	//qDebug()<<"AndroidBitmapInfo: width:"<<bwidth<<"height:"<<bheight
 	//        <<"stride:"<<bstride<<"QImage::format:"<<static_cast<int>(format);
 
 	//
-	// Lock Android bitmap's pixels so we could create a QImage over it
+	// Lock Android bitmap's pixels so we could create a QImage over it.
+	// The pixels stay locked while the bitmap lives in the pool.
 	//
 	void * ptr = 0;
 	int lock_pixels_result = AndroidBitmap_lockPixels(jep.env(), newBitmap->jObject(), &ptr);
@@ -271,23 +344,29 @@ bool QAndroidJniImagePair::doResize(const QSize & size)
 	// that uses an existing memory buffer, data. The width and height
 	// must be specified in pixels. bytesPerLine specifies the number
 	// of bytes per line (stride)."
-	//qDebug()<<"Constructing QImage buffer:"<<bwidth<<"x"<<bheight
-	//        <<bstride<<static_cast<int>(format);
+	//qDebug()<<"Constructing QImage buffer:"<<size<<bstride<<static_cast<int>(format);
 	mImageOnBitmap = QImage(
 		 static_cast<uchar *>(ptr),
-		 static_cast<int>(bwidth),
-		 static_cast<int>(bheight),
+		 size.width(),
+		 size.height(),
 		 static_cast<int>(bstride),
 		 format);
 
 	if (mImageOnBitmap.isNull())
 	{
 		qCritical() << "Error: called QImage constructor but got null image! Memory error?";
+		AndroidBitmap_unlockPixels(jep.env(), newBitmap->jObject());
 		dispose();
 		return false;
 	}
 
-	mBitmap.reset(newBitmap.take());
+	mBitmap.bitmap = newBitmap;
+	mBitmap.pixels = static_cast<uchar *>(ptr);
+	mBitmap.size = QSize(static_cast<int>(bwidth), static_cast<int>(bheight));
+	mBitmap.stride = static_cast<int>(bstride);
+	mBitmap.format = format;
+	mBitmap.bitness = bitness_;
+	pool->allocated(mBitmap);
 	return true;
 }
 
@@ -303,26 +382,34 @@ void QAndroidJniImagePair::fill(const QColor & color, bool to_android_color)
 	mImageOnBitmap.fill(fill);
 }
 
-void QAndroidJniImagePair::convert32BitImageFromQtToAndroid()
+// Source: ARGB; formula: R | B00 | A0G0 => ABGR
+static inline quint32 swapRedAndBlue(quint32 c)
 {
-	if (bitness_ == 32)
-	{
+	return ((c >> 16) & 0xFF) | ((c & 0xFF) << 16) | (c & 0xFF00FF00);
+}
+
 #if defined(__arm__)
-		// Suppress "cast increases required alignment of target type":
-		typedef uchar __attribute__((aligned(4))) AlignedUchar;
-		AlignedUchar * bits = mImageOnBitmap.scanLine(0);
-		quint32 * ptr = reinterpret_cast<quint32 *>(bits);
+// Suppress "cast increases required alignment of target type":
+typedef uchar __attribute__((aligned(4))) AlignedUchar;
 #else
-		quint32 * ptr = reinterpret_cast<quint32 *>(mImageOnBitmap.scanLine(0));
+typedef uchar AlignedUchar;
 #endif
-		QSize sz = mImageOnBitmap.size();
-		int nquads = sz.width() * sz.height();
 
-		for (int i = 0; i < nquads; ++i, ++ptr)
+void QAndroidJniImagePair::convert32BitImageFromQtToAndroid()
+{
+	if (bitness_ == 32)
+	{
+		// Bitmaps from the pool may have stride larger than the image width,
+		// so converting line by line.
+		QSize sz = mImageOnBitmap.size();
+		for (int y = 0; y < sz.height(); ++y)
 		{
-			quint32 c = *ptr;
-			// Source: ARGB; formula: R | B00 | A0G0 => ABGR
-			*ptr = ((c >> 16) & 0xFF) | ((c & 0xFF) << 16) | (c & 0xFF00FF00);
+			AlignedUchar * bits = mImageOnBitmap.scanLine(y);
+			quint32 * ptr = reinterpret_cast<quint32 *>(bits);
+			for (int x = 0; x < sz.width(); ++x, ++ptr)
+			{
+				*ptr = swapRedAndBlue(*ptr);
+			}
 		}
 	}
 }
@@ -337,26 +424,17 @@ void QAndroidJniImagePair::convert32BitImageFromQtToAndroid(QImage & out_image)
 			out_image = QImage(mImageOnBitmap.size(), mImageOnBitmap.format());
 		}
 
-#if defined(__arm__)
-		// Suppress "cast increases required alignment of target type":
-		typedef uchar __attribute__((aligned(4))) AlignedUchar;
-		const AlignedUchar * bits = mImageOnBitmap.scanLine(0);
-		const quint32 * src = reinterpret_cast<const quint32 *>(bits);
-
-		AlignedUchar * out_bits = out_image.scanLine(0);
-		quint32 * dest = reinterpret_cast<quint32 *>(out_bits);
-#else
-		const quint32 * src = reinterpret_cast<const quint32 *>(mImageOnBitmap.scanLine(0));
-		quint32 * dest = reinterpret_cast<quint32 *>(out_image.scanLine(0));
-#endif
 		QSize sz = mImageOnBitmap.size();
-		int nquads = sz.width() * sz.height();
-
-		for (int i = 0; i < nquads; ++i, ++src, ++dest)
+		for (int y = 0; y < sz.height(); ++y)
 		{
-			quint32 c = *src;
-			// Source: ARGB; formula: R | B00 | A0G0 => ABGR
-			*dest = ((c >> 16) & 0xFF) | ((c & 0xFF) << 16) | (c & 0xFF00FF00);
+			const AlignedUchar * bits = mImageOnBitmap.constScanLine(y);
+			const quint32 * src = reinterpret_cast<const quint32 *>(bits);
+			AlignedUchar * out_bits = out_image.scanLine(y);
+			quint32 * dest = reinterpret_cast<quint32 *>(out_bits);
+			for (int x = 0; x < sz.width(); ++x, ++src, ++dest)
+			{
+				*dest = swapRedAndBlue(*src);
+			}
 		}
 	}
 	else
@@ -379,9 +457,32 @@ void QAndroidJniImagePair::convert32BitImageFromAndroidToQt(QImage & out_image)
 	convert32BitImageFromQtToAndroid(out_image);
 }
 
+void QAndroidJniImagePair::convert32BitImageFromAndroidToQt(QImage & out_image, const QRect & rect) const
+{
+	if (bitness_ != 32 || rect.isEmpty()
+		|| out_image.size() != mImageOnBitmap.size()
+		|| out_image.format() != mImageOnBitmap.format())
+	{
+		convert32BitImageFromAndroidToQt(out_image);
+		return;
+	}
+	QRect area = rect & mImageOnBitmap.rect();
+	for (int y = area.top(); y <= area.bottom(); ++y)
+	{
+		const AlignedUchar * bits = mImageOnBitmap.constScanLine(y);
+		const quint32 * src = reinterpret_cast<const quint32 *>(bits) + area.left();
+		AlignedUchar * out_bits = out_image.scanLine(y);
+		quint32 * dest = reinterpret_cast<quint32 *>(out_bits) + area.left();
+		for (int x = 0; x < area.width(); ++x, ++src, ++dest)
+		{
+			*dest = swapRedAndBlue(*src);
+		}
+	}
+}
+
 bool QAndroidJniImagePair::isAllocated() const
 {
-	return mBitmap && mBitmap->jObject() != 0 && !mImageOnBitmap.isNull();
+	return !mBitmap.isNull() && !mImageOnBitmap.isNull();
 }
 
 bool QAndroidJniImagePair::resize(int w, int h)
@@ -443,7 +544,7 @@ bool QAndroidJniImagePair::loadResource(jint res_id)
 		// Resize our image pair
 		resize(w, h);
 
-		if (!mBitmap)
+		if (mBitmap.isNull())
 		{
 			qWarning() << __FUNCTION__ << "Failed to resize bitmap to" << w << "x" << h;
 			return false;
@@ -451,7 +552,7 @@ bool QAndroidJniImagePair::loadResource(jint res_id)
 
 		// Draw the loaded Bitmap over our Bitmap
 		QJniObject canvas("android/graphics/Canvas", "");
-		canvas.callParamVoid("setBitmap", "Landroid/graphics/Bitmap;", mBitmap->jObject());
+		canvas.callParamVoid("setBitmap", "Landroid/graphics/Bitmap;", mBitmap.bitmap->jObject());
 		canvas.callParamVoid("drawBitmap", "Landroid/graphics/Bitmap;FFLandroid/graphics/Paint;",
 							 loadedbitmap->jObject(), jfloat(0), jfloat(0), jobject(0));
 
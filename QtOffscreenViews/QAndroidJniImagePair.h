@@ -44,14 +44,19 @@
 #include <QtCore/QScopedPointer>
 #include <QAndroidQPAPluginGap.h>
 #include <QJniHelpers.h>
+#include "QAndroidJniBitmapPool.h"
 
 /*!
  * This class holds QImage and Android Bitmap sharing the same pixel buffer.
  * For 16 bit, the image can be used in Android and in Qt at the same time.
- * The 16 bit mode may have visible color errors and has no significant
- * performance benefits comparing to 32 bits.
+ * The 16 bit mode may have visible color errors on gradients but it takes
+ * half of the memory and half of the GL upload bandwidth comparing to 32 bits,
+ * and it needs no color plane conversion.
  * For 32 bit, it is necessary to call convert32BitImageFromQtToAndroid() /
  * convert32BitImageFromAndroidToQt() to fix color plane order.
+ * Bitmaps are taken from and returned to QAndroidJniBitmapPool, so the
+ * Android Bitmap may be larger than the image; QImage uses only its top
+ * left part (and its stride may be larger than width * bytes per pixel).
  */
 class QAndroidJniImagePair
 	: public QObject
@@ -70,19 +75,41 @@ public:
 
 	int bitness() const { return bitness_; }
 
+	/*!
+	 * Change color resolution. If the bitness is different from the current one
+	 * the bitmap is disposed, so resize() should be called to allocate it again.
+	 * \param bitness can be 32 or 16.
+	 */
+	void setBitness(int bitness);
+
 	/*!
 	 * Call this from main() to make sure that Java classes will be accessible.
 	 */
 	static void preloadJavaClasses();
 
 	/*!
-	 * After call of this function, Java-side Bitmap is released and
-	 * QImage is assigned with 1 pixel image (i.e. QImage is never a null image).
+	 * After call of this function, Java-side Bitmap is returned to the bitmap pool
+	 * (or retired, see setDeferredRelease()) and QImage is assigned with 1 pixel image
+	 * (i.e. QImage is never a null image).
 	 */
 	void dispose();
 
+	/*!
+	 * If enabled, bitmaps replaced by resize(), setBitness() or dispose() are not returned
+	 * to the pool but kept until the owner takes them via takeRetiredBitmaps().
+	 * This is needed when the Bitmap is passed to Java, which may still be painting on it:
+	 * the pool could give it to another view in the meantime.
+	 */
+	void setDeferredRelease(bool deferred) { mDeferredRelease = deferred; }
+
+	/*!
+	 * Get the bitmaps retired since the last call. The caller is responsible for
+	 * returning them to the pool (or discarding them) when they are not used anymore.
+	 */
+	QList<QAndroidJniBitmapPool::Bitmap> takeRetiredBitmaps();
+
 	//! Global Java reference to the Java-side Bitmap.
-	jobject jbitmap(){ return (mBitmap)? mBitmap->jObject(): 0; }
+	jobject jbitmap(){ return (!mBitmap.isNull())? mBitmap.bitmap->jObject(): 0; }
 
 	//! Reference to the const QImage.
 	const QImage & qImage() const { return mImageOnBitmap; }
@@ -102,9 +129,18 @@ public:
 	//! Swap color planes so Android image starts to look correct on Qt.
 	void convert32BitImageFromAndroidToQt(QImage & out_image) const;
 
+	/*!
+	 * Same as above, but only pixels in \a rect are converted if \a out_image already
+	 * has the same size and format. Empty \a rect means the whole image.
+	 */
+	void convert32BitImageFromAndroidToQt(QImage & out_image, const QRect & rect) const;
+
 	//! Returns true if shared bitmap is allocated.
 	bool isAllocated() const;
 
+	//! Memory taken by the pixels of the (pooled) bitmap.
+	qint64 bytes() const { return mBitmap.bytes(); }
+
 	/*!
 	 * Allocate bitmap of the given size. If the bitmap is already allocated it does nothing.
 	 * \return true if bitmap of the requested size has been successfully allocated.
@@ -145,15 +181,17 @@ protected:
 	QJniObject * createBitmap(const QSize & size);
 
 	/*!
-	 * After a call to  this function, imageOnBitmap and bitmap have "size" size
-	 * and are located in the same memory (i.e. share the same image data).
+	 * After a call to  this function, imageOnBitmap has "size" size and is located
+	 * in the memory of a (possibly larger) pooled bitmap.
 	 * WARNING: size must be valid (non-zero and not too huge) or the function
 	 * will just return false without doing anything.
 	 */
 	bool doResize(const QSize & size);
 
 private:
-	QScopedPointer<QJniObject> mBitmap;
+	QAndroidJniBitmapPool::Bitmap mBitmap;
+	QList<QAndroidJniBitmapPool::Bitmap> mRetiredBitmaps;
+	bool mDeferredRelease;
 	QImage mImageOnBitmap;
 	int bitness_;
 };
@@ -0,0 +1,93 @@
+/*
+  Offscreen Android Views library for Qt
+
+  Author:
+  Sergey A. Galin <sergey.galin@gmail.com>
+
+  Distrbuted under The BSD License
+
+  Copyright (c) 2014, DoubleGIS, LLC.
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+  * Neither the name of the DoubleGIS, LLC nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS
+  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+  THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <pthread.h>
+#include <set>
+#include <string>
+#include "QAndroidJniNativesRegistry.h"
+
+static pthread_mutex_t s_registry_mutex = PTHREAD_MUTEX_INITIALIZER;
+static std::set<std::string> s_registered_classes;
+
+namespace {
+
+class RegistryLocker
+{
+public:
+	RegistryLocker() { pthread_mutex_lock(&s_registry_mutex); }
+	~RegistryLocker() { pthread_mutex_unlock(&s_registry_mutex); }
+};
+
+} // anonymous namespace
+
+bool QAndroidJniNativesRegistry::registerNatives(JNIEnv * env, jclass clazz, const char * class_name, const JNINativeMethod * methods, int count)
+{
+	if (!class_name)
+	{
+		return false;
+	}
+	RegistryLocker locker;
+	if (s_registered_classes.find(class_name) != s_registered_classes.end())
+	{
+		return true;
+	}
+	if (!env || !clazz)
+	{
+		return false;
+	}
+	jint result = env->RegisterNatives(clazz, methods, static_cast<jint>(count));
+	if (env->ExceptionCheck())
+	{
+		env->ExceptionClear();
+		return false;
+	}
+	if (result != 0)
+	{
+		return false;
+	}
+	s_registered_classes.insert(class_name);
+	return true;
+}
+
+bool QAndroidJniNativesRegistry::isRegistered(const char * class_name)
+{
+	if (!class_name)
+	{
+		return false;
+	}
+	RegistryLocker locker;
+	return s_registered_classes.find(class_name) != s_registered_classes.end();
+}
@@ -0,0 +1,63 @@
+/*
+  Offscreen Android Views library for Qt
+
+  Author:
+  Sergey A. Galin <sergey.galin@gmail.com>
+
+  Distrbuted under The BSD License
+
+  Copyright (c) 2014, DoubleGIS, LLC.
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+  * Neither the name of the DoubleGIS, LLC nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS
+  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+  THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include <jni.h>
+
+/*!
+ * One-time, thread-safe registration of native methods of Java classes.
+ * RegisterNatives is called only for the first registerNatives() of a class; the following
+ * calls for the same class name just return true, so creating many views of the same
+ * type doesn't register their methods again.
+ * The code only uses JNI and pthreads (no Qt) so it can be tested on a host with a fake JNIEnv.
+ */
+class QAndroidJniNativesRegistry
+{
+public:
+	/*!
+	 * Register \a count methods of \a clazz, unless \a class_name has been registered already.
+	 * \param class_name - full name of the class, e.g. "ru/dublgis/offscreenview/OffscreenView".
+	 * \return true if the methods are registered (now or before). If RegisterNatives fails,
+	 *  the Java exception (if any) is cleared and the next call will try again.
+	 */
+	static bool registerNatives(JNIEnv * env, jclass clazz, const char * class_name, const JNINativeMethod * methods, int count);
+
+	//! Check if registerNatives() has succeeded for the class.
+	static bool isRegistered(const char * class_name);
+
+private:
+	QAndroidJniNativesRegistry();
+};
@@ -54,6 +54,22 @@ Q_DECL_EXPORT void JNICALL Java_AndroidOffscreenEditText_nativeOnTextChanged(JNI
 	qWarning()<<__FUNCTION__<<"Zero param!";
 }
 
+Q_DECL_EXPORT void JNICALL Java_AndroidOffscreenEditText_nativeOnTextDelta(JNIEnv *, jobject, jlong param, jstring inserted, jint start, jint before, jint count, jint length)
+{
+	if (param)
+	{
+		void * vp = reinterpret_cast<void*>(param);
+		QAndroidOffscreenEditText * edit = qobject_cast<QAndroidOffscreenEditText*>(reinterpret_cast<QAndroidOffscreenView*>(vp));
+		if (edit)
+		{
+			QString qinserted = QJniEnvPtr().JStringToQString(inserted);
+			edit->javaOnTextDelta(qinserted, start, before, count, length);
+			return;
+		}
+	}
+	qWarning()<<__FUNCTION__<<"Zero param!";
+}
+
 Q_DECL_EXPORT jboolean JNICALL Java_AndroidOffscreenEditText_nativeOnKey(JNIEnv *, jobject, jlong param, jboolean down, jint keycode)
 {
 	if (param)
@@ -90,17 +106,22 @@ Q_DECL_EXPORT void JNICALL Java_AndroidOffscreenEditText_nativeOnEditorAction(JN
 QAndroidOffscreenEditText::QAndroidOffscreenEditText(const QString & object_name, const QSize & def_size, QObject * parent)
 	: QAndroidOffscreenView(QLatin1String("OffscreenEditText"), object_name, def_size, parent)
 	, paint_flags_(ANDROID_PAINT_DEV_KERN_TEXT_FLAG | ANDROID_PAINT_ANTI_ALIAS_FLAG)
+	, text_delta_mode_(true)
+	, text_()
+	, text_valid_(true)
+	, text_mutex_()
+	, update_depth_(0)
+	, pending_style_()
+	, custom_properties_set_(false)
 {
 	setAttachingMode(true);
-	if (QJniObject * view = offscreenView())
-	{
-		static const JNINativeMethod methods[] = {
-			{"nativeOnTextChanged", "(JLjava/lang/String;III)V", reinterpret_cast<void*>(Java_AndroidOffscreenEditText_nativeOnTextChanged)},
-			{"nativeOnKey", "(JZI)Z", reinterpret_cast<void*>(Java_AndroidOffscreenEditText_nativeOnKey)},
-			{"nativeOnEditorAction", "(JI)V", reinterpret_cast<void*>(Java_AndroidOffscreenEditText_nativeOnEditorAction)},
-		};
-		view->registerNativeMethods(methods, sizeof(methods));
-	}
+	static const JNINativeMethod methods[] = {
+		{"nativeOnTextChanged", "(JLjava/lang/String;III)V", reinterpret_cast<void*>(Java_AndroidOffscreenEditText_nativeOnTextChanged)},
+		{"nativeOnTextDelta", "(JLjava/lang/String;IIII)V", reinterpret_cast<void*>(Java_AndroidOffscreenEditText_nativeOnTextDelta)},
+		{"nativeOnKey", "(JZI)Z", reinterpret_cast<void*>(Java_AndroidOffscreenEditText_nativeOnKey)},
+		{"nativeOnEditorAction", "(JI)V", reinterpret_cast<void*>(Java_AndroidOffscreenEditText_nativeOnEditorAction)},
+	};
+	registerViewNativeMethods(methods, sizeof(methods));
 }
 
 QAndroidOffscreenEditText::~QAndroidOffscreenEditText()
@@ -109,13 +130,44 @@ QAndroidOffscreenEditText::~QAndroidOffscreenEditText()
 
 void QAndroidOffscreenEditText::preloadJavaClasses()
 {
-	QAndroidOffscreenView::preloadJavaClasses();
-	QAndroidQPAPluginGap::preloadJavaClass((getDefaultJavaClassPath() + QLatin1String("OffscreenEditText")).toLatin1());
+	preloadViewJavaClass(QLatin1String("OffscreenEditText"));
 }
 
 void QAndroidOffscreenEditText::javaOnTextChanged(const QString & str, int start, int before, int count)
 {
+	{
+		QMutexLocker locker(&text_mutex_);
+		text_ = str;
+		text_valid_ = true;
+	}
 	emit onTextChanged(str, start, before, count);
+	emit onTextDelta(start, before, str.mid(start, count));
+	emit onTextChanged();
+}
+
+void QAndroidOffscreenEditText::javaOnTextDelta(const QString & inserted, int start, int before, int count, int length)
+{
+	QString text;
+	{
+		QMutexLocker locker(&text_mutex_);
+		if (text_valid_ && start >= 0 && before >= 0 && start + before <= text_.length())
+		{
+			text_.replace(start, before, inserted);
+		}
+		if (!text_valid_ || text_.length() != length || inserted.length() != count)
+		{
+			// Lost sync (e.g. the mode has just been switched): getting the whole text once
+			qWarning()<<__FUNCTION__<<"Re-reading text of"<<viewObjectName();
+			if (QJniObject * view = offscreenView())
+			{
+				text_ = view->callString("getText");
+			}
+		}
+		text_valid_ = true;
+		text = text_;
+	}
+	emit onTextChanged(text, start, before, count);
+	emit onTextDelta(start, before, inserted);
 	emit onTextChanged();
 }
 
@@ -157,16 +209,49 @@ void QAndroidOffscreenEditText::javaOnEditorAction(int action)
 	}
 }
 
+bool QAndroidOffscreenEditText::resetForReuse()
+{
+	if (custom_properties_set_ || !QAndroidOffscreenView::resetForReuse())
+	{
+		return false;
+	}
+	update_depth_ = 0;
+	pending_style_.clear();
+	setTextDeltaMode(true);
+	{
+		QMutexLocker locker(&text_mutex_);
+		text_.clear();
+		text_valid_ = true;
+	}
+	// Clears the text and restores Style properties
+	offscreenView()->callVoid("resetForReuse");
+	return true;
+}
+
 void QAndroidOffscreenEditText::setText(const QString & text)
 {
 	if (QJniObject * view = offscreenView())
 	{
+		{
+			// Java may still send changes made before the new text is set, so the copy
+			// is re-read from Java (which has the new text already) on the next change.
+			QMutexLocker locker(&text_mutex_);
+			text_valid_ = false;
+		}
 		view->callVoid("setText", text);
 	}
 }
 
 QString QAndroidOffscreenEditText::getText() const
 {
+	if (text_delta_mode_)
+	{
+		QMutexLocker locker(&text_mutex_);
+		if (text_valid_)
+		{
+			return text_;
+		}
+	}
 	if (QJniObject * view = const_cast<QJniObject*>(offscreenView()))
 	{
 		return view->callString("getText");
@@ -174,8 +259,29 @@ QString QAndroidOffscreenEditText::getText() const
 	return QString::null;
 }
 
+void QAndroidOffscreenEditText::setTextDeltaMode(bool enabled)
+{
+	if (enabled != text_delta_mode_)
+	{
+		text_delta_mode_ = enabled;
+		{
+			QMutexLocker locker(&text_mutex_);
+			text_valid_ = false; // Will be re-read on the next change or getText()
+		}
+		if (QJniObject * view = offscreenView())
+		{
+			view->callVoid("setTextDeltaMode", jboolean(enabled));
+		}
+	}
+}
+
 void QAndroidOffscreenEditText::setTextSize(float size, int unit)
 {
+	if (update_depth_ > 0)
+	{
+		pending_style_.setTextSize(size, unit);
+		return;
+	}
 	if (QJniObject * view = offscreenView())
 	{
 		view->callParamVoid("setTextSize", "FI", jfloat(size), jint(unit));
@@ -184,6 +290,11 @@ void QAndroidOffscreenEditText::setTextSize(float size, int unit)
 
 void QAndroidOffscreenEditText::setTypeface(const QString & name, int style)
 {
+	if (update_depth_ > 0)
+	{
+		pending_style_.setTypeface(name, style);
+		return;
+	}
 	if (QJniObject * view = offscreenView())
 	{
 		view->callParamVoid("setTypeface", "Ljava/lang/String;I", QJniLocalRef(name).jObject(), jint(style));
@@ -192,6 +303,7 @@ void QAndroidOffscreenEditText::setTypeface(const QString & name, int style)
 
 void QAndroidOffscreenEditText::setTypefaceFromFile(const QString & filename, int style)
 {
+	custom_properties_set_ = true;
 	if (QJniObject * view = offscreenView())
 	{
 		view->callParamVoid("setTypefaceFromFile", "Ljava/lang/String;I", QJniLocalRef(filename).jObject(), style);
@@ -200,6 +312,7 @@ void QAndroidOffscreenEditText::setTypefaceFromFile(const QString & filename, in
 
 void QAndroidOffscreenEditText::setTypefaceFromAsset(const QString & filename, int style)
 {
+	custom_properties_set_ = true;
 	if (QJniObject * view = offscreenView())
 	{
 		view->callParamVoid("setTypefaceFromAsset", "Ljava/lang/String;I", QJniLocalRef(filename).jObject(), style);
@@ -208,6 +321,11 @@ void QAndroidOffscreenEditText::setTypefaceFromAsset(const QString & filename, i
 
 void QAndroidOffscreenEditText::setCursorVisible(bool visible)
 {
+	if (update_depth_ > 0)
+	{
+		pending_style_.setCursorVisible(visible);
+		return;
+	}
 	if (QJniObject * view = offscreenView())
 	{
 		view->callVoid("setCursorVisible", jboolean(visible));
@@ -216,6 +334,11 @@ void QAndroidOffscreenEditText::setCursorVisible(bool visible)
 
 void QAndroidOffscreenEditText::setInputType(int type)
 {
+	if (update_depth_ > 0)
+	{
+		pending_style_.setInputType(type);
+		return;
+	}
 	if (QJniObject * view = offscreenView())
 	{
 		view->callVoid("setInputType", jint(type));
@@ -224,6 +347,11 @@ void QAndroidOffscreenEditText::setInputType(int type)
 
 void QAndroidOffscreenEditText::setInputType(int type_and, int type_or)
 {
+	if (update_depth_ > 0)
+	{
+		pending_style_.setInputType(type_and, type_or);
+		return;
+	}
 	if (QJniObject * view = offscreenView())
 	{
 		view->callParamVoid("setInputType", "II", jint(type_and), jint(type_or));
@@ -232,6 +360,7 @@ void QAndroidOffscreenEditText::setInputType(int type_and, int type_or)
 
 void QAndroidOffscreenEditText::setMarqueeRepeatLimit(int marqueeLimit)
 {
+	custom_properties_set_ = true;
 	if (QJniObject * view = offscreenView())
 	{
 		view->callVoid("setMarqueeRepeatLimit", jint(marqueeLimit));
@@ -240,6 +369,7 @@ void QAndroidOffscreenEditText::setMarqueeRepeatLimit(int marqueeLimit)
 
 void QAndroidOffscreenEditText::setMaxEms(int maxems)
 {
+	custom_properties_set_ = true;
 	if (QJniObject * view = offscreenView())
 	{
 		view->callVoid("setMaxEms", jint(maxems));
@@ -248,6 +378,7 @@ void QAndroidOffscreenEditText::setMaxEms(int maxems)
 
 void QAndroidOffscreenEditText::setMinEms(int minems)
 {
+	custom_properties_set_ = true;
 	if (QJniObject * view = offscreenView())
 	{
 		view->callVoid("setMinEms", jint(minems));
@@ -256,6 +387,7 @@ void QAndroidOffscreenEditText::setMinEms(int minems)
 
 void QAndroidOffscreenEditText::setMaxHeight(int maxHeight)
 {
+	custom_properties_set_ = true;
 	if (QJniObject * view = offscreenView())
 	{
 		view->callVoid("setMaxHeight", jint(maxHeight));
@@ -264,6 +396,7 @@ void QAndroidOffscreenEditText::setMaxHeight(int maxHeight)
 
 void QAndroidOffscreenEditText::setMinHeight(int minHeight)
 {
+	custom_properties_set_ = true;
 	if (QJniObject * view = offscreenView())
 	{
 		view->callVoid("setMinHeight", jint(minHeight));
@@ -272,6 +405,11 @@ void QAndroidOffscreenEditText::setMinHeight(int minHeight)
 
 void QAndroidOffscreenEditText::setMaxLines(int maxlines)
 {
+	if (update_depth_ > 0)
+	{
+		pending_style_.setMaxLines(maxlines);
+		return;
+	}
 	if (QJniObject * view = offscreenView())
 	{
 		view->callVoid("setMaxLines", jint(maxlines));
@@ -280,6 +418,7 @@ void QAndroidOffscreenEditText::setMaxLines(int maxlines)
 
 void QAndroidOffscreenEditText::setMinLines(int minlines)
 {
+	custom_properties_set_ = true;
 	if (QJniObject * view = offscreenView())
 	{
 		view->callVoid("setMinLines", jint(minlines));
@@ -288,6 +427,7 @@ void QAndroidOffscreenEditText::setMinLines(int minlines)
 
 void QAndroidOffscreenEditText::setMaxWidth(int maxpixels)
 {
+	custom_properties_set_ = true;
 	if (QJniObject * view = offscreenView())
 	{
 		view->callVoid("setMaxWidth", jint(maxpixels));
@@ -296,6 +436,7 @@ void QAndroidOffscreenEditText::setMaxWidth(int maxpixels)
 
 void QAndroidOffscreenEditText::setMinWidth(int minpixels)
 {
+	custom_properties_set_ = true;
 	if (QJniObject * view = offscreenView())
 	{
 		view->callVoid("setMinWidth", jint(minpixels));
@@ -304,6 +445,11 @@ void QAndroidOffscreenEditText::setMinWidth(int minpixels)
 
 void QAndroidOffscreenEditText::setPadding(int left, int top, int right, int bottom)
 {
+	if (update_depth_ > 0)
+	{
+		pending_style_.setPadding(left, top, right, bottom);
+		return;
+	}
 	if (QJniObject * view = offscreenView())
 	{
 		view->callParamVoid("setPadding", "IIII", jint(left), jint(top), jint(right), jint(bottom));
@@ -312,6 +458,7 @@ void QAndroidOffscreenEditText::setPadding(int left, int top, int right, int bot
 
 void QAndroidOffscreenEditText::setPaintFlags(int flags)
 {
+	custom_properties_set_ = true;
 	if (QJniObject * view = offscreenView())
 	{
 		paint_flags_ = flags;
@@ -326,6 +473,11 @@ int QAndroidOffscreenEditText::getPaintFlags()
 
 void QAndroidOffscreenEditText::setSelectAllOnFocus(bool selectAllOnFocus)
 {
+	if (update_depth_ > 0)
+	{
+		pending_style_.setSelectAllOnFocus(selectAllOnFocus);
+		return;
+	}
 	if (QJniObject * view = offscreenView())
 	{
 		view->callVoid("setSelectAllOnFocus", jint(selectAllOnFocus));
@@ -334,6 +486,11 @@ void QAndroidOffscreenEditText::setSelectAllOnFocus(bool selectAllOnFocus)
 
 void QAndroidOffscreenEditText::setSingleLine(bool singleLine)
 {
+	if (update_depth_ > 0)
+	{
+		pending_style_.setSingleLine(singleLine);
+		return;
+	}
 	if (QJniObject * view = offscreenView())
 	{
 		view->callVoid("setSingleLine", jboolean(singleLine));
@@ -342,6 +499,11 @@ void QAndroidOffscreenEditText::setSingleLine(bool singleLine)
 
 void QAndroidOffscreenEditText::setTextColor(int color)
 {
+	if (update_depth_ > 0)
+	{
+		pending_style_.setTextColor(color);
+		return;
+	}
 	if (QJniObject * view = offscreenView())
 	{
 		view->callVoid("setTextColor", jint(color));
@@ -350,6 +512,7 @@ void QAndroidOffscreenEditText::setTextColor(int color)
 
 void QAndroidOffscreenEditText::setTextScaleX(float size)
 {
+	custom_properties_set_ = true;
 	if (QJniObject * view = offscreenView())
 	{
 		view->callVoid("setTextScaleX", jfloat(size));
@@ -358,6 +521,7 @@ void QAndroidOffscreenEditText::setTextScaleX(float size)
 
 void QAndroidOffscreenEditText::setTextIsSelectable(bool selectable)
 {
+	custom_properties_set_ = true;
 	if (QJniObject * view = offscreenView())
 	{
 		view->callVoid("setTextIsSelectable", jboolean(selectable));
@@ -366,6 +530,11 @@ void QAndroidOffscreenEditText::setTextIsSelectable(bool selectable)
 
 void QAndroidOffscreenEditText::setGravity(int gravity)
 {
+	if (update_depth_ > 0)
+	{
+		pending_style_.setGravity(gravity);
+		return;
+	}
 	if (QJniObject * view = offscreenView())
 	{
 		view->callVoid("setGravity", jint(gravity));
@@ -374,6 +543,7 @@ void QAndroidOffscreenEditText::setGravity(int gravity)
 
 void QAndroidOffscreenEditText::setHeight(int pixels)
 {
+	custom_properties_set_ = true;
 	if (QJniObject * view = offscreenView())
 	{
 		view->callVoid("setHeight", jint(pixels));
@@ -382,6 +552,11 @@ void QAndroidOffscreenEditText::setHeight(int pixels)
 
 void QAndroidOffscreenEditText::setHighlightColor(int color)
 {
+	if (update_depth_ > 0)
+	{
+		pending_style_.setHighlightColor(color);
+		return;
+	}
 	if (QJniObject * view = offscreenView())
 	{
 		view->callVoid("setHighlightColor", jint(color));
@@ -390,6 +565,11 @@ void QAndroidOffscreenEditText::setHighlightColor(int color)
 
 void QAndroidOffscreenEditText::setHint(const QString & hint)
 {
+	if (update_depth_ > 0)
+	{
+		pending_style_.setHint(hint);
+		return;
+	}
 	if (QJniObject * view = offscreenView())
 	{
 		view->callVoid("setHint", hint);
@@ -398,6 +578,11 @@ void QAndroidOffscreenEditText::setHint(const QString & hint)
 
 void QAndroidOffscreenEditText::setHintTextColor(int color)
 {
+	if (update_depth_ > 0)
+	{
+		pending_style_.setHintTextColor(color);
+		return;
+	}
 	if (QJniObject * view = offscreenView())
 	{
 		view->callVoid("setHintTextColor", jint(color));
@@ -406,6 +591,7 @@ void QAndroidOffscreenEditText::setHintTextColor(int color)
 
 void QAndroidOffscreenEditText::setWidth(int pixels)
 {
+	custom_properties_set_ = true;
 	if (QJniObject * view = offscreenView())
 	{
 		view->callVoid("setWidth", jint(pixels));
@@ -414,6 +600,7 @@ void QAndroidOffscreenEditText::setWidth(int pixels)
 
 void QAndroidOffscreenEditText::setLineSpacing(float add, float mult)
 {
+	custom_properties_set_ = true;
 	if (QJniObject * view = offscreenView())
 	{
 		view->callParamVoid("setLineSpacing", "FF", jfloat(add), jfloat(mult));
@@ -422,6 +609,7 @@ void QAndroidOffscreenEditText::setLineSpacing(float add, float mult)
 
 void QAndroidOffscreenEditText::setLines(int lines)
 {
+	custom_properties_set_ = true;
 	if (QJniObject * view = offscreenView())
 	{
 		view->callVoid("setLines", jint(lines));
@@ -430,6 +618,7 @@ void QAndroidOffscreenEditText::setLines(int lines)
 
 void QAndroidOffscreenEditText::setHorizontallyScrolling(bool whether)
 {
+	custom_properties_set_ = true;
 	if (QJniObject * view = offscreenView())
 	{
 		view->callVoid("setHorizontallyScrolling", jboolean(whether));
@@ -438,6 +627,7 @@ void QAndroidOffscreenEditText::setHorizontallyScrolling(bool whether)
 
 void QAndroidOffscreenEditText::setAllCaps(bool allCaps)
 {
+	custom_properties_set_ = true;
 	if (QJniObject * view = offscreenView())
 	{
 		view->callVoid("setAllCaps", jboolean(allCaps));
@@ -446,6 +636,7 @@ void QAndroidOffscreenEditText::setAllCaps(bool allCaps)
 
 void QAndroidOffscreenEditText::setPasswordMode()
 {
+	custom_properties_set_ = true;
 	if (QJniObject * view = offscreenView())
 	{
 		view->callVoid("setPasswordMode");
@@ -454,6 +645,7 @@ void QAndroidOffscreenEditText::setPasswordMode()
 
 void QAndroidOffscreenEditText::setPasswordModeWithDefaultTypeface(bool enable)
 {
+	custom_properties_set_ = true;
 	if (QJniObject * view = offscreenView())
 	{
 		view->callVoid("setPasswordModeWithDefaultTypeface", jboolean(enable));
@@ -462,6 +654,11 @@ void QAndroidOffscreenEditText::setPasswordModeWithDefaultTypeface(bool enable)
 
 void QAndroidOffscreenEditText::setImeOptions(int and_mask, int or_mask)
 {
+	if (update_depth_ > 0)
+	{
+		pending_style_.setImeOptions(and_mask, or_mask);
+		return;
+	}
 	if (QJniObject * view = offscreenView())
 	{
 		view->callParamVoid("setImeOptions", "II", static_cast<jint>(and_mask), static_cast<jint>(or_mask));
@@ -470,6 +667,7 @@ void QAndroidOffscreenEditText::setImeOptions(int and_mask, int or_mask)
 
 void QAndroidOffscreenEditText::setEllipsize(AndroidTruncateAt ellipsis)
 {
+	custom_properties_set_ = true;
 	if (QJniObject * view = offscreenView())
 	{
 		view->callVoid("setEllipsize", jint(ellipsis));
@@ -511,6 +709,7 @@ int QAndroidOffscreenEditText::getSelectionStart()
 
 void QAndroidOffscreenEditText::setHorizontalScrollBarEnabled(bool horizontalScrollBarEnabled)
 {
+	custom_properties_set_ = true;
 	if (QJniObject * view = offscreenView())
 	{
 		view->callVoid("setHorizontalScrollBarEnabled", jboolean(horizontalScrollBarEnabled));
@@ -519,6 +718,7 @@ void QAndroidOffscreenEditText::setHorizontalScrollBarEnabled(bool horizontalScr
 
 void QAndroidOffscreenEditText::setVerticalScrollBarEnabled(bool verticalScrollBarEnabled)
 {
+	custom_properties_set_ = true;
 	if (QJniObject * view = offscreenView())
 	{
 		view->callVoid("setVerticalScrollBarEnabled", jboolean(verticalScrollBarEnabled));
@@ -551,6 +751,7 @@ void QAndroidOffscreenEditText::setHintTextColor(const QColor & color)
 
 void QAndroidOffscreenEditText::setAllowFullscreenKeyboard(bool allow)
 {
+	custom_properties_set_ = true;
 	if (QJniObject * view = offscreenView())
 	{
 		view->callVoid("setAllowFullscreenKeyboard", jboolean(allow));
@@ -559,6 +760,7 @@ void QAndroidOffscreenEditText::setAllowFullscreenKeyboard(bool allow)
 
 void QAndroidOffscreenEditText::setCursorColorToTextColor()
 {
+	custom_properties_set_ = true;
 	if (QJniObject * view = offscreenView())
 	{
 		view->callVoid("setCursorColorToTextColor");
@@ -567,12 +769,203 @@ void QAndroidOffscreenEditText::setCursorColorToTextColor()
 
 void QAndroidOffscreenEditText::setMaxLength(int length)
 {
+	custom_properties_set_ = true;
 	if (QJniObject * view = offscreenView())
 	{
 		view->callVoid("setMaxLength", jint(length));
 	}
 }
 
+
+QAndroidOffscreenEditText::Style::Style()
+{
+	clear();
+}
+
+void QAndroidOffscreenEditText::Style::clear()
+{
+	fields_ = 0;
+	for (int i = 0; i < INT_COUNT; ++i)
+	{
+		ints_[i] = 0;
+	}
+	ints_[INT_IME_AND] = ~0;
+	text_size_ = 0.0f;
+	typeface_.clear();
+	hint_.clear();
+	line_ops_.clear();
+}
+
+void QAndroidOffscreenEditText::Style::setTextSize(float size, int unit)
+{
+	fields_ |= FIELD_TEXT_SIZE;
+	text_size_ = size;
+	ints_[INT_TEXT_SIZE_UNIT] = unit;
+}
+
+void QAndroidOffscreenEditText::Style::setTypeface(const QString & name, int style)
+{
+	fields_ |= FIELD_TYPEFACE;
+	typeface_ = name;
+	ints_[INT_TYPEFACE_STYLE] = style;
+}
+
+void QAndroidOffscreenEditText::Style::setCursorVisible(bool visible)
+{
+	fields_ |= FIELD_CURSOR_VISIBLE;
+	ints_[INT_CURSOR_VISIBLE] = (visible)? 1: 0;
+}
+
+void QAndroidOffscreenEditText::Style::addLineOp(Field field, int a, int b)
+{
+	fields_ |= field;
+	int last = line_ops_.size() - 3;
+	if (last >= 0 && line_ops_.at(last) == field)
+	{
+		if (field == FIELD_INPUT_TYPE)
+		{
+			// Combine with the previous masks so the result is the same as applying them one by one.
+			line_ops_[last + 1] &= a;
+			line_ops_[last + 2] = (line_ops_.at(last + 2) & a) | b;
+		}
+		else
+		{
+			line_ops_[last + 1] = a;
+			line_ops_[last + 2] = b;
+		}
+		return;
+	}
+	line_ops_.append(field);
+	line_ops_.append(a);
+	line_ops_.append(b);
+}
+
+void QAndroidOffscreenEditText::Style::setInputType(int type)
+{
+	addLineOp(FIELD_INPUT_TYPE, 0, type);
+}
+
+void QAndroidOffscreenEditText::Style::setInputType(int type_and, int type_or)
+{
+	addLineOp(FIELD_INPUT_TYPE, type_and, type_or);
+}
+
+void QAndroidOffscreenEditText::Style::setMaxLines(int maxlines)
+{
+	addLineOp(FIELD_MAX_LINES, maxlines, 0);
+}
+
+void QAndroidOffscreenEditText::Style::setPadding(int left, int top, int right, int bottom)
+{
+	fields_ |= FIELD_PADDING;
+	ints_[INT_PADDING_LEFT] = left;
+	ints_[INT_PADDING_TOP] = top;
+	ints_[INT_PADDING_RIGHT] = right;
+	ints_[INT_PADDING_BOTTOM] = bottom;
+}
+
+void QAndroidOffscreenEditText::Style::setSelectAllOnFocus(bool selectAllOnFocus)
+{
+	fields_ |= FIELD_SELECT_ALL_ON_FOCUS;
+	ints_[INT_SELECT_ALL_ON_FOCUS] = (selectAllOnFocus)? 1: 0;
+}
+
+void QAndroidOffscreenEditText::Style::setSingleLine(bool singleLine)
+{
+	addLineOp(FIELD_SINGLE_LINE, (singleLine)? 1: 0, 0);
+}
+
+void QAndroidOffscreenEditText::Style::setTextColor(int color)
+{
+	fields_ |= FIELD_TEXT_COLOR;
+	ints_[INT_TEXT_COLOR] = color;
+}
+
+void QAndroidOffscreenEditText::Style::setGravity(int gravity)
+{
+	fields_ |= FIELD_GRAVITY;
+	ints_[INT_GRAVITY] = gravity;
+}
+
+void QAndroidOffscreenEditText::Style::setHighlightColor(int color)
+{
+	fields_ |= FIELD_HIGHLIGHT_COLOR;
+	ints_[INT_HIGHLIGHT_COLOR] = color;
+}
+
+void QAndroidOffscreenEditText::Style::setHint(const QString & hint)
+{
+	fields_ |= FIELD_HINT;
+	hint_ = hint;
+}
+
+void QAndroidOffscreenEditText::Style::setHintTextColor(int color)
+{
+	fields_ |= FIELD_HINT_TEXT_COLOR;
+	ints_[INT_HINT_TEXT_COLOR] = color;
+}
+
+void QAndroidOffscreenEditText::Style::setImeOptions(int and_mask, int or_mask)
+{
+	fields_ |= FIELD_IME_OPTIONS;
+	ints_[INT_IME_AND] &= and_mask;
+	ints_[INT_IME_OR] = (ints_[INT_IME_OR] & and_mask) | or_mask;
+}
+
+void QAndroidOffscreenEditText::applyStyle(const Style & style)
+{
+	if (style.isEmpty())
+	{
+		return;
+	}
+	if (QJniObject * view = offscreenView())
+	{
+		QJniEnvPtr jep;
+		JNIEnv * env = jep.env();
+		jsize line_ops_size = static_cast<jsize>(style.line_ops_.size());
+		jintArray ints = env->NewIntArray(Style::INT_COUNT + line_ops_size);
+		if (!ints || jep.clearException())
+		{
+			qWarning()<<"Failed to allocate style array!";
+			return;
+		}
+		env->SetIntArrayRegion(ints, 0, Style::INT_COUNT, reinterpret_cast<const jint*>(style.ints_));
+		if (line_ops_size > 0)
+		{
+			env->SetIntArrayRegion(ints, Style::INT_COUNT, line_ops_size, reinterpret_cast<const jint*>(style.line_ops_.constData()));
+		}
+		QJniLocalRef strings(env->NewObjectArray(2, QJniClass("java/lang/String").jClass(), 0));
+		env->SetObjectArrayElement(static_cast<jobjectArray>(strings.jObject()), 0, QJniLocalRef(style.typeface_).jObject());
+		env->SetObjectArrayElement(static_cast<jobjectArray>(strings.jObject()), 1, QJniLocalRef(style.hint_).jObject());
+		view->callParamVoid("applyStyle", "I[IF[Ljava/lang/String;"
+			, jint(style.fields_)
+			, ints
+			, jfloat(style.text_size_)
+			, static_cast<jobjectArray>(strings.jObject()));
+		env->DeleteLocalRef(ints);
+	}
+}
+
+void QAndroidOffscreenEditText::beginUpdate()
+{
+	++update_depth_;
+}
+
+void QAndroidOffscreenEditText::commitUpdate()
+{
+	if (update_depth_ <= 0)
+	{
+		qWarning()<<"commitUpdate() without beginUpdate()!";
+		return;
+	}
+	if (--update_depth_ == 0)
+	{
+		Style style = pending_style_;
+		pending_style_.clear();
+		applyStyle(style);
+	}
+}
+
 int QAndroidOffscreenEditText::getSystemDrawMode()
 {
 	if (QJniObject * view = offscreenView())
@@ -584,6 +977,7 @@ int QAndroidOffscreenEditText::getSystemDrawMode()
 
 void QAndroidOffscreenEditText::setSystemDrawMode(int mode)
 {
+	custom_properties_set_ = true;
 	if (QJniObject * view = offscreenView())
 	{
 		view->callVoid("setSystemDrawMode", static_cast<jint>(mode));
@@ -35,6 +35,8 @@
 */
 
 #pragma once
+#include <QtCore/QMutex>
+#include <QtCore/QVector>
 #include "QAndroidOffscreenView.h"
 
 class QAndroidOffscreenEditText
@@ -52,13 +54,31 @@ public:
 	 */
 	static void preloadJavaClasses();
 
+	/*!
+	 * Clears the text and restores the properties which can be set via Style.
+	 * Returns false if any other property (e.g. max length or a typeface from file)
+	 * has been changed, because there is no way to restore it.
+	 */
+	virtual bool resetForReuse();
+
 	//
 	// EditText functions
 	//
 
 	void setText(const QString & text);
+
+	//! In text delta mode, returns a copy of the text kept on C++ side, without calling Java.
 	QString getText() const;
 
+	bool textDeltaMode() const { return text_delta_mode_; }
+
+	/*!
+	 * In text delta mode (default), Java sends only the changed part of the text on each edit
+	 * and C++ keeps the whole text by applying the changes. Otherwise the whole text is sent.
+	 * The signals are the same in both modes.
+	 */
+	void setTextDeltaMode(bool enabled);
+
 	// More constants: http://developer.android.com/reference/android/util/TypedValue.html
 	static const int
 		ANDROID_TYPEDVALUE_COMPLEX_UNIT_DIP	= 0x00000001,
@@ -335,6 +355,112 @@ public:
 	void setCursorColorToTextColor();
 	void setMaxLength(int length);
 
+	//
+	// Batched property application
+	//
+
+	/*!
+	 * A set of EditText properties which is applied at once: with one JNI call and
+	 * one runnable in Android UI thread. Only the properties which have been set are applied.
+	 * Input type, single line mode and max lines change each other, so they are applied first
+	 * and in the order of the calls, giving the same result as separate calls. The other
+	 * properties are applied after them in a fixed order (typeface and size, then everything else).
+	 */
+	class Style
+	{
+	public:
+		Style();
+		bool isEmpty() const { return fields_ == 0; }
+		void clear();
+
+		void setTextSize(float size, int unit = ANDROID_TYPEDVALUE_COMPLEX_UNIT_PX);
+		void setTypeface(const QString & name, int style = ANDROID_TYPEFACE_NORMAL);
+		void setCursorVisible(bool visible);
+		void setInputType(int type);
+		void setInputType(int type_and, int type_or);
+		void setMaxLines(int maxlines);
+		void setPadding(int left, int top, int right, int bottom);
+		void setSelectAllOnFocus(bool selectAllOnFocus);
+		void setSingleLine(bool singleLine = true);
+		void setTextColor(int color);
+		void setGravity(int gravity);
+		void setHighlightColor(int color);
+		void setHint(const QString & hint);
+		void setHintTextColor(int color);
+		void setImeOptions(int and_mask, int or_mask);
+
+	private:
+		friend class QAndroidOffscreenEditText;
+
+		// Bits of fields_; must match OffscreenEditText.STYLE_... in Java.
+		enum Field
+		{
+			FIELD_TEXT_SIZE				= 0x0001,
+			FIELD_TYPEFACE				= 0x0002,
+			FIELD_CURSOR_VISIBLE		= 0x0004,
+			FIELD_INPUT_TYPE			= 0x0008,
+			FIELD_MAX_LINES				= 0x0010,
+			FIELD_PADDING				= 0x0020,
+			FIELD_SELECT_ALL_ON_FOCUS	= 0x0040,
+			FIELD_SINGLE_LINE			= 0x0080,
+			FIELD_TEXT_COLOR			= 0x0100,
+			FIELD_GRAVITY				= 0x0200,
+			FIELD_HIGHLIGHT_COLOR		= 0x0400,
+			FIELD_HINT					= 0x0800,
+			FIELD_HINT_TEXT_COLOR		= 0x1000,
+			FIELD_IME_OPTIONS			= 0x2000
+		};
+
+		// Indexes in ints_; must match OffscreenEditText.STYLE_INT_... in Java.
+		enum IntIndex
+		{
+			INT_TEXT_SIZE_UNIT = 0,
+			INT_TYPEFACE_STYLE,
+			INT_CURSOR_VISIBLE,
+			INT_PADDING_LEFT,
+			INT_PADDING_TOP,
+			INT_PADDING_RIGHT,
+			INT_PADDING_BOTTOM,
+			INT_SELECT_ALL_ON_FOCUS,
+			INT_TEXT_COLOR,
+			INT_GRAVITY,
+			INT_HIGHLIGHT_COLOR,
+			INT_HINT_TEXT_COLOR,
+			INT_IME_AND,
+			INT_IME_OR,
+			INT_COUNT
+		};
+
+		//! Record a change of input type, single line mode or max lines in line_ops_.
+		void addLineOp(Field field, int a, int b);
+
+		int fields_;
+		int ints_[INT_COUNT];
+		/*!
+		 * Changes of input type (and, or masks), single line mode and max lines,
+		 * as (field, a, b) triples in order of the calls. A change of the same property
+		 * as the previous one is merged into it. Sent to Java after ints_.
+		 */
+		QVector<int> line_ops_;
+		float text_size_;
+		QString typeface_;
+		QString hint_;
+	};
+
+	//! Apply all properties set in the style with one JNI call.
+	void applyStyle(const Style & style);
+
+	/*!
+	 * Start collecting calls to the setters which are supported by Style (setTextSize(),
+	 * setTypeface(), setTextColor(), setPadding() etc.) instead of calling Java for each
+	 * of them. The collected properties are applied by the matching commitUpdate(),
+	 * so e.g. the text is reflown only once. The calls may be nested.
+	 * Note that all other functions still go to Java immediately, i.e. before the collected properties.
+	 */
+	void beginUpdate();
+	void commitUpdate();
+	bool isUpdating() const { return update_depth_ > 0; }
+
 	//
 	// Drawing mode hack
 	//
@@ -352,6 +478,9 @@ signals:
 	//! Simple notification that the text has been changed.
 	void onTextChanged();
 
+	//! \a before characters starting at \a start have been replaced with \a inserted.
+	void onTextDelta(int start, int before, QString inserted);
+
 	//! Emitted when KEYCODE_DPAD_CENTER or KEYCODE_ENTER has been released.
 	void onEnter();
 
@@ -555,15 +684,28 @@ signals:
 
 protected:
 	virtual void javaOnTextChanged(const QString & str, int start, int before, int count);
+	virtual void javaOnTextDelta(const QString & inserted, int start, int before, int count, int length);
 	virtual bool javaOnKey(bool down, int androidKey);
 	virtual void javaOnEditorAction(int action);
 
 private:
 	friend void JNICALL Java_AndroidOffscreenEditText_nativeOnTextChanged(JNIEnv * env, jobject jo, jlong param, jstring str, jint start, jint before, jint count);
+	friend void JNICALL Java_AndroidOffscreenEditText_nativeOnTextDelta(JNIEnv * env, jobject jo, jlong param, jstring inserted, jint start, jint before, jint count, jint length);
 	friend jboolean JNICALL Java_AndroidOffscreenEditText_nativeOnKey(JNIEnv * env, jobject jo, jlong param, jboolean down, jint keycode);
 	friend void JNICALL Java_AndroidOffscreenEditText_nativeOnEditorAction(JNIEnv *, jobject, jlong param, jint action);
 
 private:
 	int paint_flags_;
+	bool text_delta_mode_;
+	//! Copy of the text maintained in text delta mode; protected by text_mutex_ as it is updated in Android UI thread.
+	QString text_;
+	//! Set to false when text_ can't be trusted, so the text will be re-read from Java.
+	bool text_valid_;
+	mutable QMutex text_mutex_;
+	int update_depth_;
+	//! Properties collected between beginUpdate() and commitUpdate().
+	Style pending_style_;
+	//! A property which resetForReuse() can't restore has been changed.
+	bool custom_properties_set_;
 };
 
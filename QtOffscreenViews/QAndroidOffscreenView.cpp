@@ -36,20 +36,45 @@
 
 #include <unistd.h>
 #include <stdlib.h>
+#include <time.h>
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
 #include <QtCore/QThread>
 #include <QtCore/QTimer>
 #include <QtCore/QMutexLocker>
 #include <QtCore/QCoreApplication>
+#include <QtCore/QSet>
 #include <QAndroidQPAPluginGap.h>
 #include "QAndroidJniImagePair.h"
+#include "QAndroidJniNativesRegistry.h"
 #include "QAndroidOffscreenView.h"
 
 // Set in QAndroidOffsceenView::initializeGL.
 static bool s_have_to_adjust_size_to_pot = true;
 static QSize s_max_gl_size;
 
+/*!
+ * One-time registry of preloaded Java classes shared by all offscreen view types
+ * (native methods are registered once per class by QAndroidJniNativesRegistry).
+ * The mutex is recursive because preloading of a derived class preloads the base classes.
+ */
+static QMutex & javaClassRegistryMutex()
+{
+	static QMutex mutex(QMutex::Recursive);
+	return mutex;
+}
+
+static QSet<QString> & preloadedJavaClasses()
+{
+	static QSet<QString> classes;
+	return classes;
+}
+
+static QString fullViewClassName(const QString & class_name)
+{
+	return (class_name.contains('/'))? class_name: QAndroidOffscreenView::getDefaultJavaClassPath() + class_name;
+}
+
 //! Calculate smallest power of 2 which is greater than x.
 static int potSize(int x, int max_possible)
 {
@@ -83,7 +108,38 @@ static QSize potSize(const QSize & size, const QSize & maxsize)
 
 static const QString c_class_path_(QLatin1String("ru/dublgis/offscreenview/"));
 
-Q_DECL_EXPORT void JNICALL Java_OffscreenView_nativeUpdate(JNIEnv *, jobject, jlong param)
+//! If moves are flushed on Qt frames, the timer sends them only if no frame comes for this long.
+static const int c_touch_flush_fallback_ms = 50;
+
+//! Read QAtomicInt in a way which works both in Qt 4 and Qt 5.
+static inline int atomicLoad(QAtomicInt & value)
+{
+	return value.fetchAndAddOrdered(0);
+}
+
+/*!
+ * Unlocks a mutex locked by a successful tryLock() when leaving the scope
+ * (QMutexLocker can only lock the mutex by itself).
+ */
+class TryLockedMutexUnlocker
+{
+public:
+	explicit TryLockedMutexUnlocker(QMutex * mutex): mutex_(mutex) {}
+	~TryLockedMutexUnlocker() { mutex_->unlock(); }
+private:
+	QMutex * mutex_;
+	Q_DISABLE_COPY(TryLockedMutexUnlocker)
+};
+
+//! The same clock as Java System.nanoTime().
+static qint64 monotonicNs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return qint64(ts.tv_sec) * Q_INT64_C(1000000000) + qint64(ts.tv_nsec);
+}
+
+Q_DECL_EXPORT void JNICALL Java_OffscreenView_nativeUpdate(JNIEnv *, jobject, jlong param, jlong paint_started_ns, jint dirty_left, jint dirty_top, jint dirty_right, jint dirty_bottom)
 {
 	if (param)
 	{
@@ -91,7 +147,9 @@ Q_DECL_EXPORT void JNICALL Java_OffscreenView_nativeUpdate(JNIEnv *, jobject, jl
 		QAndroidOffscreenView * proxy = reinterpret_cast<QAndroidOffscreenView*>(vp);
 		if (proxy)
 		{
-			proxy->javaUpdate();
+			proxy->javaUpdate(
+				static_cast<qint64>(paint_started_ns),
+				QRect(dirty_left, dirty_top, dirty_right - dirty_left, dirty_bottom - dirty_top));
 			return;
 		}
 	}
@@ -113,6 +171,11 @@ Q_DECL_EXPORT void JNICALL Java_OffscreenView_nativeViewCreated(JNIEnv *, jobjec
 	qWarning()<<__FUNCTION__<<"Zero param!";
 }
 
+Q_DECL_EXPORT void JNICALL Java_OffscreenView_onTrimMemory(JNIEnv *, jclass, jint level)
+{
+	QApplicationActivityObserver::instance()->trimMemory(int(level));
+}
+
 Q_DECL_EXPORT void JNICALL Java_OffscreenView_onVisibleRect(JNIEnv *, jobject, jlong param, int left, int top, int right, int bottom)
 {
 	if (param)
@@ -140,27 +203,74 @@ QAndroidOffscreenView::QAndroidOffscreenView(
 	, tex_()
 	, android_to_qt_buffer_()
 	, last_qt_buffer_(-1)
+	, taken_dirty_rect_()
 	, bitmap_a_(32)
 	, bitmap_b_(32)
+	, retired_bitmaps_()
+	, bitmaps_generation_(0)
+	, busy_bitmaps_generation_(0)
+	, free_bitmaps_generation_(0)
+	, java_bitmaps_busy_(false)
 	, bitmaps_mutex_(QMutex::Recursive)
 	, size_(defsize)
 	, fill_color_(Qt::white)
-	, need_update_texture_(false)
+	, bitmap_format_policy_(BitmapFormat32Bit)
+	, published_frame_(0)
+	, taken_frame_(0)
 	, view_painted_(false)
 	, texture_received_(false)
 	, view_creation_requested_(false)
 	, is_visible_(false)
 	, is_enabled_(true)
+	, is_painting_paused_(false)
+	, max_update_rate_(0)
+	, vsync_pacing_(false)
+	, use_texture_atlas_(false)
+	, memory_trim_level_(QApplicationActivityObserver::TrimMemoryUiHidden)
+	, touch_batching_(true)
+	, touch_flushed_by_frames_(false)
+	, touch_samples_()
+	, touch_flush_timer_()
+	, touch_batch_started_ns_(0)
+	, touch_latency_started_ns_(0)
+	, command_buffering_(true)
+	, commands_()
+	, command_flush_timer_()
+	, commands_started_ns_(0)
+	, resources_trimmed_(false)
+	, snapshot_()
+	, snapshot_pinned_(false)
+	, snapshot_uploaded_(false)
 	, view_created_(false)
 	, last_texture_width_(0)
 	, last_texture_height_(0)
+	, statistics_()
+	, statistics_mutex_()
+	, last_update_time_ns_(0)
+	, statistics_log_timer_()
+	, frame_state_()
+	, frame_state_buffer_()
 {
+	connect(&statistics_log_timer_, SIGNAL(timeout()), this, SLOT(logFrameStatistics()));
+	// Java may still paint on the replaced bitmaps, see setJavaBitmaps().
+	bitmap_a_.setDeferredRelease(true);
+	bitmap_b_.setDeferredRelease(true);
+	touch_flush_timer_.setSingleShot(true);
+	connect(&touch_flush_timer_, SIGNAL(timeout()), this, SLOT(flushTouchEvents()));
+	command_flush_timer_.setSingleShot(true);
+	connect(&command_flush_timer_, SIGNAL(timeout()), this, SLOT(flushCommands()));
+
 	connect(
 		QApplicationActivityObserver::instance(),
 		SIGNAL(applicationActiveStateChanged()),
 		this,
 		SLOT(applicationActivityStatusChanged()),
 		Qt::DirectConnection);
+	connect(
+		QApplicationActivityObserver::instance(),
+		SIGNAL(memoryTrimRequested(int)),
+		this,
+		SLOT(onMemoryTrimRequested(int)));
 
 	preloadJavaClasses();
 
@@ -186,6 +296,21 @@ QAndroidOffscreenView::QAndroidOffscreenView(
 		offscreen_view_->callParamVoid("setFillColor", "IIII",
 			jint(fill_color_.alpha()), jint(fill_color_.red()), jint(fill_color_.green()), jint(fill_color_.blue()));
 
+		// Share frame_state_ with Java, so updateGlTexture() / getBitmapBuffer() need only one JNI call
+		{
+			QJniEnvPtr jep;
+			jobject buffer = jep.env()->NewDirectByteBuffer(&frame_state_, jlong(sizeof(frame_state_)));
+			if (buffer && !jep.clearException())
+			{
+				frame_state_buffer_.reset(new QJniObject(buffer, true));
+				offscreen_view_->callParamVoid("setFrameStateBuffer", "Ljava/nio/ByteBuffer;", frame_state_buffer_->jObject());
+			}
+			else
+			{
+				qWarning()<<__PRETTY_FUNCTION__<<"Failed to create direct ByteBuffer, will use slower frame state queries.";
+			}
+		}
+
 		// Our descendant constructors may want to register natives before createView is actually
 		// called, so let's invoke it through the message queue rather than calling directly.
 		QMetaObject::invokeMethod(this, "createView", Qt::QueuedConnection);
@@ -232,8 +357,9 @@ const QString & QAndroidOffscreenView::getDefaultJavaClassPath()
 
 void QAndroidOffscreenView::preloadJavaClasses()
 {
-	static volatile bool preloaded_ = false;
+	static bool preloaded_ = false;
 
+	QMutexLocker locker(&javaClassRegistryMutex());
 	if (!preloaded_)
 	{
 		preloaded_ = true;
@@ -246,13 +372,53 @@ void QAndroidOffscreenView::preloadJavaClasses()
 
 		QJniClass ov("ru/dublgis/offscreenview/OffscreenView");
 		static const JNINativeMethod methods[] = {
-			{"nativeUpdate", "(J)V", reinterpret_cast<void*>(Java_OffscreenView_nativeUpdate)},
+			{"nativeUpdate", "(JJIIII)V", reinterpret_cast<void*>(Java_OffscreenView_nativeUpdate)},
 			{"nativeViewCreated", "(J)V", reinterpret_cast<void*>(Java_OffscreenView_nativeViewCreated)},
 			{"getActivity", "()Landroid/app/Activity;", reinterpret_cast<void*>(QAndroidQPAPluginGap::getActivityNoThrow)},
 			{"nativeOnVisibleRect", "(JIIII)V", reinterpret_cast<void*>(Java_OffscreenView_onVisibleRect)},
+			{"nativeOnTrimMemory", "(I)V", reinterpret_cast<void*>(Java_OffscreenView_onTrimMemory)},
 		};
-		ov.registerNativeMethods(methods, sizeof(methods));
+		if (!QAndroidJniNativesRegistry::registerNatives(QJniEnvPtr().env(), ov.jClass(), "ru/dublgis/offscreenview/OffscreenView"
+			, methods, int(sizeof(methods) / sizeof(methods[0]))))
+		{
+			qCritical()<<"Failed to register native methods of OffscreenView";
+		}
+	}
+}
+
+void QAndroidOffscreenView::preloadViewJavaClass(const QString & class_name)
+{
+	QString full_name = fullViewClassName(class_name);
+	QMutexLocker locker(&javaClassRegistryMutex());
+	preloadJavaClasses();
+	if (!preloadedJavaClasses().contains(full_name))
+	{
+		QAndroidQPAPluginGap::preloadJavaClass(full_name.toLatin1());
+		preloadedJavaClasses().insert(full_name);
+	}
+}
+
+bool QAndroidOffscreenView::registerViewNativeMethods(const JNINativeMethod * methods, size_t sizeof_methods)
+{
+	QByteArray class_name = view_class_name_.toLatin1();
+	if (QAndroidJniNativesRegistry::isRegistered(class_name.constData()))
+	{
+		return true;
+	}
+	QJniObject * view = offscreenView();
+	if (!view)
+	{
+		qCritical()<<"Failed to register native methods of"<<view_class_name_<<"because Java object pointer is null.";
+		return false;
+	}
+	qDebug()<<__PRETTY_FUNCTION__<<"Registering"<<sizeof_methods/sizeof(JNINativeMethod)<<"JNI methods for"<<view_class_name_;
+	if (!QAndroidJniNativesRegistry::registerNatives(QJniEnvPtr().env(), view->jClass(), class_name.constData()
+		, methods, int(sizeof_methods / sizeof(JNINativeMethod))))
+	{
+		qCritical()<<"Failed to register native methods of"<<view_class_name_;
+		return false;
 	}
+	return true;
 }
 
 static int getApiLevel()
@@ -280,7 +446,7 @@ bool QAndroidOffscreenView::nonAttachingModeSupported()
 
 void QAndroidOffscreenView::initializeGL()
 {
-	if (tex_.isAllocated() || bitmap_a_.isAllocated())
+	if (isIntialized())
 	{
 		// qDebug("QAndroidOffscreenView GL is already initialized.");
 		return;
@@ -361,6 +527,12 @@ void QAndroidOffscreenView::initializeGL()
 		qDebug()<<__PRETTY_FUNCTION__<<"OpenGL mode is not supported on this device, will initialize for internal Bitmap mode.";
 		initializeBitmap();
 	}
+	else if (use_texture_atlas_)
+	{
+		// SurfaceTexture needs its own texture, so the atlas can only be used in Bitmap mode.
+		qDebug()<<__PRETTY_FUNCTION__<<"Texture atlas is used, will initialize for internal Bitmap mode.";
+		initializeBitmap();
+	}
 	else
 	{
 		tex_.allocateTexture(GL_TEXTURE_EXTERNAL_OES);
@@ -385,7 +557,7 @@ void QAndroidOffscreenView::initializeGL()
 void QAndroidOffscreenView::initializeBitmap()
 {
 	QMutexLocker locker(&bitmaps_mutex_);
-	if (tex_.isAllocated() || bitmap_a_.isAllocated())
+	if (isIntialized())
 	{
 		return;
 	}
@@ -396,6 +568,9 @@ void QAndroidOffscreenView::initializeBitmap()
 	}
 	// qDebug()<<__PRETTY_FUNCTION__;
 	QSize bitmapsize = (s_have_to_adjust_size_to_pot)? potSize(size_, s_max_gl_size): size_;
+	int bitness = desiredBitmapBitness();
+	bitmap_a_.setBitness(bitness);
+	bitmap_b_.setBitness(bitness);
 	bitmap_a_.resize(bitmapsize);
 	bitmap_b_.resize(bitmapsize);
 	last_qt_buffer_ = -1;
@@ -408,11 +583,28 @@ void QAndroidOffscreenView::initializeBitmap()
 
 void QAndroidOffscreenView::deleteAndroidView()
 {
+	touch_flush_timer_.stop();
+	touch_samples_.clear();
+	command_flush_timer_.stop();
+	commands_.clear();
 	if (offscreen_view_)
 	{
+		{
+			QMutexLocker locker(&bitmaps_mutex_);
+			// Java won't report the end of its current paint after cppDestroyed(),
+			// so the bitmaps it may be painting on now can never be reused.
+			java_bitmaps_busy_ = !setJavaBitmaps(jobject(0), jobject(0));
+		}
+		if (frame_state_buffer_)
+		{
+			offscreen_view_->callParamVoid("setFrameStateBuffer", "Ljava/nio/ByteBuffer;", jobject(0));
+		}
 		offscreen_view_->callVoid("cppDestroyed");
 		offscreen_view_.reset();
 	}
+	frame_state_buffer_.reset();
+	QMutexLocker locker(&bitmaps_mutex_);
+	releaseRetiredBitmaps(!java_bitmaps_busy_);
 }
 
 void QAndroidOffscreenView::deinitialize()
@@ -422,8 +614,27 @@ void QAndroidOffscreenView::deinitialize()
 	tex_.deallocateTexture();
 	bitmap_a_.dispose();
 	bitmap_b_.dispose();
+	releaseRetiredBitmaps(!java_bitmaps_busy_);
 	last_qt_buffer_ = -1;
 	android_to_qt_buffer_ = QImage();
+	snapshot_ = QImage();
+	snapshot_pinned_ = false;
+	snapshot_uploaded_ = false;
+	resources_trimmed_ = false;
+}
+
+bool QAndroidOffscreenView::resetForReuse()
+{
+	touch_flush_timer_.stop();
+	touch_samples_.clear();
+	{
+		QMutexLocker locker(&bitmaps_mutex_);
+		snapshot_ = QImage();
+		snapshot_pinned_ = false;
+		snapshot_uploaded_ = false;
+	}
+	// Without Android View there is nothing to reuse
+	return !offscreen_view_.isNull();
 }
 
 static inline void clearGlRect(int l, int b, int w, int h, const QColor & fill_color_)
@@ -452,14 +663,38 @@ void QAndroidOffscreenView::paintGL(int l, int b, int w, int h, bool reverse_y)
 	}
 }
 
+bool QAndroidOffscreenView::appendToBlitBatch(QList<QOpenGLTextureHolder::BlitItem> & batch, int l, int b, int w, int h, bool reverse_y)
+{
+	if (!updateGLTextureInHolder())
+	{
+		return false;
+	}
+	batch.append(QOpenGLTextureHolder::BlitItem(
+		&tex_
+		, QRect(l, b, w, h) // target rect (in window)
+		, QRect(QPoint(0, 0), QSize(w, h)) // source rect (in texture)
+		, reverse_y));
+	return true;
+}
+
 bool QAndroidOffscreenView::updateGLTextureInHolder()
 {
 	//
 	// GL texture + GL in Qt
 	//
-	if (tex_.isAllocated() && view_painted_ && !bitmap_a_.isAllocated())
+	qint64 started_ns = monotonicNs();
+	bool result = doUpdateGLTextureInHolder();
+	QMutexLocker stats_locker(&statistics_mutex_);
+	statistics_.texture_update_wait.add(monotonicNs() - started_ns);
+	return result;
+}
+
+bool QAndroidOffscreenView::doUpdateGLTextureInHolder()
+{
+	QOpenGLTextureHolder::deleteOrphanedTextures();
+	if (tex_.isAllocated() && view_painted_ && !bitmap_a_.isAllocated() && !resources_trimmed_)
 	{
-		if (need_update_texture_)
+		if (hasNewFrame())
 		{
 			bool texture_updated_ok = updateGlTexture();
 			if (!texture_updated_ok && !texture_received_)
@@ -477,7 +712,7 @@ bool QAndroidOffscreenView::updateGLTextureInHolder()
 	//
 	// Bitmap texture + GL in Qt
 	//
-	if (bitmap_a_.isAllocated())
+	if (bitmap_a_.isAllocated() || resources_trimmed_)
 	{
 		return updateBitmapToGlTexture();
 	}
@@ -528,35 +763,70 @@ const QImage * QAndroidOffscreenView::getBitmapBuffer(bool * out_texture_updated
 	if (bitmap_a_.isAllocated() && bitmap_b_.isAllocated()
 		&& view_painted_ && offscreen_view_ && offscreen_view_->jObject())
 	{
-		if (need_update_texture_ ||
+		if (hasNewFrame() ||
 			(convert_from_android_format && (android_to_qt_buffer_.isNull() || android_to_qt_buffer_.size() != size())) ||
 			(!convert_from_android_format && last_qt_buffer_ < 0))
 		{
-			need_update_texture_ = false;
-			int buffer_index = offscreen_view_->callInt("getQtPaintingTexture");
+			// If Java publishes one more frame while we're taking this one it will be taken next time.
+			int frame = atomicLoad(published_frame_);
+			qint64 started_ns = monotonicNs();
+			int buffer_index = -1;
+			if (frame_state_buffer_)
+			{
+				if (offscreen_view_->callParamBoolean("updateFrameState", "Z", jboolean(true)))
+				{
+					buffer_index = frame_state_.buffer_index;
+					last_texture_width_ = frame_state_.width;
+					last_texture_height_ = frame_state_.height;
+					taken_dirty_rect_ = QRect(
+						frame_state_.dirty_left,
+						frame_state_.dirty_top,
+						frame_state_.dirty_right - frame_state_.dirty_left,
+						frame_state_.dirty_bottom - frame_state_.dirty_top);
+				}
+			}
+			else
+			{
+				buffer_index = offscreen_view_->callInt("getQtPaintingTexture");
+				if (buffer_index >= 0)
+				{
+					last_texture_width_ = offscreen_view_->callInt("getLastTextureWidth");
+					last_texture_height_ = offscreen_view_->callInt("getLastTextureHeight");
+					taken_dirty_rect_ = QRect();
+				}
+			}
 			if (buffer_index < 0)
 			{
+				// Java is busy painting, the frame will be taken next time
 				return getPreviousBitmapBuffer(convert_from_android_format);
 			}
+			taken_frame_.fetchAndStoreOrdered(frame);
 			if (out_texture_updated)
 			{
 				*out_texture_updated = true;
 			}
-			last_texture_width_ = offscreen_view_->callInt("getLastTextureWidth");
-			last_texture_height_ = offscreen_view_->callInt("getLastTextureHeight");
+			frameTaken();
 
 			// Updating texture
+			const QImage * result = 0;
 			if (convert_from_android_format)
 			{
 				const QAndroidJniImagePair & pair = (buffer_index == 0)? bitmap_a_: bitmap_b_;
-				pair.convert32BitImageFromAndroidToQt(android_to_qt_buffer_);
-				return &android_to_qt_buffer_;
+				qint64 conversion_started_ns = monotonicNs();
+				// android_to_qt_buffer_ keeps the previous frame, so only the changed part is converted
+				pair.convert32BitImageFromAndroidToQt(android_to_qt_buffer_, taken_dirty_rect_);
+				QMutexLocker stats_locker(&statistics_mutex_);
+				statistics_.conversion.add(monotonicNs() - conversion_started_ns);
+				result = &android_to_qt_buffer_;
 			}
 			else
 			{
 				last_qt_buffer_ = buffer_index;
-				return (buffer_index == 0)? &bitmap_a_.qImage(): &bitmap_b_.qImage();
+				result = (buffer_index == 0)? &bitmap_a_.qImage(): &bitmap_b_.qImage();
 			}
+			QMutexLocker stats_locker(&statistics_mutex_);
+			statistics_.get_bitmap_buffer.add(monotonicNs() - started_ns);
+			return result;
 		}
 		else
 		{
@@ -572,16 +842,53 @@ const QImage * QAndroidOffscreenView::getBitmapBuffer(bool * out_texture_updated
 
 bool QAndroidOffscreenView::updateBitmapToGlTexture()
 {
-	QMutexLocker locker(&bitmaps_mutex_);
+	// This is typically called from the render thread, which should not wait while
+	// GUI thread is re-creating bitmaps. In such case, just keep showing the old texture.
+	if (!bitmaps_mutex_.tryLock())
+	{
+		QMutexLocker stats_locker(&statistics_mutex_);
+		statistics_.frames_deferred++;
+		return tex_.isAllocated();
+	}
+	TryLockedMutexUnlocker unlocker(&bitmaps_mutex_);
+	return doUpdateBitmapToGlTexture();
+}
+
+bool QAndroidOffscreenView::doUpdateBitmapToGlTexture()
+{
 	bool updated_texture = true;
 	// Get bitmap buffer in Android format (for 32 bits it is ABGR (in Qt) aka RGBA (in Android)).
 	// We don't need conversion to Qt format because GL can hangle Android formats directly.
 	const QImage * qtbuffer = getBitmapBuffer(&updated_texture, false);
+	if (!snapshot_.isNull())
+	{
+		if (!updated_texture || snapshot_pinned_)
+		{
+			// Showing the snapshot left by trimResources() or set by showSnapshot()
+			// until the view is painted again
+			if (!snapshot_uploaded_ || !tex_.isAllocated())
+			{
+				tex_.allocateTexture(snapshot_, true);
+				tex_.setTextureSize(size_); // Stretching it to the view size
+				snapshot_uploaded_ = true;
+			}
+			return tex_.isAllocated();
+		}
+		snapshot_ = QImage();
+		snapshot_uploaded_ = false;
+	}
 	if (qtbuffer && !qtbuffer->isNull())
 	{
 		if (updated_texture || !tex_.isAllocated())
 		{
-			tex_.allocateTexture(*qtbuffer, true);
+			qint64 started_ns = monotonicNs();
+			if (!use_texture_atlas_ || !tex_.allocateTextureInAtlas(*qtbuffer, true, (updated_texture)? taken_dirty_rect_: QRect()))
+			{
+				tex_.allocateTexture(*qtbuffer, true);
+			}
+			QMutexLocker stats_locker(&statistics_mutex_);
+			statistics_.upload.add(monotonicNs() - started_ns);
+			statistics_.bytes_uploaded += qint64(qtbuffer->bytesPerLine()) * qint64(qtbuffer->height());
 		}
 		return true; // Texture is correct
 	}
@@ -628,10 +935,228 @@ void QAndroidOffscreenView::updateAndroidViewVisibility()
 {
 	if (offscreen_view_)
 	{
-		bool vis = is_visible_ && QApplicationActivityObserver::instance()->isApplicationActive();
-		// qDebug()<<__FUNCTION__<<viewObjectName()<<"Visible:"<<is_visible_<<"AppActive:"<<QApplicationActivityObserver::instance()->isApplicationActive()<<"Set:"<<vis;
-		offscreen_view_->callVoid("setVisible", jboolean(vis));
+		// The actual visibility for a buffered command is calculated in flushCommands().
+		if (!bufferCommand(CommandSetVisible))
+		{
+			bool vis = is_visible_ && QApplicationActivityObserver::instance()->isApplicationActive();
+			// qDebug()<<__FUNCTION__<<viewObjectName()<<"Visible:"<<is_visible_<<"AppActive:"<<QApplicationActivityObserver::instance()->isApplicationActive()<<"Set:"<<vis;
+			offscreen_view_->callVoid("setVisible", jboolean(vis));
+		}
+	}
+	if (isShown())
+	{
+		restoreResources();
+	}
+}
+
+bool QAndroidOffscreenView::isShown() const
+{
+	return is_visible_ && !is_painting_paused_ && QApplicationActivityObserver::instance()->isApplicationActive();
+}
+
+void QAndroidOffscreenView::onMemoryTrimRequested(int level)
+{
+	// Idle bitmaps of the pool are not needed by anyone right now
+	if (level >= QApplicationActivityObserver::TrimMemoryRunningLow)
+	{
+		QAndroidJniBitmapPool::instance()->clear();
+	}
+	if (memory_trim_level_ > 0 && level >= memory_trim_level_ && !isShown())
+	{
+		trimResources();
+	}
+}
+
+void QAndroidOffscreenView::trimResources()
+{
+	QMutexLocker locker(&bitmaps_mutex_);
+	if (resources_trimmed_ || !bitmap_a_.isAllocated())
+	{
+		return;
+	}
+	qint64 bytes_before = bytesHeld();
+
+	// Keeping 1/16 of the last image, in the bitmap format, so it can be loaded into GL as is.
+	const QImage * last = getPreviousBitmapBuffer(false);
+	if (last && !last->isNull() && last->width() >= 4 && last->height() >= 4)
+	{
+		snapshot_ = last->scaled(last->width() / 4, last->height() / 4, Qt::IgnoreAspectRatio, Qt::FastTransformation);
+		snapshot_uploaded_ = false;
+	}
+
+	bitmap_a_.dispose();
+	bitmap_b_.dispose();
+	setJavaBitmaps(jobject(0), jobject(0));
+	last_qt_buffer_ = -1;
+	android_to_qt_buffer_ = QImage();
+	// We're not in GL thread; the snapshot will be uploaded when the view is painted next time.
+	tex_.deallocateTextureLater();
+	resources_trimmed_ = true;
+	QAndroidJniBitmapPool::instance()->clear();
+
+	qDebug()<<__PRETTY_FUNCTION__<<viewObjectName()<<"Released"<<(bytes_before - bytesHeld())<<"bytes";
+	QMutexLocker stats_locker(&statistics_mutex_);
+	statistics_.memory_trims++;
+}
+
+QImage QAndroidOffscreenView::grabSnapshot()
+{
+	QMutexLocker locker(&bitmaps_mutex_);
+	if (resources_trimmed_ || !bitmap_a_.isAllocated())
+	{
+		return QImage();
+	}
+	const QImage * last = getPreviousBitmapBuffer(false);
+	if (!last || last->isNull())
+	{
+		return QImage();
+	}
+	QImage frame = last->copy(QRect(QPoint(0, 0), size_).intersected(last->rect()));
+	if (frame.format() == QImage::Format_RGB16)
+	{
+		return frame;
+	}
+	// 32-bit bitmaps are in Android's RGBA byte order, which is ABGR in Qt's notation.
+	return frame.rgbSwapped().convertToFormat(QImage::Format_RGB16);
+}
+
+void QAndroidOffscreenView::showSnapshot(const QImage & image)
+{
+	QMutexLocker locker(&bitmaps_mutex_);
+	if (image.isNull())
+	{
+		return;
+	}
+	snapshot_ = image;
+	snapshot_pinned_ = true;
+	snapshot_uploaded_ = false;
+	locker.unlock();
+	emit updated();
+}
+
+void QAndroidOffscreenView::releaseSnapshot()
+{
+	QMutexLocker locker(&bitmaps_mutex_);
+	if (!snapshot_pinned_)
+	{
+		return;
+	}
+	snapshot_pinned_ = false;
+	locker.unlock();
+	// Making sure there will be a new frame to replace the snapshot.
+	invalidate();
+}
+
+void QAndroidOffscreenView::restoreResources()
+{
+	QMutexLocker locker(&bitmaps_mutex_);
+	if (!resources_trimmed_)
+	{
+		return;
+	}
+	qDebug()<<__PRETTY_FUNCTION__<<viewObjectName();
+	QSize bitmapsize = (s_have_to_adjust_size_to_pot)? potSize(size_, s_max_gl_size): size_;
+	bitmap_a_.resize(bitmapsize);
+	bitmap_b_.resize(bitmapsize);
+	bitmap_a_.fill(fill_color_, true);
+	bitmap_b_.fill(fill_color_, true);
+	last_qt_buffer_ = -1;
+	resources_trimmed_ = false;
+	setJavaBitmaps(bitmap_a_.jbitmap(), bitmap_b_.jbitmap());
+	invalidate();
+}
+
+bool QAndroidOffscreenView::setJavaBitmaps(jobject bitmap_a, jobject bitmap_b)
+{
+	QList<QAndroidJniBitmapPool::Bitmap> retired = bitmap_a_.takeRetiredBitmaps();
+	retired += bitmap_b_.takeRetiredBitmaps();
+	bool old_bitmaps_free = !java_bitmaps_busy_;
+	if (offscreen_view_)
+	{
+		old_bitmaps_free = offscreen_view_->callParamBoolean("setBitmaps",
+			"Landroid/graphics/Bitmap;Landroid/graphics/Bitmap;",
+			bitmap_a, bitmap_b);
+	}
+	if (old_bitmaps_free)
+	{
+		// Nothing is being painted, so the bitmaps retired earlier are not used, too.
+		for (int i = 0; i < retired.size(); ++i)
+		{
+			QAndroidJniBitmapPool::instance()->release(retired.at(i));
+		}
+		releaseRetiredBitmaps(true);
+		return true;
+	}
+	if (!retired.isEmpty())
+	{
+		++bitmaps_generation_;
+		for (int i = 0; i < retired.size(); ++i)
+		{
+			retired_bitmaps_.append(qMakePair(bitmaps_generation_, retired.at(i)));
+		}
+		if (offscreen_view_)
+		{
+			busy_bitmaps_generation_.fetchAndStoreOrdered(bitmaps_generation_);
+		}
+		else
+		{
+			releaseRetiredBitmaps(false);
+		}
+	}
+	return false;
+}
+
+void QAndroidOffscreenView::releaseRetiredBitmaps(bool to_pool)
+{
+	QList<QAndroidJniBitmapPool::Bitmap> retired = bitmap_a_.takeRetiredBitmaps();
+	retired += bitmap_b_.takeRetiredBitmaps();
+	for (int i = 0; i < retired_bitmaps_.size(); ++i)
+	{
+		retired.append(retired_bitmaps_.at(i).second);
+	}
+	retired_bitmaps_.clear();
+	QAndroidJniBitmapPool * pool = QAndroidJniBitmapPool::instance();
+	for (int i = 0; i < retired.size(); ++i)
+	{
+		if (to_pool)
+		{
+			pool->release(retired.at(i));
+		}
+		else
+		{
+			pool->discard(retired.at(i));
+		}
+	}
+}
+
+void QAndroidOffscreenView::releaseFreeBitmaps()
+{
+	QMutexLocker locker(&bitmaps_mutex_);
+	int free_generation = free_bitmaps_generation_.fetchAndAddOrdered(0);
+	for (int i = retired_bitmaps_.size() - 1; i >= 0; --i)
+	{
+		if (retired_bitmaps_.at(i).first <= free_generation)
+		{
+			QAndroidJniBitmapPool::instance()->release(retired_bitmaps_.at(i).second);
+			retired_bitmaps_.removeAt(i);
+		}
+	}
+}
+
+qint64 QAndroidOffscreenView::bytesHeld() const
+{
+	QMutexLocker locker(&bitmaps_mutex_);
+	qint64 result = bitmap_a_.bytes() + bitmap_b_.bytes() + snapshot_.byteCount() + android_to_qt_buffer_.byteCount();
+	for (int i = 0; i < retired_bitmaps_.size(); ++i)
+	{
+		result += retired_bitmaps_.at(i).second.bytes();
 	}
+	if (tex_.isAllocated() && !tex_.isInAtlas())
+	{
+		int bytes_per_pixel = (bitmap_a_.isAllocated() && bitmap_a_.bitness() == 16)? 2: 4;
+		result += qint64(tex_.getTextureSize().width()) * qint64(tex_.getTextureSize().height()) * bytes_per_pixel;
+	}
+	return result;
 }
 
 void QAndroidOffscreenView::setFillColor(const QColor & color)
@@ -651,19 +1176,74 @@ void QAndroidOffscreenView::setFillColor(const QColor & color)
 			QMutexLocker locker(&bitmaps_mutex_);
 			if (bitmap_a_.isAllocated() && bitmap_b_.isAllocated())
 			{
-				bitmap_a_.fill(fill_color_, true);
-				bitmap_b_.fill(fill_color_, true);
-				need_update_texture_ = true;
-				invalidate();
+				if (bitmap_a_.bitness() != desiredBitmapBitness())
+				{
+					updateBitmapFormat();
+				}
+				else
+				{
+					bitmap_a_.fill(fill_color_, true);
+					bitmap_b_.fill(fill_color_, true);
+					android_to_qt_buffer_ = QImage(); // Java dirty rect doesn't cover this change
+					published_frame_.ref();
+					invalidate();
+				}
 			}
 		}
 		if (!hasValidImage())
 		{
 			emit updated();
+			emit updated(QRect());
 		}
 	}
 }
 
+void QAndroidOffscreenView::setBitmapFormatPolicy(BitmapFormatPolicy policy)
+{
+	if (policy != bitmap_format_policy_)
+	{
+		bitmap_format_policy_ = policy;
+		updateBitmapFormat();
+	}
+}
+
+int QAndroidOffscreenView::desiredBitmapBitness() const
+{
+	switch(bitmap_format_policy_)
+	{
+		case BitmapFormat16Bit:
+			return 16;
+		case BitmapFormat16BitIfOpaque:
+			return (fill_color_.alpha() == 255)? 16: 32;
+		case BitmapFormat32Bit:
+		default:
+			return 32;
+	}
+}
+
+void QAndroidOffscreenView::updateBitmapFormat()
+{
+	QMutexLocker locker(&bitmaps_mutex_);
+	int bitness = desiredBitmapBitness();
+	if (!bitmap_a_.isAllocated() || bitmap_a_.bitness() == bitness)
+	{
+		return;
+	}
+	qDebug()<<__PRETTY_FUNCTION__<<viewObjectName()<<"Switching bitmaps to"<<bitness<<"bits";
+	QSize bitmapsize = bitmap_a_.size();
+	bitmap_a_.setBitness(bitness);
+	bitmap_b_.setBitness(bitness);
+	bitmap_a_.resize(bitmapsize);
+	bitmap_b_.resize(bitmapsize);
+	bitmap_a_.fill(fill_color_, true);
+	bitmap_b_.fill(fill_color_, true);
+	last_qt_buffer_ = -1;
+	android_to_qt_buffer_ = QImage();
+	view_painted_ = false;
+	setJavaBitmaps(bitmap_a_.jbitmap(), bitmap_b_.jbitmap());
+	invalidate();
+}
+
 void QAndroidOffscreenView::setVisible(bool visible)
 {
 	is_visible_ = visible;
@@ -674,12 +1254,53 @@ void QAndroidOffscreenView::setEnabled(bool enabled)
 {
 	// NB: we always call Java setEnabled!
 	is_enabled_ = enabled;
-	if (offscreen_view_)
+	if (offscreen_view_ && !bufferCommand(CommandSetEnabled, int(is_enabled_)))
 	{
 		offscreen_view_->callVoid("setEnabled", jboolean(is_enabled_));
 	}
 }
 
+void QAndroidOffscreenView::setMaxUpdateRate(int fps)
+{
+	fps = qMax(0, fps);
+	if (fps != max_update_rate_)
+	{
+		max_update_rate_ = fps;
+		if (offscreen_view_)
+		{
+			offscreen_view_->callParamVoid("setMaxFrameRate", "I", jint(max_update_rate_));
+		}
+	}
+}
+
+void QAndroidOffscreenView::setVsyncPacing(bool enabled)
+{
+	if (enabled != vsync_pacing_)
+	{
+		vsync_pacing_ = enabled;
+		if (offscreen_view_)
+		{
+			offscreen_view_->callVoid("setVsyncPacing", jboolean(vsync_pacing_));
+		}
+	}
+}
+
+void QAndroidOffscreenView::setPaintingPaused(bool paused)
+{
+	if (paused != is_painting_paused_)
+	{
+		is_painting_paused_ = paused;
+		if (isShown())
+		{
+			restoreResources();
+		}
+		if (offscreen_view_)
+		{
+			offscreen_view_->callVoid("setPaintingPaused", jboolean(is_painting_paused_));
+		}
+	}
+}
+
 void QAndroidOffscreenView::setAttachingMode(bool attaching)
 {
 	if (!nonAttachingModeSupported())
@@ -689,6 +1310,7 @@ void QAndroidOffscreenView::setAttachingMode(bool attaching)
 	}
 	if (offscreen_view_)
 	{
+		flushCommands();
 		offscreen_view_->callVoid("setAttachingMode", jboolean(attaching));
 	}
 }
@@ -697,6 +1319,7 @@ void QAndroidOffscreenView::reattachView()
 {
 	if (offscreen_view_)
 	{
+		flushCommands();
 		offscreen_view_->callVoid("reattachView");
 		setVisible(visible());
 		setEnabled(enabled());
@@ -715,7 +1338,7 @@ void QAndroidOffscreenView::reattachView()
 
 void QAndroidOffscreenView::setFocused(bool focused)
 {
-	if (offscreen_view_)
+	if (offscreen_view_ && !bufferCommand(CommandSetFocused, int(focused)))
 	{
 		return offscreen_view_->callVoid("setFocused", jboolean(focused));
 	}
@@ -723,7 +1346,7 @@ void QAndroidOffscreenView::setFocused(bool focused)
 
 void QAndroidOffscreenView::setPosition(int left, int top)
 {
-	if (offscreen_view_)
+	if (offscreen_view_ && !bufferCommand(CommandSetPosition, left, top))
 	{
 		return offscreen_view_->callParamVoid("setPosition", "II", jint(left), jint(top));
 	}
@@ -733,6 +1356,8 @@ void QAndroidOffscreenView::hideKeyboard()
 {
 	if (offscreen_view_)
 	{
+		// Keyboard depends on focus, which may be buffered.
+		flushCommands();
 		offscreen_view_->callVoid("hideKeyboard");
 	}
 }
@@ -741,6 +1366,8 @@ void QAndroidOffscreenView::showKeyboard()
 {
 	if (offscreen_view_)
 	{
+		// Keyboard depends on focus, which may be buffered.
+		flushCommands();
 		offscreen_view_->callVoid("showKeyboard");
 	}
 }
@@ -760,12 +1387,51 @@ void QAndroidOffscreenView::setShowKeyboardOnFocusIn(bool show)
 		offscreen_view_->callVoid("setShowKeyboardOnFocusIn", jboolean(show));
 	}
 }
-void QAndroidOffscreenView::javaUpdate()
+void QAndroidOffscreenView::javaUpdate(qint64 paint_started_ns, const QRect & dirty_rect)
 {
 	// qDebug()<<__PRETTY_FUNCTION__<<view_object_name_;
-	need_update_texture_ = true;
+	// Java has finished the paint which was using the bitmaps left busy by setJavaBitmaps().
+	int busy_generation = busy_bitmaps_generation_.fetchAndStoreOrdered(0);
+	if (busy_generation > 0)
+	{
+		free_bitmaps_generation_.fetchAndStoreOrdered(busy_generation);
+		QMetaObject::invokeMethod(this, "releaseFreeBitmaps", Qt::QueuedConnection);
+	}
+	{
+		qint64 now = monotonicNs();
+		QMutexLocker stats_locker(&statistics_mutex_);
+		statistics_.frames_painted++;
+		if (hasNewFrame() && view_painted_)
+		{
+			statistics_.frames_skipped++;
+		}
+		if (paint_started_ns > 0)
+		{
+			statistics_.java_paint.add(now - paint_started_ns);
+		}
+		if (touch_latency_started_ns_ > 0)
+		{
+			statistics_.touch_latency.add(now - touch_latency_started_ns_);
+			touch_latency_started_ns_ = 0;
+		}
+		last_update_time_ns_ = now;
+	}
 	view_painted_ = true;
+	// Publishing the frame after everything else is set up
+	published_frame_.ref();
 	emit updated();
+	emit updated(dirty_rect);
+}
+
+void QAndroidOffscreenView::frameTaken()
+{
+	QMutexLocker stats_locker(&statistics_mutex_);
+	statistics_.frames_taken++;
+	if (last_update_time_ns_ > 0)
+	{
+		statistics_.update_latency.add(monotonicNs() - last_update_time_ns_);
+		last_update_time_ns_ = 0;
+	}
 }
 
 void QAndroidOffscreenView::javaViewCreated()
@@ -785,24 +1451,44 @@ bool QAndroidOffscreenView::updateGlTexture()
 {
 	if (offscreen_view_)
 	{
-		// Get last View image into the texture.
-		if (!offscreen_view_->callBool("updateTexture"))
+		qint64 started_ns = monotonicNs();
+		int frame = atomicLoad(published_frame_);
+		float a11, a12, a21, a22, b1, b2;
+
+		if (frame_state_buffer_)
 		{
-			return false;
+			// Get last View image into the texture, its transformation matrix and size in one call.
+			if (!offscreen_view_->callParamBoolean("updateFrameState", "Z", jboolean(false)))
+			{
+				return false;
+			}
+			const float * m = frame_state_.matrix;
+			a11 = m[0]; a21 = m[1]; a12 = m[4]; a22 = m[5]; b1 = m[12]; b2 = m[13];
+			last_texture_width_ = frame_state_.width;
+			last_texture_height_ = frame_state_.height;
 		}
+		else
+		{
+			// Get last View image into the texture.
+			if (!offscreen_view_->callBool("updateTexture"))
+			{
+				return false;
+			}
 
-		// Transform matrix
-		float a11 = offscreen_view_->callFloat("getTextureTransformMatrix", 0);
-		float a21 = offscreen_view_->callFloat("getTextureTransformMatrix", 1);
-		float a12 = offscreen_view_->callFloat("getTextureTransformMatrix", 4);
-		float a22 = offscreen_view_->callFloat("getTextureTransformMatrix", 5);
-		float b1 = offscreen_view_->callFloat("getTextureTransformMatrix", 12);
-		float b2 = offscreen_view_->callFloat("getTextureTransformMatrix", 13);
-		tex_.setTransformation(a11, a12, a21, a22, b1, b2);
+			// Transform matrix
+			a11 = offscreen_view_->callFloat("getTextureTransformMatrix", 0);
+			a21 = offscreen_view_->callFloat("getTextureTransformMatrix", 1);
+			a12 = offscreen_view_->callFloat("getTextureTransformMatrix", 4);
+			a22 = offscreen_view_->callFloat("getTextureTransformMatrix", 5);
+			b1 = offscreen_view_->callFloat("getTextureTransformMatrix", 12);
+			b2 = offscreen_view_->callFloat("getTextureTransformMatrix", 13);
 
-		// Last texture size
-		last_texture_width_ = offscreen_view_->callInt("getLastTextureWidth");
-		last_texture_height_ = offscreen_view_->callInt("getLastTextureHeight");
+			// Last texture size
+			last_texture_width_ = offscreen_view_->callInt("getLastTextureWidth");
+			last_texture_height_ = offscreen_view_->callInt("getLastTextureHeight");
+		}
+		frameTaken();
+		tex_.setTransformation(a11, a12, a21, a22, b1, b2);
 
 		/*
 		qDebug()<<__PRETTY_FUNCTION__<<"Transform Matrix:\n"<<
@@ -810,8 +1496,11 @@ bool QAndroidOffscreenView::updateGlTexture()
 				  __PRETTY_FUNCTION__<<"("<<a21<<a22<<") +"<<b2;
 		*/
 
-		need_update_texture_ = false;
+		taken_frame_.fetchAndStoreOrdered(frame);
 		texture_received_ = true;
+
+		QMutexLocker stats_locker(&statistics_mutex_);
+		statistics_.update_gl_texture.add(monotonicNs() - started_ns);
 		return true;
 	}
 	else
@@ -834,13 +1523,177 @@ void QAndroidOffscreenView::mouse(int android_action, int x, int y, long long ti
 {
 	if (offscreen_view_)
 	{
+		if (touch_batching_)
+		{
+			qint64 now_ns = monotonicNs();
+			if (timestamp_uptime_millis == 0)
+			{
+				// Android's SystemClock.uptimeMillis() uses CLOCK_MONOTONIC, too. Setting time for
+				// all events here, so the time of down / up matches the time of the collected moves.
+				timestamp_uptime_millis = now_ns / Q_INT64_C(1000000);
+			}
+			if (android_action == ANDROID_MOTIONEVENT_ACTION_MOVE)
+			{
+				if (touch_samples_.isEmpty())
+				{
+					touch_batch_started_ns_ = now_ns;
+					if (touch_flushed_by_frames_)
+					{
+						touch_flush_timer_.start(c_touch_flush_fallback_ms);
+					}
+					else
+					{
+						touch_flush_timer_.start((max_update_rate_ > 0)? qMax(16, 1000 / max_update_rate_): 16);
+					}
+				}
+				touch_samples_.append(jlong(timestamp_uptime_millis));
+				touch_samples_.append(jlong(x));
+				touch_samples_.append(jlong(y));
+				return;
+			}
+			// The view should receive all moves before the next down / up
+			flushTouchEvents();
+		}
 		offscreen_view_->callParamVoid("ProcessMouseEvent", "IIIJ", jint(android_action), jint(x), jint(y), jlong(timestamp_uptime_millis));
 	}
 }
 
-void QAndroidOffscreenView::requestVisibleRect()
+void QAndroidOffscreenView::setTouchBatching(bool enabled)
 {
+	if (enabled != touch_batching_)
+	{
+		if (!enabled)
+		{
+			flushTouchEvents();
+		}
+		touch_batching_ = enabled;
+	}
+}
+
+void QAndroidOffscreenView::flushTouchEvents()
+{
+	touch_flush_timer_.stop();
+	if (touch_samples_.isEmpty())
+	{
+		return;
+	}
+	if (offscreen_view_)
+	{
+		QJniEnvPtr jep;
+		JNIEnv * env = jep.env();
+		jsize size = static_cast<jsize>(touch_samples_.size());
+		jlongArray samples = env->NewLongArray(size);
+		if (samples && !jep.clearException())
+		{
+			env->SetLongArrayRegion(samples, 0, size, touch_samples_.constData());
+			offscreen_view_->callParamVoid("ProcessMouseEventBatch", "[J", samples);
+			env->DeleteLocalRef(samples);
+			QMutexLocker stats_locker(&statistics_mutex_);
+			statistics_.touch_batches++;
+			statistics_.touch_samples += size / 3;
+			if (touch_latency_started_ns_ == 0)
+			{
+				touch_latency_started_ns_ = touch_batch_started_ns_;
+			}
+		}
+		else
+		{
+			qWarning()<<__FUNCTION__<<"Failed to allocate array for"<<size<<"touch samples";
+		}
+	}
+	touch_samples_.clear();
+}
+
+void QAndroidOffscreenView::setCommandBuffering(bool enabled)
+{
+	if (enabled != command_buffering_)
+	{
+		if (!enabled)
+		{
+			flushCommands();
+		}
+		command_buffering_ = enabled;
+	}
+}
+
+bool QAndroidOffscreenView::bufferCommand(CommandKind kind, int a, int b)
+{
+	if (!command_buffering_ || QThread::currentThread() != thread())
+	{
+		return false;
+	}
+	for (int i = 0; i < commands_.size(); ++i)
+	{
+		if (commands_[i].kind == kind)
+		{
+			// Re-append the command so it is executed in order with the commands recorded after the old one.
+			commands_.remove(i);
+			QMutexLocker stats_locker(&statistics_mutex_);
+			statistics_.commands_superseded++;
+			break;
+		}
+	}
+	if (commands_.isEmpty())
+	{
+		commands_started_ns_ = monotonicNs();
+		command_flush_timer_.start(0);
+	}
+	Command command = { kind, a, b };
+	commands_.append(command);
+	return true;
+}
+
+void QAndroidOffscreenView::flushCommands()
+{
+	command_flush_timer_.stop();
+	if (commands_.isEmpty())
+	{
+		return;
+	}
 	if (offscreen_view_)
+	{
+		QVector<jint> packed;
+		packed.reserve(commands_.size() * 3);
+		for (int i = 0; i < commands_.size(); ++i)
+		{
+			const Command & command = commands_.at(i);
+			packed.append(jint(command.kind));
+			if (command.kind == CommandSetVisible)
+			{
+				// Application activity may have changed since the command has been recorded.
+				packed.append(jint(is_visible_ && QApplicationActivityObserver::instance()->isApplicationActive()));
+			}
+			else
+			{
+				packed.append(jint(command.a));
+			}
+			packed.append(jint(command.b));
+		}
+		QJniEnvPtr jep;
+		JNIEnv * env = jep.env();
+		jsize size = static_cast<jsize>(packed.size());
+		jintArray jcommands = env->NewIntArray(size);
+		if (jcommands && !jep.clearException())
+		{
+			env->SetIntArrayRegion(jcommands, 0, size, packed.constData());
+			offscreen_view_->callParamVoid("executeCommands", "[I", jcommands);
+			env->DeleteLocalRef(jcommands);
+			QMutexLocker stats_locker(&statistics_mutex_);
+			statistics_.command_flushes++;
+			statistics_.commands_flushed += commands_.size();
+			statistics_.command_flush_latency.add(monotonicNs() - commands_started_ns_);
+		}
+		else
+		{
+			qWarning()<<__FUNCTION__<<"Failed to allocate array for"<<commands_.size()<<"commands";
+		}
+	}
+	commands_.clear();
+}
+
+void QAndroidOffscreenView::requestVisibleRect()
+{
+	if (offscreen_view_ && !bufferCommand(CommandQueryVisibleRect))
 	{
 		offscreen_view_->callVoid("queryVisibleRect");
 	}
@@ -866,7 +1719,7 @@ int QAndroidOffscreenView::getScrollY()
 
 void QAndroidOffscreenView::setScrollX(int x)
 {
-	if (offscreen_view_)
+	if (offscreen_view_ && !bufferCommand(CommandSetScrollX, x))
 	{
 		offscreen_view_->callVoid("setScrollX", static_cast<jint>(x));
 	}
@@ -874,7 +1727,7 @@ void QAndroidOffscreenView::setScrollX(int x)
 
 void QAndroidOffscreenView::setScrollY(int y)
 {
-	if (offscreen_view_)
+	if (offscreen_view_ && !bufferCommand(CommandSetScrollY, y))
 	{
 		offscreen_view_->callVoid("setScrollY", static_cast<jint>(y));
 	}
@@ -909,6 +1762,7 @@ void QAndroidOffscreenView::resize(const QSize & newsize)
 	if (size_ != size)
 	{
 		qDebug()<<__PRETTY_FUNCTION__<<"Old size:"<<size_<<"New size:"<<size;
+		flushCommands();
 		size_ = size;
 		{
 			QMutexLocker locker(&bitmaps_mutex_);
@@ -920,13 +1774,8 @@ void QAndroidOffscreenView::resize(const QSize & newsize)
 				bitmap_a_.fill(fill_color_, true);
 				bitmap_b_.fill(fill_color_, true);
 				last_qt_buffer_ = -1;
-				if (offscreen_view_)
-				{
-					offscreen_view_->callParamVoid("setBitmaps",
-						"Landroid/graphics/Bitmap;Landroid/graphics/Bitmap;",
-						bitmap_a_.jbitmap(), bitmap_b_.jbitmap());
-					//QMetaObject::invokeMethod(this, "invalidate", Qt::QueuedConnection);
-				}
+				setJavaBitmaps(bitmap_a_.jbitmap(), bitmap_b_.jbitmap());
+				//QMetaObject::invokeMethod(this, "invalidate", Qt::QueuedConnection);
 			}
 		}
 		if (offscreen_view_)
@@ -973,6 +1822,125 @@ void QAndroidOffscreenView::testFunction()
 }
 
 
+void QAndroidOffscreenView::TimingCounter::add(qint64 ns)
+{
+	count++;
+	total_ns += ns;
+	last_ns = ns;
+	if (ns > max_ns)
+	{
+		max_ns = ns;
+	}
+}
+
+QString QAndroidOffscreenView::TimingCounter::toJson() const
+{
+	return QString("{\"count\": %1, \"avg_ms\": %2, \"last_ms\": %3, \"max_ms\": %4}")
+		.arg(count)
+		.arg(averageMs(), 0, 'f', 3)
+		.arg(double(last_ns) / 1000000.0, 0, 'f', 3)
+		.arg(double(max_ns) / 1000000.0, 0, 'f', 3);
+}
+
+QVariantMap QAndroidOffscreenView::TimingCounter::toVariantMap() const
+{
+	QVariantMap result;
+	result["count"] = count;
+	result["avgMs"] = averageMs();
+	result["lastMs"] = double(last_ns) / 1000000.0;
+	result["maxMs"] = double(max_ns) / 1000000.0;
+	return result;
+}
+
+QString QAndroidOffscreenView::FrameStatistics::toJson() const
+{
+	return QString("{\"frames_painted\": %1, \"frames_taken\": %2, \"frames_skipped\": %3, \"frames_deferred\": %4, "
+		"\"bytes_uploaded\": %5, \"bytes_held\": %6, \"memory_trims\": %7, \"java_paint\": %8, \"update_latency\": %9, "
+		"\"get_bitmap_buffer\": %10, \"conversion\": %11, \"update_gl_texture\": %12, \"upload\": %13, "
+		"\"texture_update_wait\": %14, \"touch_batches\": %15, \"touch_samples\": %16, \"touch_latency\": %17, "
+		"\"command_flushes\": %18, \"commands_flushed\": %19, \"commands_superseded\": %20, \"command_flush_latency\": %21}")
+		.arg(frames_painted)
+		.arg(frames_taken)
+		.arg(frames_skipped)
+		.arg(frames_deferred)
+		.arg(bytes_uploaded)
+		.arg(bytes_held)
+		.arg(memory_trims)
+		.arg(java_paint.toJson())
+		.arg(update_latency.toJson())
+		.arg(get_bitmap_buffer.toJson())
+		.arg(conversion.toJson())
+		.arg(update_gl_texture.toJson())
+		.arg(upload.toJson())
+		.arg(texture_update_wait.toJson())
+		.arg(touch_batches)
+		.arg(touch_samples)
+		.arg(touch_latency.toJson())
+		.arg(command_flushes)
+		.arg(commands_flushed)
+		.arg(commands_superseded)
+		.arg(command_flush_latency.toJson());
+}
+
+QVariantMap QAndroidOffscreenView::FrameStatistics::toVariantMap() const
+{
+	QVariantMap result;
+	result["framesPainted"] = frames_painted;
+	result["framesTaken"] = frames_taken;
+	result["framesSkipped"] = frames_skipped;
+	result["framesDeferred"] = frames_deferred;
+	result["bytesUploaded"] = bytes_uploaded;
+	result["bytesHeld"] = bytes_held;
+	result["memoryTrims"] = memory_trims;
+	result["javaPaint"] = java_paint.toVariantMap();
+	result["updateLatency"] = update_latency.toVariantMap();
+	result["getBitmapBuffer"] = get_bitmap_buffer.toVariantMap();
+	result["conversion"] = conversion.toVariantMap();
+	result["updateGlTexture"] = update_gl_texture.toVariantMap();
+	result["upload"] = upload.toVariantMap();
+	result["textureUpdateWait"] = texture_update_wait.toVariantMap();
+	result["touchBatches"] = touch_batches;
+	result["touchSamples"] = touch_samples;
+	result["touchLatency"] = touch_latency.toVariantMap();
+	result["commandFlushes"] = command_flushes;
+	result["commandsFlushed"] = commands_flushed;
+	result["commandsSuperseded"] = commands_superseded;
+	result["commandFlushLatency"] = command_flush_latency.toVariantMap();
+	return result;
+}
+
+QAndroidOffscreenView::FrameStatistics QAndroidOffscreenView::frameStatistics() const
+{
+	qint64 bytes_held = bytesHeld();
+	QMutexLocker locker(&statistics_mutex_);
+	FrameStatistics result = statistics_;
+	result.bytes_held = bytes_held;
+	return result;
+}
+
+void QAndroidOffscreenView::resetFrameStatistics()
+{
+	QMutexLocker locker(&statistics_mutex_);
+	statistics_ = FrameStatistics();
+}
+
+void QAndroidOffscreenView::setStatisticsLogInterval(int msec)
+{
+	if (msec > 0)
+	{
+		statistics_log_timer_.start(msec);
+	}
+	else
+	{
+		statistics_log_timer_.stop();
+	}
+}
+
+void QAndroidOffscreenView::logFrameStatistics()
+{
+	qDebug()<<"OffscreenView statistics:"<<viewObjectName()<<frameStatistics().toJson();
+}
+
 int QColorToAndroidColor(const QColor & color)
 {
 	// QColor to BGRA aka ARGB in Android terms
@@ -39,7 +39,13 @@
 #include <QtCore/QSize>
 #include <QtCore/QRect>
 #include <QtCore/QScopedPointer>
+#include <QtCore/QList>
 #include <QtCore/QMutex>
+#include <QtCore/QPair>
+#include <QtCore/QAtomicInt>
+#include <QtCore/QTimer>
+#include <QtCore/QVariantMap>
+#include <QtCore/QVector>
 #include <QJniHelpers.h>
 #include "QAndroidJniImagePair.h"
 #include "QOpenGLTextureHolder.h"
@@ -57,6 +63,99 @@ class QAndroidOffscreenView: public QObject
 	Q_PROPERTY(QColor fillColor READ fillColor WRITE setFillColor)
 	Q_PROPERTY(bool visible READ visible WRITE setVisible)
 	Q_PROPERTY(bool enabled READ enabled WRITE setEnabled)
+	Q_PROPERTY(BitmapFormatPolicy bitmapFormatPolicy READ bitmapFormatPolicy WRITE setBitmapFormatPolicy)
+	Q_PROPERTY(int maxUpdateRate READ maxUpdateRate WRITE setMaxUpdateRate)
+	Q_PROPERTY(bool vsyncPacing READ vsyncPacing WRITE setVsyncPacing)
+	Q_PROPERTY(bool useTextureAtlas READ useTextureAtlas WRITE setUseTextureAtlas)
+	Q_PROPERTY(int memoryTrimLevel READ memoryTrimLevel WRITE setMemoryTrimLevel)
+	Q_PROPERTY(bool touchBatching READ touchBatching WRITE setTouchBatching)
+	Q_PROPERTY(bool commandBuffering READ commandBuffering WRITE setCommandBuffering)
+	Q_ENUMS(BitmapFormatPolicy)
+public:
+	/*!
+	 * Pixel format of the bitmaps used in Bitmap mode.
+	 * 16-bit (RGB565) bitmaps take half of the memory and GL upload bandwidth and
+	 * need no color plane conversion, but they have no alpha channel and may show
+	 * banding on gradients (Android dithering is enabled for them).
+	 */
+	enum BitmapFormatPolicy
+	{
+		BitmapFormat32Bit = 0,
+		BitmapFormat16Bit = 1,
+		//! Use 16 bits while fillColor is opaque, otherwise 32 bits.
+		BitmapFormat16BitIfOpaque = 2
+	};
+
+	//! Timing of some repeated operation, in nanoseconds.
+	struct TimingCounter
+	{
+		TimingCounter(): count(0), total_ns(0), last_ns(0), max_ns(0) {}
+		void add(qint64 ns);
+		double averageMs() const { return (count)? double(total_ns) / double(count) / 1000000.0: 0.0; }
+		QString toJson() const;
+		QVariantMap toVariantMap() const;
+		qint64 count;
+		qint64 total_ns;
+		qint64 last_ns;
+		qint64 max_ns;
+	};
+
+	/*!
+	 * Per-view counters which help to find out where the time goes when
+	 * displaying a frame of the view.
+	 */
+	struct FrameStatistics
+	{
+		FrameStatistics(): frames_painted(0), frames_taken(0), frames_skipped(0), frames_deferred(0), bytes_uploaded(0)
+			, bytes_held(0), memory_trims(0), touch_batches(0), touch_samples(0)
+			, command_flushes(0), commands_flushed(0), commands_superseded(0) {}
+		QString toJson() const;
+		QVariantMap toVariantMap() const;
+
+		//! Number of frames painted by Java side.
+		qint64 frames_painted;
+		//! Number of new frames taken by Qt side.
+		qint64 frames_taken;
+		//! Frames painted by Java but replaced by the next one before Qt took them.
+		qint64 frames_skipped;
+		//! Texture updates postponed because bitmaps were locked by another thread.
+		qint64 frames_deferred;
+		//! Total size of the pixel data loaded into GL in Bitmap mode.
+		qint64 bytes_uploaded;
+		//! Memory currently held by the view for its image: bitmaps, textures, snapshot (estimate).
+		qint64 bytes_held;
+		//! Number of times the view released its buffers on Android memory trim request.
+		qint64 memory_trims;
+		//! Number of batches of move events sent to Java (one JNI call each).
+		qint64 touch_batches;
+		//! Number of move events sent in the batches.
+		qint64 touch_samples;
+		//! Java starts painting => javaUpdate() called.
+		TimingCounter java_paint;
+		//! javaUpdate() => the frame is taken by Qt.
+		TimingCounter update_latency;
+		//! Getting a new image in Bitmap mode (JNI calls + conversion).
+		TimingCounter get_bitmap_buffer;
+		//! Color plane conversion in Bitmap mode.
+		TimingCounter conversion;
+		//! Getting a new image in GL mode (SurfaceTexture update via JNI).
+		TimingCounter update_gl_texture;
+		//! Loading the bitmap into GL texture in Bitmap mode.
+		TimingCounter upload;
+		//! Time spent by the painting thread in updateGLTextureInHolder() (JNI + locks + upload).
+		TimingCounter texture_update_wait;
+		//! First move event of a batch received by Qt => next frame painted by Java.
+		TimingCounter touch_latency;
+		//! Number of command lists sent to Java (one JNI call and one UI thread Runnable each).
+		qint64 command_flushes;
+		//! Number of commands sent in the lists.
+		qint64 commands_flushed;
+		//! Buffered commands dropped because a later command of the same kind has been recorded.
+		qint64 commands_superseded;
+		//! First command of a list recorded => the list is sent to Java.
+		TimingCounter command_flush_latency;
+	};
+
 protected:
 	/*!
 	 * \param classname - name of Java class of the View wrapper.
@@ -78,6 +177,12 @@ public:
 	static const QString & getDefaultJavaClassPath();
 	static void preloadJavaClasses();
 
+	/*!
+	 * Preload Java class of a View wrapper, once per process. Thread-safe.
+	 * \param class_name - either a full class name or a name in getDefaultJavaClassPath().
+	 */
+	static void preloadViewJavaClass(const QString & class_name);
+
 	//
 	// Functions to check for available configuration
 	//
@@ -111,7 +216,7 @@ public:
 	/*!
 	 * Returns true if initializeGL() has been called.
 	 */
-	virtual bool isIntialized() const { return tex_.isAllocated() || bitmap_a_.isAllocated(); }
+	virtual bool isIntialized() const { return tex_.isAllocated() || bitmap_a_.isAllocated() || resources_trimmed_; }
 
 	/*!
 	 * Delete associated Android View and its rendering infrastructure. The texture continues
@@ -119,6 +224,14 @@ public:
 	 */
 	virtual void deleteAndroidView();
 
+	/*!
+	 * Called by QAndroidOffscreenViewPool when the view is given back to the pool:
+	 * clear the state left by the previous user (contents, history, caches and so on).
+	 * Subclasses which keep such state should override it and call the base implementation.
+	 * \return false if the view cannot be reset; it is deleted instead of being pooled then.
+	 */
+	virtual bool resetForReuse();
+
 	/*!
 	 * Draw GL texture or Bitmap (depending on the rendering surface on the Java side) using OpenGL.
 	 * targetRect is the output rectangle in OpenGL terms. If View image is not ready, the rectangle
@@ -128,6 +241,15 @@ public:
 	 */
 	virtual void paintGL(int l, int b, int w, int h, bool reverse_y);
 
+	/*!
+	 * Batched alternative to paintGL() for drawing several views at once.
+	 * Updates the texture and, if it has a valid image, adds it to the batch
+	 * which should be drawn later via QOpenGLTextureHolder::blitTextures().
+	 * \return false if the view is not ready; the caller should fill its area
+	 *  with fillColor() by itself in such case.
+	 */
+	bool appendToBlitBatch(QList<QOpenGLTextureHolder::BlitItem> & batch, int l, int b, int w, int h, bool reverse_y);
+
 	/*!
 	 * Makes sure that the GL texture holder contains actual image, if possible.
 	 * This function should only be called if \ref getGLTextureHolder() is used to access
@@ -136,6 +258,12 @@ public:
 	 */
 	bool updateGLTextureInHolder();
 
+	/*!
+	 * Java System.nanoTime() of the start of painting of the frame last taken
+	 * from Java side, or 0 if unknown.
+	 */
+	qint64 lastFrameTimestamp() const { return frame_state_.timestamp_ns; }
+
 	/*!
 	 * Access \ref QOpenGLTextureHolder for reading texture id or other properties
 	 * for direct painting without using \ref paintGL().
@@ -168,6 +296,18 @@ public:
 	QColor fillColor() const { return fill_color_; }
 	virtual void setFillColor(const QColor & color);
 
+	BitmapFormatPolicy bitmapFormatPolicy() const { return bitmap_format_policy_; }
+
+	/*!
+	 * Set pixel format policy for Bitmap mode. By default, 32-bit bitmaps are used.
+	 * If the bitmaps are already allocated and the format changes they are
+	 * re-created and the view is repainted.
+	 */
+	void setBitmapFormatPolicy(BitmapFormatPolicy policy);
+
+	//! Bitness of the bitmaps which should be used according to the current policy and fill color.
+	int desiredBitmapBitness() const;
+
 	/*!
 	 * Does the view thinks it's visible? When view is invisible, the texture may
 	 * contain an empty or outdated image. Also it stops all animations and etc.
@@ -195,6 +335,63 @@ public:
 
 	void setEnabled(bool enabled);
 
+	int maxUpdateRate() const { return max_update_rate_; }
+
+	/*!
+	 * Limit how many times per second the View is painted into the offscreen buffer
+	 * (and so how often updated() is emitted). Invalidations of the View which come
+	 * more often are coalesced on Java side into one deferred paint. 0 (default) means no limit.
+	 */
+	void setMaxUpdateRate(int fps);
+
+	bool vsyncPacing() const { return vsync_pacing_; }
+
+	/*!
+	 * Paint the View at most once per display frame, in the beginning of the frame
+	 * (Android Choreographer callback), so the new image is ready by the time Qt
+	 * window synchronizes its scene. Works on API 16+. Disabled by default.
+	 */
+	void setVsyncPacing(bool enabled);
+
+	bool useTextureAtlas() const { return use_texture_atlas_; }
+
+	/*!
+	 * Put the image of the view into a texture atlas shared with other views
+	 * (\see QOpenGLTextureAtlas) instead of its own GL texture. This is good for
+	 * a lot of small views like text fields in a form: they share one texture
+	 * (one bind for all of them) and don't need a texture and a SurfaceTexture each.
+	 * The view works in Bitmap mode then; views which don't fit the atlas use
+	 * their own textures.
+	 * \note Should be set before initializeGL().
+	 */
+	void setUseTextureAtlas(bool use) { use_texture_atlas_ = use; }
+
+	int memoryTrimLevel() const { return memory_trim_level_; }
+
+	/*!
+	 * When Android asks to trim memory with this or a higher level (\see
+	 * QApplicationActivityObserver::TrimMemoryLevel) and the view is not shown
+	 * (hidden, paused or the application is in background), it releases its bitmaps
+	 * and texture keeping only a low-resolution snapshot to show until the view
+	 * is shown and painted again. 0 disables trimming. Default is TrimMemoryUiHidden.
+	 * \note Only Bitmap mode views can release their buffers, as SurfaceTexture
+	 *  of GL mode can't be re-created without re-creating the View.
+	 */
+	void setMemoryTrimLevel(int level) { memory_trim_level_ = level; }
+
+	//! Memory held by the view for its image (\see FrameStatistics::bytes_held).
+	qint64 bytesHeld() const;
+
+	bool paintingPaused() const { return is_painting_paused_; }
+
+	/*!
+	 * Temporarily stop painting the View into the offscreen buffer, e.g. when
+	 * it is clipped out or covered in the Qt window. Unlike setVisible(false),
+	 * the View is not hidden or detached, so the switching is cheap and the View
+	 * is repainted to its latest state when painting is resumed.
+	 */
+	void setPaintingPaused(bool paused);
+
 	/*!
 	 * Control attaching View to the main activity View.
 	 * It is typically called one time after constructing QAndroidOffscreenView.
@@ -274,6 +471,42 @@ public:
 	 */
 	void mouse(int android_action, int x, int y, long long timestamp_uptime_millis = 0);
 
+	bool touchBatching() const { return touch_batching_; }
+
+	/*!
+	 * If enabled (default), move events passed to mouse() are not sent to Java one by one,
+	 * but collected during a frame interval and sent by one JNI call, as one Android MotionEvent
+	 * with history. Down / up events are sent immediately, after the pending moves. Events with
+	 * zero timestamp get the time when mouse() has been called.
+	 * The moves are sent by flushTouchEvents(), which is called by a timer unless
+	 * setTouchFlushedByFrames() is enabled.
+	 */
+	void setTouchBatching(bool enabled);
+
+	bool touchFlushedByFrames() const { return touch_flushed_by_frames_; }
+
+	/*!
+	 * Tell that the owner calls flushTouchEvents() before each Qt frame (as QQuickAndroidOffscreenView
+	 * does), so the collected moves reach Java in step with the frames and without a timer delay.
+	 * The timer is still started then, with a longer interval, to send the moves if no frame comes.
+	 */
+	void setTouchFlushedByFrames(bool enabled) { touch_flushed_by_frames_ = enabled; }
+
+	bool commandBuffering() const { return command_buffering_; }
+
+	/*!
+	 * If enabled (default), setPosition(), setVisible(), setEnabled(), setScrollX(),
+	 * setScrollY(), setFocused() and requestVisibleRect() are not sent to Java immediately
+	 * but recorded and sent once per Qt frame (when the control returns to the event loop)
+	 * as one command list, which is executed by one UI thread Runnable. A command
+	 * supersedes the earlier buffered command of the same kind, e.g. only the last
+	 * position set during a frame reaches Android.
+	 * The other calls are not buffered and so may reach Java before the buffered
+	 * commands recorded earlier; call flushCommands() first if the order matters.
+	 * Calls made from a thread other than the thread of the object are never buffered.
+	 */
+	void setCommandBuffering(bool enabled);
+
 	//! Return the scrolled left position of this view.
 	int getScrollX();
 
@@ -298,6 +531,17 @@ public:
 	//! Test function for lib developers, don't use it
 	void testFunction();
 
+	//! Get a copy of the frame counters. Thread-safe.
+	FrameStatistics frameStatistics() const;
+
+	void resetFrameStatistics();
+
+	/*!
+	 * Periodically print frame statistics (as JSON) to debug log.
+	 * \param msec - logging interval; 0 disables logging (the default).
+	 */
+	void setStatisticsLogInterval(int msec);
+
 public slots:
 	/*!
 	 * Free Android view and OpenGL resources. The object will be unusable after that.
@@ -322,6 +566,14 @@ public slots:
 	 */
 	void requestVisibleRect();
 
+	//! Print frame statistics to debug log.
+	void logFrameStatistics();
+
+	//! Send commands buffered since the last flush to Java now (\see setCommandBuffering()).
+	void flushCommands();
+
+	//! Send move events collected by mouse() to Java now (\see setTouchBatching()).
+	void flushTouchEvents();
 
 signals:
 	/*!
@@ -330,6 +582,12 @@ signals:
 	 */
 	void updated();
 
+	/*!
+	 * Emitted together with updated(). \a dirty_rect is the part of the view changed
+	 * since the previous update; an empty rect means the whole view.
+	 */
+	void updated(const QRect & dirty_rect);
+
 	/*!
 	 * Emitted when view has been actually created.
 	 */
@@ -341,17 +599,87 @@ signals:
 	void visibleRectReceived(int width, int height);
 
 private slots:
-	void javaUpdate();
+	void javaUpdate(qint64 paint_started_ns = 0, const QRect & dirty_rect = QRect());
 	void javaViewCreated();
 	void javaVisibleRectReceived(int left, int top, int right, int bottom);
+	void onMemoryTrimRequested(int level);
+	//! Return to the pool the retired bitmaps which Java has finished painting on.
+	void releaseFreeBitmaps();
 
 private:
 	const QImage * getPreviousBitmapBuffer(bool convert_from_android_format);
+	bool doUpdateGLTextureInHolder();
+	//! Check if the view can be seen by user now.
+	bool isShown() const;
+	//! Release bitmaps and texture of a hidden view keeping a low-res snapshot.
+	void trimResources();
+	//! Re-create the bitmaps released by trimResources() and repaint the view.
+	void restoreResources();
+	/*!
+	 * Pass the bitmaps to Java (null to detach them) and take care of the bitmaps
+	 * retired by bitmap_a_ / bitmap_b_: they are returned to the pool right away
+	 * if Java is not painting on them now, or after the paint is finished.
+	 * Should be called with bitmaps_mutex_ locked.
+	 * \return false if Java is still painting on the old bitmaps.
+	 */
+	bool setJavaBitmaps(jobject bitmap_a, jobject bitmap_b);
+	//! Release (or discard, if Java may use them) all retired bitmaps. Call with bitmaps_mutex_ locked.
+	void releaseRetiredBitmaps(bool to_pool);
+
+	//! Opcodes of the buffered commands. Must match COMMAND_* in OffscreenView.java.
+	enum CommandKind
+	{
+		CommandSetPosition = 0,
+		CommandSetVisible = 1,
+		CommandSetEnabled = 2,
+		CommandSetScrollX = 3,
+		CommandSetScrollY = 4,
+		CommandSetFocused = 5,
+		CommandQueryVisibleRect = 6
+	};
+
+	struct Command
+	{
+		int kind;
+		int a;
+		int b;
+	};
+
+	/*!
+	 * Add a command to the buffer sent by flushCommands(). Returns false if the
+	 * command can't be buffered (buffering is disabled or called from another thread),
+	 * so the caller should call Java by itself.
+	 */
+	bool bufferCommand(CommandKind kind, int a = 0, int b = 0);
 
 protected:
 	const QImage * getBitmapBuffer(bool * out_texture_updated, bool convert_from_android_format);
 	bool updateGlTexture();
 	bool updateBitmapToGlTexture();
+	//! Implementation of updateBitmapToGlTexture(), called with bitmaps_mutex_ locked.
+	bool doUpdateBitmapToGlTexture();
+	//! Update statistics when a new frame is taken from Java side.
+	void frameTaken();
+	//! Check if Java has published a frame which hasn't been taken yet. Lock-free.
+	bool hasNewFrame() { return published_frame_.fetchAndAddOrdered(0) != taken_frame_.fetchAndAddOrdered(0); }
+	//! Re-create bitmaps if their bitness doesn't match desiredBitmapBitness().
+	void updateBitmapFormat();
+	/*!
+	 * Make a 16-bit copy of the last frame, e.g. to show it later via showSnapshot().
+	 * Returns a null image if there's no frame yet or the view works in GL (SurfaceTexture) mode.
+	 */
+	QImage grabSnapshot();
+	/*!
+	 * Show the image (stretched to the view size) instead of the view's content until
+	 * releaseSnapshot() is called and the view is painted again. Bitmap mode only.
+	 */
+	void showSnapshot(const QImage & image);
+	void releaseSnapshot();
+	/*!
+	 * Register native methods of the View's Java class. The methods are registered only
+	 * for the first View of the class, subsequent calls just return true. Thread-safe.
+	 */
+	bool registerViewNativeMethods(const JNINativeMethod * methods, size_t sizeof_methods);
 	QJniObject * offscreenView() { return offscreen_view_.data(); }
 	const QJniObject * offscreenView() const { return offscreen_view_.data(); }
 	QJniObject * getView();
@@ -367,26 +695,106 @@ private:
 	QImage android_to_qt_buffer_;
 	int last_qt_buffer_;
 
+	//! Part of the view changed in the frame last taken by getBitmapBuffer(); empty means whole view.
+	QRect taken_dirty_rect_;
+
 	//! Double buffer for Bitmap mode.
 	QAndroidJniImagePair bitmap_a_, bitmap_b_;
 
+	//! Bitmaps replaced while Java was painting on them, with the bitmap generation they belong to.
+	QList<QPair<int, QAndroidJniBitmapPool::Bitmap> > retired_bitmaps_;
+	//! Incremented every time the retired bitmaps are left busy by setJavaBitmaps().
+	int bitmaps_generation_;
+	//! Generation of the retired bitmaps waiting for the next nativeUpdate(), or 0.
+	QAtomicInt busy_bitmaps_generation_;
+	//! Retired bitmaps of this and older generations are not used by Java anymore.
+	QAtomicInt free_bitmaps_generation_;
+	//! The Java view has been deleted while painting on our bitmaps; they can't be reused.
+	bool java_bitmaps_busy_;
+
 	//! Used to lock bitmap_a_/bitmap_b_ access.
-	QMutex bitmaps_mutex_;
+	mutable QMutex bitmaps_mutex_;
 
 	QScopedPointer<QJniObject> offscreen_view_;
 	QSize size_;
 	QColor fill_color_;
-	volatile bool need_update_texture_;
+	BitmapFormatPolicy bitmap_format_policy_;
+	//! Sequence number of the last frame painted by Java; incremented in javaUpdate().
+	QAtomicInt published_frame_;
+	//! Sequence number of the last frame taken into the texture / bitmap buffer.
+	QAtomicInt taken_frame_;
 	volatile bool view_painted_;
 	bool texture_received_;
 	bool view_creation_requested_;
 	bool is_visible_;
 	bool is_enabled_;
+	bool is_painting_paused_;
+	int max_update_rate_;
+	bool vsync_pacing_;
+	bool use_texture_atlas_;
+	int memory_trim_level_;
+	bool touch_batching_;
+	bool touch_flushed_by_frames_;
+	//! Move events collected by mouse(): (uptime millis, x, y) for each event.
+	QVector<jlong> touch_samples_;
+	QTimer touch_flush_timer_;
+	//! Time (monotonic, ns) when the first event in touch_samples_ has been received.
+	qint64 touch_batch_started_ns_;
+	//! Time (monotonic, ns) of the first event of the batch sent to Java and not painted yet.
+	qint64 touch_latency_started_ns_;
+	bool command_buffering_;
+	//! Commands recorded by bufferCommand(), at most one of each kind, in order of recording.
+	QVector<Command> commands_;
+	QTimer command_flush_timer_;
+	//! Time (monotonic, ns) when the first command in commands_ has been recorded.
+	qint64 commands_started_ns_;
+	//! Bitmaps are released by trimResources().
+	volatile bool resources_trimmed_;
+	//! Image shown after trimResources() or by showSnapshot() until the view is painted again.
+	QImage snapshot_;
+	//! Keep showing snapshot_ even if there are new frames (until releaseSnapshot()).
+	bool snapshot_pinned_;
+	//! The texture contains snapshot_.
+	bool snapshot_uploaded_;
 	volatile mutable bool view_created_; //!< Cache for isCreated()
 	int last_texture_width_, last_texture_height_;
+
+	//! Frame counters and timing; statistics_mutex_ protects them from concurrent updates.
+	FrameStatistics statistics_;
+	mutable QMutex statistics_mutex_;
+	//! Time of the last javaUpdate() (monotonic, ns) which has not been taken by Qt yet.
+	volatile qint64 last_update_time_ns_;
+	QTimer statistics_log_timer_;
+
+	/*!
+	 * Frame state written by Java updateFrameState() via a direct ByteBuffer.
+	 * The layout must match the offsets in OffscreenView.java.
+	 */
+	struct FrameState
+	{
+		FrameState(): width(0), height(0), buffer_index(-1), padding(0), timestamp_ns(0)
+			, dirty_left(0), dirty_top(0), dirty_right(0), dirty_bottom(0)
+		{
+			for (int i = 0; i < 16; ++i)
+			{
+				matrix[i] = 0;
+			}
+		}
+		float matrix[16];
+		qint32 width;
+		qint32 height;
+		qint32 buffer_index;
+		qint32 padding;
+		qint64 timestamp_ns;
+		qint32 dirty_left;
+		qint32 dirty_top;
+		qint32 dirty_right;
+		qint32 dirty_bottom;
+	} frame_state_;
+	QScopedPointer<QJniObject> frame_state_buffer_;
 private:
 	Q_DISABLE_COPY(QAndroidOffscreenView)
-	friend void JNICALL Java_OffscreenView_nativeUpdate(JNIEnv * env, jobject jo, jlong param);
+	friend void JNICALL Java_OffscreenView_nativeUpdate(JNIEnv * env, jobject jo, jlong param, jlong paint_started_ns, jint dirty_left, jint dirty_top, jint dirty_right, jint dirty_bottom);
 	friend void JNICALL Java_OffscreenView_nativeViewCreated(JNIEnv *, jobject, jlong param);
 	friend void JNICALL Java_OffscreenView_onVisibleRect(JNIEnv *, jobject, jlong param, int left, int top, int right, int bottom);
 };
@@ -0,0 +1,269 @@
+/*
+  Offscreen Android Views library for Qt
+
+  Author:
+  Sergey A. Galin <sergey.galin@gmail.com>
+
+  Distrbuted under The BSD License
+
+  Copyright (c) 2014, DoubleGIS, LLC.
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+  * Neither the name of the DoubleGIS, LLC nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS
+  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+  THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <time.h>
+#include <QtCore/QDebug>
+#include <QtCore/QCoreApplication>
+#include <QtCore/QTimer>
+#include "QAndroidOffscreenViewPool.h"
+
+//! The same clock as used by QAndroidOffscreenView statistics.
+static qint64 monotonicNs()
+{
+	struct timespec ts;
+	clock_gettime(CLOCK_MONOTONIC, &ts);
+	return qint64(ts.tv_sec) * Q_INT64_C(1000000000) + qint64(ts.tv_nsec);
+}
+
+QString QAndroidOffscreenViewPool::Statistics::toString() const
+{
+	return QString("hits: %1, misses: %2 (hit rate %3%), prewarmed: %4, returned: %5, deleted: %6, "
+		"created: %7 (avg %8 ms, max %9 ms)")
+		.arg(hits).arg(misses).arg(hitRate() * 100.0, 0, 'f', 1)
+		.arg(prewarmed).arg(returned).arg(deleted)
+		.arg(creation_count).arg(averageCreationMs(), 0, 'f', 1).arg(double(creation_max_ns) / 1000000.0, 0, 'f', 1);
+}
+
+QAndroidOffscreenViewPool::QAndroidOffscreenViewPool()
+	: types_()
+	, creating_()
+	, prewarming_()
+	, prewarm_scheduled_(false)
+	, statistics_()
+{
+}
+
+QAndroidOffscreenViewPool::~QAndroidOffscreenViewPool()
+{
+	clear();
+}
+
+QAndroidOffscreenViewPool * QAndroidOffscreenViewPool::instance()
+{
+	// The pool belongs to the application object, and the views are deleted on
+	// aboutToQuit(), while JNI and the event loop are still available.
+	static QPointer<QAndroidOffscreenViewPool> instance;
+	if (instance.isNull())
+	{
+		instance = new QAndroidOffscreenViewPool();
+		if (QCoreApplication * app = QCoreApplication::instance())
+		{
+			instance->setParent(app);
+			connect(app, SIGNAL(aboutToQuit()), instance.data(), SLOT(clear()));
+		}
+		else
+		{
+			qWarning("QAndroidOffscreenViewPool: created before QCoreApplication; the idle views will not be deleted.");
+		}
+	}
+	return instance.data();
+}
+
+QAndroidOffscreenView * QAndroidOffscreenViewPool::createTracked(Factory factory, const QString & object_name, const QSize & def_size)
+{
+	qint64 started_ns = monotonicNs();
+	QAndroidOffscreenView * view = factory(object_name, def_size);
+	creating_.insert(view, started_ns);
+	connectTracked(view);
+	return view;
+}
+
+void QAndroidOffscreenViewPool::connectTracked(QAndroidOffscreenView * view)
+{
+	connect(view, SIGNAL(viewCreated()), this, SLOT(onViewCreated()));
+	connect(view, SIGNAL(destroyed(QObject*)), this, SLOT(onViewDestroyed(QObject*)));
+}
+
+void QAndroidOffscreenViewPool::prewarm(const QString & type, Factory factory, int count, int delay_ms)
+{
+	TypeData & data = types_[type];
+	data.factory = factory;
+	data.target_count = qMax(data.target_count, count);
+	if (!prewarm_scheduled_ && !prewarming_)
+	{
+		prewarm_scheduled_ = true;
+		QTimer::singleShot(qMax(0, delay_ms), this, SLOT(prewarmNext()));
+	}
+}
+
+QString QAndroidOffscreenViewPool::nextTypeToPrewarm() const
+{
+	QString result;
+	int max_missing = 0;
+	for (QHash<QString, TypeData>::const_iterator it = types_.constBegin(); it != types_.constEnd(); ++it)
+	{
+		int missing = it.value().target_count - it.value().idle.size();
+		if (it.value().factory && missing > max_missing)
+		{
+			max_missing = missing;
+			result = it.key();
+		}
+	}
+	return result;
+}
+
+void QAndroidOffscreenViewPool::prewarmNext()
+{
+	prewarm_scheduled_ = false;
+	if (prewarming_)
+	{
+		return; // Will continue when the current view is created.
+	}
+	QString type = nextTypeToPrewarm();
+	if (type.isEmpty())
+	{
+		return;
+	}
+	TypeData & data = types_[type];
+	QAndroidOffscreenView * view = createTracked(data.factory, QLatin1String("Pooled") + type, QSize(512, 512));
+	data.idle.append(view);
+	prewarming_ = view;
+	statistics_.prewarmed++;
+}
+
+void QAndroidOffscreenViewPool::onViewCreated()
+{
+	QAndroidOffscreenView * view = qobject_cast<QAndroidOffscreenView *>(sender());
+	QHash<QAndroidOffscreenView *, qint64>::iterator it = creating_.find(view);
+	if (it != creating_.end())
+	{
+		qint64 latency_ns = monotonicNs() - it.value();
+		creating_.erase(it);
+		statistics_.creation_count++;
+		statistics_.creation_total_ns += latency_ns;
+		statistics_.creation_max_ns = qMax(statistics_.creation_max_ns, latency_ns);
+		qDebug()<<"QAndroidOffscreenViewPool:"<<view->metaObject()->className()<<"created in"<<double(latency_ns) / 1000000.0<<"ms";
+		disconnect(view, SIGNAL(viewCreated()), this, SLOT(onViewCreated()));
+		disconnect(view, SIGNAL(destroyed(QObject*)), this, SLOT(onViewDestroyed(QObject*)));
+	}
+	if (view == prewarming_)
+	{
+		prewarming_ = 0;
+		if (!prewarm_scheduled_)
+		{
+			prewarm_scheduled_ = true;
+			QTimer::singleShot(0, this, SLOT(prewarmNext()));
+		}
+	}
+}
+
+void QAndroidOffscreenViewPool::onViewDestroyed(QObject * object)
+{
+	// Deleted by its user before Java has created it; the address may be reused by another view.
+	// (Only the pointer value is used, the view is already destroyed.)
+	creating_.remove(static_cast<QAndroidOffscreenView *>(object));
+}
+
+QAndroidOffscreenView * QAndroidOffscreenViewPool::acquire(const QString & type, Factory factory, const QString & object_name, const QSize & def_size)
+{
+	TypeData & data = types_[type];
+	if (!data.factory)
+	{
+		data.factory = factory;
+	}
+	if (data.idle.isEmpty())
+	{
+		statistics_.misses++;
+		return createTracked(factory, object_name, def_size);
+	}
+
+	statistics_.hits++;
+	QAndroidOffscreenView * view = data.idle.takeFirst();
+	view->setObjectName(object_name);
+	view->resize(def_size);
+
+	// Replenish the pool in background
+	if (data.idle.size() < data.target_count && !prewarm_scheduled_ && !prewarming_)
+	{
+		prewarm_scheduled_ = true;
+		QTimer::singleShot(0, this, SLOT(prewarmNext()));
+	}
+	return view;
+}
+
+void QAndroidOffscreenViewPool::release(QAndroidOffscreenView * view)
+{
+	if (!view)
+	{
+		return;
+	}
+	QHash<QString, TypeData>::iterator it = types_.find(view->metaObject()->className());
+	if (it != types_.end() && it.value().factory && !view->isIntialized()
+		&& it.value().idle.size() < it.value().target_count)
+	{
+		// Resetting the state changed by the previous user
+		bool creating = creating_.contains(view);
+		view->disconnect();
+		if (creating)
+		{
+			connectTracked(view);
+		}
+		view->setParent(0);
+		view->setVisible(false);
+		view->setEnabled(true);
+		view->setPaintingPaused(false);
+		if (view->resetForReuse())
+		{
+			it.value().idle.append(view);
+			statistics_.returned++;
+			return;
+		}
+		qDebug()<<"QAndroidOffscreenViewPool:"<<view->metaObject()->className()<<"can't be reset, deleting it";
+	}
+	creating_.remove(view);
+	delete view;
+	statistics_.deleted++;
+}
+
+void QAndroidOffscreenViewPool::releaseView(QAndroidOffscreenView * view)
+{
+	instance()->release(view);
+}
+
+void QAndroidOffscreenViewPool::clear()
+{
+	for (QHash<QString, TypeData>::iterator it = types_.begin(); it != types_.end(); ++it)
+	{
+		it.value().target_count = 0;
+		while (!it.value().idle.isEmpty())
+		{
+			QAndroidOffscreenView * view = it.value().idle.takeFirst();
+			creating_.remove(view);
+			delete view;
+			statistics_.deleted++;
+		}
+	}
+}
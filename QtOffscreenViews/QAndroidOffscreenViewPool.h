@@ -0,0 +1,165 @@
+/*
+  Offscreen Android Views library for Qt
+
+  Author:
+  Sergey A. Galin <sergey.galin@gmail.com>
+
+  Distrbuted under The BSD License
+
+  Copyright (c) 2014, DoubleGIS, LLC.
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+  * Neither the name of the DoubleGIS, LLC nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS
+  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+  THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include <QtCore/QObject>
+#include <QtCore/QHash>
+#include <QtCore/QList>
+#include <QtCore/QPointer>
+#include <QtCore/QSize>
+#include <QtCore/QString>
+#include "QAndroidOffscreenView.h"
+
+/*!
+ * Warm pool of offscreen views. Creation of an Android View (especially WebView)
+ * takes a lot of time in Android UI thread, so the views can be pre-created
+ * after application startup via prewarm() and then handed out by acquire().
+ * The pool is keyed by the C++ class of the view. It should be used from GUI thread.
+ *
+ * Only views which have not been initialized for painting yet (\see
+ * QAndroidOffscreenView::isIntialized()) can go back to the pool in release(),
+ * because GL resources of a view belong to the context it was painted in;
+ * other released views are deleted.
+ */
+class QAndroidOffscreenViewPool: public QObject
+{
+	Q_OBJECT
+public:
+	struct Statistics
+	{
+		Statistics(): hits(0), misses(0), prewarmed(0), returned(0), deleted(0)
+			, creation_count(0), creation_total_ns(0), creation_max_ns(0) {}
+		QString toString() const;
+		//! Part of acquire() calls served from the pool, 0..1.
+		double hitRate() const { return (hits + misses > 0)? double(hits) / double(hits + misses): 0.0; }
+		double averageCreationMs() const { return (creation_count > 0)? double(creation_total_ns) / double(creation_count) / 1000000.0: 0.0; }
+
+		qint64 hits;
+		qint64 misses;
+		//! Views created by prewarm().
+		qint64 prewarmed;
+		//! Views put back into the pool by release().
+		qint64 returned;
+		//! Views deleted by release() or clear().
+		qint64 deleted;
+		//! Creating C++ object => QAndroidOffscreenView::viewCreated(), for all views created by the pool.
+		qint64 creation_count;
+		qint64 creation_total_ns;
+		qint64 creation_max_ns;
+	};
+
+	static QAndroidOffscreenViewPool * instance();
+	virtual ~QAndroidOffscreenViewPool();
+
+	/*!
+	 * Pre-create views of class T so there are at least \a count idle views of it.
+	 * Views are created one by one: next one is created after the previous one has
+	 * been constructed on Android side, so UI thread is never busy for long.
+	 * \param delay_ms - delay before creating the first view, e.g. to let the first screen appear.
+	 */
+	template<class T> void prewarm(int count, int delay_ms = 0)
+	{
+		prewarm(T::staticMetaObject.className(), &createView<T>, count, delay_ms);
+	}
+
+	/*!
+	 * Take a view of class T from the pool, or create a new one if there is no idle view.
+	 * The caller owns the view and should give it back via release() (or just delete it).
+	 * \param def_size - the size of the view; pooled views are resized to it.
+	 */
+	template<class T> T * acquire(const QString & object_name, const QSize & def_size)
+	{
+		return static_cast<T *>(acquire(T::staticMetaObject.className(), &createView<T>, object_name, def_size));
+	}
+
+	/*!
+	 * Give the view back to the pool. The view is hidden, disconnected from all receivers
+	 * and reset via QAndroidOffscreenView::resetForReuse(), and then kept to be returned
+	 * by acquire(). Views which can't be reset are deleted (\see also class description).
+	 */
+	void release(QAndroidOffscreenView * view);
+
+	//! Deleter for QSharedPointer / QScopedPointer which calls release().
+	static void releaseView(QAndroidOffscreenView * view);
+
+	Statistics statistics() const { return statistics_; }
+	void resetStatistics() { statistics_ = Statistics(); }
+
+public slots:
+	//! Delete all idle views. Called automatically when the application is about to quit.
+	void clear();
+
+private slots:
+	void prewarmNext();
+	void onViewCreated();
+	void onViewDestroyed(QObject * object);
+
+private:
+	typedef QAndroidOffscreenView * (*Factory)(const QString & object_name, const QSize & def_size);
+
+	template<class T> static QAndroidOffscreenView * createView(const QString & object_name, const QSize & def_size)
+	{
+		return new T(object_name, def_size);
+	}
+
+	struct TypeData
+	{
+		TypeData(): factory(0), target_count(0) {}
+		Factory factory;
+		//! How many idle views prewarm() should keep.
+		int target_count;
+		QList<QAndroidOffscreenView *> idle;
+	};
+
+	QAndroidOffscreenViewPool();
+	void prewarm(const QString & type, Factory factory, int count, int delay_ms);
+	QAndroidOffscreenView * acquire(const QString & type, Factory factory, const QString & object_name, const QSize & def_size);
+	QAndroidOffscreenView * createTracked(Factory factory, const QString & object_name, const QSize & def_size);
+	//! Connect to the signals which end tracking of the creation time of the view.
+	void connectTracked(QAndroidOffscreenView * view);
+	//! Type which needs a view more than others, or empty string.
+	QString nextTypeToPrewarm() const;
+
+	QHash<QString, TypeData> types_;
+	//! Creation start time of the views which are being created (removed if the view is deleted first).
+	QHash<QAndroidOffscreenView *, qint64> creating_;
+	//! The view being created by prewarm(); the next one is created after this one is ready.
+	QPointer<QAndroidOffscreenView> prewarming_;
+	bool prewarm_scheduled_;
+	Statistics statistics_;
+private:
+	Q_DISABLE_COPY(QAndroidOffscreenViewPool)
+};
@@ -34,9 +34,49 @@
   THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <QtCore/QUrl>
 #include <QAndroidQPAPluginGap.h>
 #include "QAndroidOffscreenWebView.h"
 
+static const char * const c_streamed_document_origin = "http://offscreenwebview.invalid/";
+
+//! How many header sets of loadUrl() are kept on Java side.
+static const int c_max_header_sets = 4;
+
+static const int c_default_snapshot_cache_budget = 8 * 1024 * 1024;
+
+// Returns a copy of window.performance.timing as a plain object, so it is serialized with all its fields.
+static const char * const c_navigation_timing_script =
+	"(function(){ var t = window.performance && window.performance.timing;"
+	" return t ? JSON.parse(JSON.stringify(t)) : null; })()";
+
+//! Quote and escape a string for JSON.
+static QString jsonString(const QString & str)
+{
+	QString result;
+	result.reserve(str.size() + 2);
+	result += QLatin1Char('"');
+	for (int i = 0; i < str.size(); ++i)
+	{
+		QChar c = str.at(i);
+		if (c == QLatin1Char('"') || c == QLatin1Char('\\'))
+		{
+			result += QLatin1Char('\\');
+			result += c;
+		}
+		else if (c.unicode() < 0x20)
+		{
+			result += QString::fromLatin1("\\u%1").arg(int(c.unicode()), 4, 16, QLatin1Char('0'));
+		}
+		else
+		{
+			result += c;
+		}
+	}
+	result += QLatin1Char('"');
+	return result;
+}
+
 //! Convert nativeptr from Java to AndroidOffscreenWebView.
 static inline QAndroidOffscreenWebView * AOWW(jlong nativeptr)
 {
@@ -170,6 +210,12 @@ Q_DECL_EXPORT jobject JNICALL Java_shouldInterceptRequest(JNIEnv * env, jobject
 	return 0; // Not intercepting request
 }
 
+// public static native void releaseResourceBuffer(long holder);
+Q_DECL_EXPORT void JNICALL Java_releaseResourceBuffer(JNIEnv *, jclass, jlong holder)
+{
+	delete reinterpret_cast<QByteArray*>(reinterpret_cast<void*>(holder));
+}
+
 // public native boolean shouldOverrideKeyEvent(long nativeptr, KeyEvent event);
 Q_DECL_EXPORT jboolean JNICALL Java_shouldOverrideKeyEvent(JNIEnv * env, jobject jo, jlong nativeptr, jobject event)
 {
@@ -214,6 +260,53 @@ Q_DECL_EXPORT void JNICALL Java_onCanGoBackReceived(JNIEnv *, jobject, jlong nat
 	}
 }
 
+/*!
+ * Read a Java string directly into QString's buffer. GetStringRegion() copies the characters
+ * once, while GetStringChars() may make a copy of its own which we'd copy once again.
+ */
+static QString readJavaString(JNIEnv * env, jstring str)
+{
+	if (!str)
+	{
+		return QString();
+	}
+	jsize length = env->GetStringLength(str);
+	QString result(length, Qt::Uninitialized);
+	if (length > 0)
+	{
+		env->GetStringRegion(str, 0, length, reinterpret_cast<jchar*>(result.data()));
+	}
+	return result;
+}
+
+Q_DECL_EXPORT void JNICALL Java_onJavascriptResults(JNIEnv * env, jobject, jlong nativeptr, jintArray ids, jobjectArray results)
+{
+	if (QAndroidOffscreenWebView * wv = AOWW(nativeptr))
+	{
+		jsize count = (ids)? env->GetArrayLength(ids): 0;
+		QList<int> qids;
+		QStringList qresults;
+		qids.reserve(count);
+		qresults.reserve(count);
+		if (count > 0)
+		{
+			jint * id_ptr = env->GetIntArrayElements(ids, 0);
+			for (jsize i = 0; i < count; ++i)
+			{
+				jstring result = static_cast<jstring>(env->GetObjectArrayElement(results, i));
+				qids.append(int(id_ptr[i]));
+				qresults.append(readJavaString(env, result));
+				if (result)
+				{
+					env->DeleteLocalRef(result);
+				}
+			}
+			env->ReleaseIntArrayElements(ids, id_ptr, JNI_ABORT);
+		}
+		wv->onJavascriptResults(qids, qresults);
+	}
+}
+
 Q_DECL_EXPORT void JNICALL Java_onCanGoForwardReceived(JNIEnv *, jobject, jlong nativeptr, jboolean can)
 {
 	if (QAndroidOffscreenWebView * wv = AOWW(nativeptr))
@@ -233,7 +326,32 @@ Q_DECL_EXPORT void JNICALL Java_onCanGoBackOrForwardReceived(JNIEnv *, jobject,
 QAndroidOffscreenWebView::QAndroidOffscreenWebView(const QString & object_name, const QSize & def_size, QObject * parent)
 	: QAndroidOffscreenView(QLatin1String("OffscreenWebView"), object_name, def_size, parent)
 	, ignore_ssl_errors_(false)
+	, resource_resolvers_()
+	, resource_resolvers_mutex_()
+	, streamed_document_url_()
+	, streamed_document_()
+	, streamed_document_counter_(0)
+	, last_javascript_id_(0)
+	, pending_javascript_ids_()
+	, pending_javascripts_()
+	, javascript_flush_timer_()
+	, snapshot_cache_(c_default_snapshot_cache_budget)
+	, snapshot_page_url_()
+	, snapshot_cache_mutex_()
+	, page_load_statistics_()
+	, page_load_timer_()
+	, page_loading_(false)
+	, navigation_timing_enabled_(false)
+	, navigation_timing_request_id_(0)
+	, page_load_mutex_()
+	, header_sets_()
+	, last_header_set_id_(0)
 {
+	qRegisterMetaType< QList<int> >("QList<int>");
+	javascript_flush_timer_.setSingleShot(true);
+	javascript_flush_timer_.setInterval(0);
+	connect(&javascript_flush_timer_, SIGNAL(timeout()), this, SLOT(flushJavascript()));
+
 	static const JNINativeMethod methods[] = {
 		//
 		// WebViewClient Methods
@@ -251,6 +369,7 @@ QAndroidOffscreenWebView::QAndroidOffscreenWebView(const QString & object_name,
 		{"onTooManyRedirects", "(JLandroid/os/Message;Landroid/os/Message;)V", reinterpret_cast<void*>(Java_onTooManyRedirects)},
 		{"onUnhandledKeyEvent", "(JLandroid/view/KeyEvent;)V", reinterpret_cast<void*>(Java_onUnhandledKeyEvent)},
 		{"shouldInterceptRequest", "(JLjava/lang/String;)Landroid/webkit/WebResourceResponse;", reinterpret_cast<void*>(Java_shouldInterceptRequest)},
+		{"releaseResourceBuffer", "(J)V", reinterpret_cast<void*>(Java_releaseResourceBuffer)},
 		{"shouldOverrideKeyEvent", "(JLandroid/view/KeyEvent;)Z", reinterpret_cast<void*>(Java_shouldOverrideKeyEvent)},
 		{"shouldOverrideUrlLoading", "(JLjava/lang/String;)Z", reinterpret_cast<void*>(Java_shouldOverrideUrlLoading)},
 
@@ -266,24 +385,9 @@ QAndroidOffscreenWebView::QAndroidOffscreenWebView(const QString & object_name,
 		{"onCanGoBackReceived", "(JZ)V", reinterpret_cast<void*>(Java_onCanGoBackReceived)},
 		{"onCanGoForwardReceived", "(JZ)V", reinterpret_cast<void*>(Java_onCanGoForwardReceived)},
 		{"onCanGoBackOrForwardReceived", "(JZI)V", reinterpret_cast<void*>(Java_onCanGoBackOrForwardReceived)},
+		{"onJavascriptResults", "(J[I[Ljava/lang/String;)V", reinterpret_cast<void*>(Java_onJavascriptResults)},
 	};
-	if (QJniObject * ov = offscreenView())
-	{
-		qDebug()<<__PRETTY_FUNCTION__<<"Registering"<<sizeof(methods)/sizeof(JNINativeMethod)<<"JNI methods for WebView";
-		bool ok = ov->registerNativeMethods(methods, sizeof(methods));
-		if (!ok)
-		{
-			qCritical()<<"Failed to register native methods!";
-		}
-		else
-		{
-			qDebug()<<"QAndroidOffscreenWebView successfully registered native methods.";
-		}
-	}
-	else
-	{
-		qCritical("Failed to register native methods of QAndroidOffscreenWebView because Java object pointer is null.");
-	}
+	registerViewNativeMethods(methods, sizeof(methods));
 }
 
 QAndroidOffscreenWebView::~QAndroidOffscreenWebView()
@@ -292,9 +396,37 @@ QAndroidOffscreenWebView::~QAndroidOffscreenWebView()
 
 void QAndroidOffscreenWebView::preloadJavaClasses()
 {
-	QAndroidOffscreenView::preloadJavaClasses();
-	QString path = getDefaultJavaClassPath() + QLatin1String("OffscreenWebView");
-	QAndroidQPAPluginGap::preloadJavaClass(path.toLatin1());
+	preloadViewJavaClass(QLatin1String("OffscreenWebView"));
+}
+
+bool QAndroidOffscreenWebView::resetForReuse()
+{
+	if (!QAndroidOffscreenView::resetForReuse())
+	{
+		return false;
+	}
+	ignore_ssl_errors_ = false;
+	navigation_timing_enabled_ = false;
+	javascript_flush_timer_.stop();
+	pending_javascript_ids_.clear();
+	pending_javascripts_.clear();
+	header_sets_.clear();
+	{
+		QMutexLocker locker(&resource_resolvers_mutex_);
+		resource_resolvers_.clear();
+		streamed_document_url_.clear();
+		streamed_document_ = QAndroidWebResourceResolver::Resource();
+	}
+	{
+		QMutexLocker locker(&snapshot_cache_mutex_);
+		snapshot_cache_.clear();
+		snapshot_cache_.setMaxCost(c_default_snapshot_cache_budget);
+		snapshot_page_url_.clear();
+	}
+	resetPageLoadStatistics();
+	// Loads about:blank, clears history and Java copies of the header sets
+	offscreenView()->callVoid("resetForReuse");
+	return true;
 }
 
 bool QAndroidOffscreenWebView::loadUrl(const QString & url)
@@ -312,21 +444,55 @@ bool QAndroidOffscreenWebView::loadUrl(const QString & url)
 bool QAndroidOffscreenWebView::loadUrl(const QString & url, const QMap<QString, QString> & additionalHttpHeaders)
 {
 	QJniObject * view = offscreenView();
-	if (view)
+	if (!view)
 	{
-		QString strheaders;
-		for(QMap<QString, QString>::const_iterator it = additionalHttpHeaders.begin(); it != additionalHttpHeaders.end(); ++it)
+		qWarning("QAndroidOffscreenWebView: Attempt to load URL when View is null.");
+		return false;
+	}
+
+	// Java keeps Maps of the recently used header sets, so a known set is passed just by its id.
+	for (int i = 0; i < header_sets_.size(); ++i)
+	{
+		if (header_sets_.at(i).second == additionalHttpHeaders)
 		{
-			strheaders += it.key();
-			strheaders += QChar('\n');
-			strheaders += it.value();
-			strheaders += QChar('\n');
+			header_sets_.move(i, 0);
+			view->callParamVoid("loadUrlWithHeaderSet", "Ljava/lang/String;I"
+				, QJniLocalRef(url).jObject()
+				, jint(header_sets_.first().first));
+			return true;
 		}
-		view->callVoid("loadUrl", url, strheaders);
-		return true;
 	}
-	qWarning("QAndroidOffscreenWebView: Attempt to load URL when View is null.");
-	return false;
+
+	int evicted_id = 0;
+	if (header_sets_.size() >= c_max_header_sets)
+	{
+		evicted_id = header_sets_.last().first;
+		header_sets_.removeLast();
+	}
+	if (++last_header_set_id_ <= 0)
+	{
+		last_header_set_id_ = 1;
+	}
+	header_sets_.prepend(qMakePair(last_header_set_id_, additionalHttpHeaders));
+
+	// Names and values go interleaved in one array.
+	QJniEnvPtr jep;
+	QJniLocalRef headers(jep.env()->NewObjectArray(
+		jsize(additionalHttpHeaders.size() * 2)
+		, QJniClass("java/lang/String").jClass()
+		, 0));
+	jsize index = 0;
+	for (QMap<QString, QString>::const_iterator it = additionalHttpHeaders.begin(); it != additionalHttpHeaders.end(); ++it)
+	{
+		jep.env()->SetObjectArrayElement(static_cast<jobjectArray>(headers.jObject()), index++, QJniLocalRef(it.key()).jObject());
+		jep.env()->SetObjectArrayElement(static_cast<jobjectArray>(headers.jObject()), index++, QJniLocalRef(it.value()).jObject());
+	}
+	view->callParamVoid("loadUrlWithNewHeaderSet", "Ljava/lang/String;II[Ljava/lang/String;"
+		, QJniLocalRef(url).jObject()
+		, jint(last_header_set_id_)
+		, jint(evicted_id)
+		, static_cast<jobjectArray>(headers.jObject()));
+	return true;
 }
 
 bool QAndroidOffscreenWebView::loadData(const QString & text, const QString & mime, const QString & encoding)
@@ -353,6 +519,28 @@ bool QAndroidOffscreenWebView::loadDataWithBaseURL(const QString & baseUrl, cons
 	return false;
 }
 
+bool QAndroidOffscreenWebView::loadStreamedData(const QByteArray & data, const QString & mimeType, const QString & encoding, const QString & baseUrl)
+{
+	if (!offscreenView())
+	{
+		qWarning("QAndroidOffscreenWebView: Attempt to loadStreamedData when View is null.");
+		return false;
+	}
+	QString url;
+	{
+		QMutexLocker locker(&resource_resolvers_mutex_);
+		// A new name for each document so WebView doesn't take the previous one from its cache.
+		QUrl base((baseUrl.isEmpty())? QString::fromLatin1(c_streamed_document_origin): baseUrl);
+		QUrl document(QString::fromLatin1("offscreenwebview-document-%1.html").arg(++streamed_document_counter_));
+		url = QString::fromLatin1(base.resolved(document).toEncoded());
+		streamed_document_url_ = url;
+		streamed_document_.data = data;
+		streamed_document_.mime_type = mimeType;
+		streamed_document_.encoding = encoding;
+	}
+	return loadUrl(url);
+}
+
 bool QAndroidOffscreenWebView::requestContentHeight()
 {
 	QJniObject * view = offscreenView();
@@ -452,10 +640,39 @@ void QAndroidOffscreenWebView::onFormResubmission(JNIEnv *, jobject, jobject don
 void QAndroidOffscreenWebView::onLoadResource(JNIEnv *, jobject, jobject url)
 {
 	Q_UNUSED(url);
+	QMutexLocker locker(&page_load_mutex_);
+	page_load_statistics_.resources++;
+	page_load_statistics_.total_resources++;
 }
 
 void QAndroidOffscreenWebView::onPageFinished(JNIEnv * env, jobject, jobject url)
 {
+	releaseSnapshot();
+	bool page_load_finished = false;
+	{
+		QMutexLocker locker(&page_load_mutex_);
+		if (page_loading_)
+		{
+			page_loading_ = false;
+			page_load_finished = true;
+			qint64 ns = page_load_timer_.nsecsElapsed();
+			page_load_statistics_.finished_ms = ns / 1000000;
+			page_load_statistics_.load_time.add(ns);
+			page_load_statistics_.pages_finished++;
+		}
+	}
+	if (page_load_finished)
+	{
+		if (navigation_timing_enabled_)
+		{
+			// evaluateJavascript() should be called in the thread of the object.
+			QMetaObject::invokeMethod(this, "requestNavigationTiming", Qt::QueuedConnection);
+		}
+		else
+		{
+			emit pageLoadStatisticsReady();
+		}
+	}
 	emit pageFinished();
 	emit pageFinished(QJniEnvPtr(env).JStringToQString(static_cast<jstring>(url)));
 }
@@ -463,13 +680,28 @@ void QAndroidOffscreenWebView::onPageFinished(JNIEnv * env, jobject, jobject url
 void QAndroidOffscreenWebView::onPageStarted(JNIEnv * env, jobject, jobject url, jobject favicon)
 {
 	Q_UNUSED(favicon);
+	QString qurl = QJniEnvPtr(env).JStringToQString(static_cast<jstring>(url));
+	switchPageSnapshot(qurl);
+	{
+		QMutexLocker locker(&page_load_mutex_);
+		page_load_statistics_.url = qurl;
+		page_load_statistics_.first_progress_ms = -1;
+		page_load_statistics_.finished_ms = -1;
+		page_load_statistics_.resources = 0;
+		page_load_statistics_.errors = 0;
+		page_load_statistics_.navigation_timing.clear();
+		page_load_statistics_.pages_started++;
+		page_load_timer_.start();
+		page_loading_ = true;
+	}
 	emit pageStarted();
-	emit pageStarted(QJniEnvPtr(env).JStringToQString(static_cast<jstring>(url)));
+	emit pageStarted(qurl);
 }
 
 void QAndroidOffscreenWebView::onReceivedError(JNIEnv * env, jobject, int errorCode, jobject description, jobject failingUrl)
 {
 	qDebug() << "QAndroidOffscreenWebView::onReceivedError" << errorCode;
+	countPageLoadError();
 	try
 	{
 		QJniEnvPtr e(env);
@@ -497,6 +729,7 @@ void QAndroidOffscreenWebView::onReceivedLoginRequest(JNIEnv *, jobject, jobject
 
 void QAndroidOffscreenWebView::onReceivedSslError(JNIEnv *, jobject, jobject handler, jobject error)
 {
+	countPageLoadError();
 	try
 	{
 		QJniObject err(error, false);
@@ -537,12 +770,213 @@ void QAndroidOffscreenWebView::onUnhandledKeyEvent(JNIEnv *, jobject, jobject ev
 	Q_UNUSED(event);
 }
 
-jobject QAndroidOffscreenWebView::shouldInterceptRequest(JNIEnv *, jobject, jobject url)
+void QAndroidOffscreenWebView::addResourceResolver(const QSharedPointer<QAndroidWebResourceResolver> & resolver)
 {
-	Q_UNUSED(url);
+	if (resolver)
+	{
+		QMutexLocker locker(&resource_resolvers_mutex_);
+		resource_resolvers_.append(resolver);
+	}
+}
+
+void QAndroidOffscreenWebView::clearResourceResolvers()
+{
+	QMutexLocker locker(&resource_resolvers_mutex_);
+	resource_resolvers_.clear();
+}
+
+void QAndroidOffscreenWebView::setSnapshotCacheBudget(int bytes)
+{
+	QMutexLocker locker(&snapshot_cache_mutex_);
+	snapshot_cache_.setMaxCost(bytes);
+}
+
+int QAndroidOffscreenWebView::snapshotCacheBudget() const
+{
+	QMutexLocker locker(&snapshot_cache_mutex_);
+	return snapshot_cache_.maxCost();
+}
+
+void QAndroidOffscreenWebView::clearSnapshotCache()
+{
+	QMutexLocker locker(&snapshot_cache_mutex_);
+	snapshot_cache_.clear();
+}
+
+void QAndroidOffscreenWebView::switchPageSnapshot(const QString & url)
+{
+	// Note: this is called in Android UI thread, when the old page is still in the bitmap.
+	QMutexLocker locker(&snapshot_cache_mutex_);
+	if (snapshot_cache_.maxCost() <= 0)
+	{
+		return;
+	}
+	if (!snapshot_page_url_.isEmpty())
+	{
+		QImage snapshot = grabSnapshot();
+		if (!snapshot.isNull())
+		{
+			int cost = snapshot.bytesPerLine() * snapshot.height();
+			// QCache deletes the object by itself if it can't be inserted.
+			snapshot_cache_.insert(snapshot_page_url_, new QImage(snapshot), cost);
+		}
+	}
+	snapshot_page_url_ = url;
+	if (const QImage * cached = snapshot_cache_.object(url))
+	{
+		showSnapshot(*cached);
+	}
+}
+
+int QAndroidOffscreenWebView::evaluateJavascript(const QString & script)
+{
+	if (!offscreenView())
+	{
+		qWarning("QAndroidOffscreenWebView: Attempt to evaluateJavascript when View is null.");
+		return 0;
+	}
+	if (++last_javascript_id_ <= 0)
+	{
+		last_javascript_id_ = 1;
+	}
+	pending_javascript_ids_.append(last_javascript_id_);
+	pending_javascripts_.append(script);
+	if (!javascript_flush_timer_.isActive())
+	{
+		javascript_flush_timer_.start();
+	}
+	return last_javascript_id_;
+}
+
+void QAndroidOffscreenWebView::flushJavascript()
+{
+	javascript_flush_timer_.stop();
+	if (pending_javascripts_.isEmpty())
+	{
+		return;
+	}
+	QList<int> ids = pending_javascript_ids_;
+	QStringList scripts = pending_javascripts_;
+	pending_javascript_ids_.clear();
+	pending_javascripts_.clear();
+
+	QJniObject * view = offscreenView();
+	if (!view)
+	{
+		qWarning("QAndroidOffscreenWebView: Attempt to flushJavascript when View is null.");
+		return;
+	}
+	QJniEnvPtr jep;
+	JNIEnv * env = jep.env();
+	jsize count = static_cast<jsize>(ids.size());
+	QJniLocalRef jids(env->NewIntArray(count));
+	QJniLocalRef jscripts(env->NewObjectArray(count, QJniClass("java/lang/String").jClass(), 0));
+	if (!jids.jObject() || !jscripts.jObject() || jep.clearException())
+	{
+		qWarning()<<"Failed to allocate JavaScript batch of"<<count<<"scripts!";
+		return;
+	}
+	for (jsize i = 0; i < count; ++i)
+	{
+		jint id = jint(ids.at(i));
+		env->SetIntArrayRegion(static_cast<jintArray>(jids.jObject()), i, 1, &id);
+		env->SetObjectArrayElement(static_cast<jobjectArray>(jscripts.jObject()), i, QJniLocalRef(scripts.at(i)).jObject());
+	}
+	view->callParamVoid("evaluateJavascriptBatch", "[I[Ljava/lang/String;"
+		, static_cast<jintArray>(jids.jObject())
+		, static_cast<jobjectArray>(jscripts.jObject()));
+}
+
+jobject QAndroidOffscreenWebView::shouldInterceptRequest(JNIEnv * env, jobject jo, jobject url)
+{
+	// Note: this is called in WebView's IO thread.
+	QList< QSharedPointer<QAndroidWebResourceResolver> > resolvers;
+	QString streamed_url;
+	QAndroidWebResourceResolver::Resource resource;
+	{
+		QMutexLocker locker(&resource_resolvers_mutex_);
+		resolvers = resource_resolvers_;
+		streamed_url = streamed_document_url_;
+		resource = streamed_document_;
+	}
+	if ((resolvers.isEmpty() && streamed_url.isEmpty()) || !url)
+	{
+		return 0;
+	}
+	QString qurl = QJniEnvPtr(env).JStringToQString(static_cast<jstring>(url));
+	if (!streamed_url.isEmpty() && qurl == streamed_url)
+	{
+		return createResourceResponse(env, jo, resource);
+	}
+	resource = QAndroidWebResourceResolver::Resource();
+	for (int i = 0; i < resolvers.size(); ++i)
+	{
+		if (resolvers.at(i)->resolve(qurl, resource))
+		{
+			return createResourceResponse(env, jo, resource);
+		}
+	}
 	return 0;
 }
 
+jobject QAndroidOffscreenWebView::createResourceResponse(JNIEnv * env, jobject jo, const QAndroidWebResourceResolver::Resource & resource)
+{
+	static const char * const c_method = "createNativeResourceResponse";
+	jclass cls = env->GetObjectClass(jo);
+	jmethodID mid = env->GetMethodID(cls, c_method,
+		"(Ljava/lang/String;Ljava/lang/String;Ljava/nio/ByteBuffer;J)Landroid/webkit/WebResourceResponse;");
+	env->DeleteLocalRef(cls);
+	if (!mid)
+	{
+		env->ExceptionClear();
+		qWarning()<<"QAndroidOffscreenWebView: method not found:"<<c_method;
+		return 0;
+	}
+
+	// The holder keeps the data alive until Java closes the stream (releaseResourceBuffer()).
+	QByteArray * holder = 0;
+	jobject buffer = 0;
+	if (!resource.data.isEmpty())
+	{
+		holder = new QByteArray(resource.data);
+		// Not using data() which would detach (deep copy) the shared array; Java only reads the buffer.
+		buffer = env->NewDirectByteBuffer(const_cast<char*>(holder->constData()), jlong(holder->size()));
+		if (!buffer)
+		{
+			env->ExceptionClear();
+			delete holder;
+			return 0;
+		}
+	}
+	QJniEnvPtr jep(env);
+	QString mime_type = (resource.mime_type.isEmpty())? QLatin1String("application/octet-stream"): resource.mime_type;
+	jstring jmime_type = jep.JStringFromQString(mime_type);
+	jstring jencoding = (resource.encoding.isEmpty())? 0: jep.JStringFromQString(resource.encoding);
+	jobject response = env->CallObjectMethod(jo, mid, jmime_type, jencoding, buffer,
+		jlong(reinterpret_cast<void*>(holder)));
+	if (env->ExceptionCheck())
+	{
+		env->ExceptionDescribe();
+		env->ExceptionClear();
+		response = 0;
+	}
+	if (!response)
+	{
+		// Java didn't take ownership of the buffer
+		delete holder;
+	}
+	env->DeleteLocalRef(jmime_type);
+	if (jencoding)
+	{
+		env->DeleteLocalRef(jencoding);
+	}
+	if (buffer)
+	{
+		env->DeleteLocalRef(buffer);
+	}
+	return response;
+}
+
 jboolean QAndroidOffscreenWebView::shouldOverrideKeyEvent(JNIEnv *, jobject, jobject event)
 {
 	Q_UNUSED(event);
@@ -570,6 +1004,15 @@ jboolean QAndroidOffscreenWebView::shouldOverrideUrlLoading(JNIEnv *, jobject, j
 void QAndroidOffscreenWebView::onProgressChanged(JNIEnv *, jobject, jobject webview, jint newProgress)
 {
 	Q_UNUSED(webview);
+	{
+		QMutexLocker locker(&page_load_mutex_);
+		if (page_loading_ && page_load_statistics_.first_progress_ms < 0 && newProgress > 0)
+		{
+			qint64 ns = page_load_timer_.nsecsElapsed();
+			page_load_statistics_.first_progress_ms = ns / 1000000;
+			page_load_statistics_.first_progress.add(ns);
+		}
+	}
 	emit progressChanged(newProgress);
 }
 
@@ -596,3 +1039,108 @@ void QAndroidOffscreenWebView::onCanGoBackOrForwardReceived(bool can, int steps)
 {
 	emit canGoBackOrForwardReceived(can, steps);
 }
+
+void QAndroidOffscreenWebView::onJavascriptResults(const QList<int> & ids, const QStringList & results)
+{
+	QList<int> user_ids = ids;
+	QStringList user_results = results;
+	bool navigation_timing_received = false;
+	{
+		QMutexLocker locker(&page_load_mutex_);
+		int index = (navigation_timing_request_id_)? user_ids.indexOf(navigation_timing_request_id_): -1;
+		if (index >= 0)
+		{
+			// Our own request, not to be seen by the user.
+			page_load_statistics_.navigation_timing = user_results.at(index);
+			user_ids.removeAt(index);
+			user_results.removeAt(index);
+			navigation_timing_request_id_ = 0;
+			navigation_timing_received = true;
+		}
+	}
+	if (navigation_timing_received)
+	{
+		emit pageLoadStatisticsReady();
+	}
+	if (!user_ids.isEmpty())
+	{
+		emit javascriptEvaluated(user_ids, user_results);
+	}
+}
+
+/////////////////////////////////////////////////////////////////////////////
+// Page load statistics
+/////////////////////////////////////////////////////////////////////////////
+
+void QAndroidOffscreenWebView::countPageLoadError()
+{
+	QMutexLocker locker(&page_load_mutex_);
+	page_load_statistics_.errors++;
+	page_load_statistics_.total_errors++;
+}
+
+void QAndroidOffscreenWebView::requestNavigationTiming()
+{
+	int id = evaluateJavascript(QString::fromLatin1(c_navigation_timing_script));
+	if (id)
+	{
+		QMutexLocker locker(&page_load_mutex_);
+		navigation_timing_request_id_ = id;
+	}
+	else
+	{
+		emit pageLoadStatisticsReady();
+	}
+}
+
+QAndroidOffscreenWebView::PageLoadStatistics QAndroidOffscreenWebView::pageLoadStatistics() const
+{
+	QMutexLocker locker(&page_load_mutex_);
+	return page_load_statistics_;
+}
+
+void QAndroidOffscreenWebView::resetPageLoadStatistics()
+{
+	QMutexLocker locker(&page_load_mutex_);
+	page_load_statistics_ = PageLoadStatistics();
+	page_loading_ = false;
+}
+
+QString QAndroidOffscreenWebView::PageLoadStatistics::toJson() const
+{
+	// The strings are appended separately as they may contain "%1"-like sequences which arg() would replace.
+	return QString::fromLatin1("{\"url\": ") + jsonString(url)
+		+ QString(", \"first_progress_ms\": %1, \"finished_ms\": %2, \"resources\": %3, \"errors\": %4, "
+		"\"pages_started\": %5, \"pages_finished\": %6, \"total_resources\": %7, \"total_errors\": %8, "
+		"\"first_progress\": %9, \"load_time\": %10, \"navigation_timing\": ")
+		.arg(first_progress_ms)
+		.arg(finished_ms)
+		.arg(resources)
+		.arg(errors)
+		.arg(pages_started)
+		.arg(pages_finished)
+		.arg(total_resources)
+		.arg(total_errors)
+		.arg(first_progress.toJson())
+		.arg(load_time.toJson())
+		+ ((navigation_timing.isEmpty())? QString::fromLatin1("null"): navigation_timing)
+		+ QLatin1Char('}');
+}
+
+QVariantMap QAndroidOffscreenWebView::PageLoadStatistics::toVariantMap() const
+{
+	QVariantMap result;
+	result["url"] = url;
+	result["firstProgressMs"] = first_progress_ms;
+	result["finishedMs"] = finished_ms;
+	result["resources"] = resources;
+	result["errors"] = errors;
+	result["navigationTiming"] = navigation_timing;
+	result["pagesStarted"] = pages_started;
+	result["pagesFinished"] = pages_finished;
+	result["totalResources"] = total_resources;
+	result["totalErrors"] = total_errors;
+	result["firstProgress"] = first_progress.toVariantMap();
+	result["loadTime"] = load_time.toVariantMap();
+	return result;
+}
@@ -35,8 +35,17 @@
 */
 
 #pragma once
+#include <QtCore/QCache>
+#include <QtCore/QElapsedTimer>
+#include <QtCore/QList>
 #include <QtCore/QMap>
+#include <QtCore/QMutex>
+#include <QtCore/QPair>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QStringList>
+#include <QtCore/QTimer>
 #include "QAndroidOffscreenView.h"
+#include "QAndroidWebResourceResolver.h"
 
 class QAndroidOffscreenWebView
 	: public QAndroidOffscreenView
@@ -44,6 +53,39 @@ class QAndroidOffscreenWebView
 	Q_OBJECT
 	Q_PROPERTY(bool ignoreSslErrors READ getIgnoreSslErrors WRITE setIgnoreSslErrors)
 public:
+	/*!
+	 * Timeline of the latest page load and totals of all page loads since the last reset.
+	 * Times of the latest page are in milliseconds since onPageStarted(); -1 means
+	 * that the event hasn't happened yet.
+	 */
+	struct PageLoadStatistics
+	{
+		PageLoadStatistics(): first_progress_ms(-1), finished_ms(-1), resources(0), errors(0)
+			, pages_started(0), pages_finished(0), total_resources(0), total_errors(0) {}
+		QString toJson() const;
+		QVariantMap toVariantMap() const;
+
+		//! URL of the latest page.
+		QString url;
+		//! Time of the first onProgressChanged().
+		qint64 first_progress_ms;
+		//! Total load time (time of onPageFinished()).
+		qint64 finished_ms;
+		//! Number of onLoadResource() calls.
+		int resources;
+		//! Number of onReceivedError() and onReceivedSslError() calls.
+		int errors;
+		//! JSON of window.performance.timing, if requested (\see setNavigationTimingEnabled()).
+		QString navigation_timing;
+
+		qint64 pages_started;
+		qint64 pages_finished;
+		qint64 total_resources;
+		qint64 total_errors;
+		TimingCounter first_progress;
+		TimingCounter load_time;
+	};
+
 	QAndroidOffscreenWebView(const QString & object_name, const QSize & def_size, QObject * parent = 0);
 	virtual ~QAndroidOffscreenWebView();
 
@@ -53,6 +95,12 @@ public:
 	 */
 	static void preloadJavaClasses();
 
+	/*!
+	 * Loads about:blank, clears navigation history, resource resolvers, caches
+	 * and queued scripts, and restores default settings.
+	 */
+	virtual bool resetForReuse();
+
 	/*!
 	 * Start loading specified URL.
 	 */
@@ -60,7 +108,8 @@ public:
 
 	/*!
 	 * Start loading specified URL.
-	 * \param additionalHttpHeaders contains the additional headers. The headers should not contain '\n' symbols.
+	 * \param additionalHttpHeaders contains the additional headers. A few recently used header
+	 *  sets are cached on Java side, so loading more URLs with the same headers doesn't re-send them.
 	 */
 	bool loadUrl(const QString & url, const QMap<QString, QString> & additionalHttpHeaders);
 
@@ -74,6 +123,16 @@ public:
 	 */
 	bool loadDataWithBaseURL(const QString & baseUrl, const QString & data, const QString & mimeType= QLatin1String("text/html"), const QString & encoding = QString::null, const QString & historyUrl = QString::null);
 
+	/*!
+	 * Load a (large) document from memory without converting it into Java strings.
+	 * The document gets a synthetic URL and is served to WebView via request interception,
+	 * so WebView reads it in chunks directly from \a data. The data is shared, not copied,
+	 * and is kept until the next call so the page can be reloaded.
+	 * \param baseUrl - relative URLs in the document are resolved against it. If it is empty,
+	 *        a synthetic origin "http://offscreenwebview.invalid/" is used.
+	 */
+	bool loadStreamedData(const QByteArray & data, const QString & mimeType = QLatin1String("text/html"), const QString & encoding = QLatin1String("utf-8"), const QString & baseUrl = QString::null);
+
 	//! Will emit contentHeightReceived(int) after done.
 	bool requestContentHeight();
 
@@ -93,6 +152,54 @@ public:
 	void setIgnoreSslErrors(bool ignore) { ignore_ssl_errors_ = ignore; }
 	void setWebContentsDebuggingEnabled(bool enabled);
 
+	/*!
+	 * Add a resolver which can serve resources requested by the page from the application
+	 * (Qt resources, assets, disk cache...) instead of network. Resolvers are asked in
+	 * the order they have been added; if none of them has the resource, WebView loads it
+	 * as usual. The data is passed to WebView without copying it into Java heap.
+	 */
+	void addResourceResolver(const QSharedPointer<QAndroidWebResourceResolver> & resolver);
+	void clearResourceResolvers();
+
+	/*!
+	 * When the page is left, a 16-bit copy of its last frame is put into a snapshot cache
+	 * (keyed by URL), and when the page is started again (e.g. by goBack()) the copy is shown
+	 * until the page is finished, instead of blank content. The least recently used snapshots
+	 * are dropped to keep the cache within \a bytes; 0 disables the cache. Default is 8 MB.
+	 * \note Works in Bitmap mode only.
+	 */
+	void setSnapshotCacheBudget(int bytes);
+	int snapshotCacheBudget() const;
+	void clearSnapshotCache();
+
+	PageLoadStatistics pageLoadStatistics() const;
+	void resetPageLoadStatistics();
+
+	bool navigationTimingEnabled() const { return navigation_timing_enabled_; }
+
+	/*!
+	 * If enabled, window.performance.timing of each finished page is read via
+	 * evaluateJavascript() into PageLoadStatistics::navigation_timing. Off by default.
+	 */
+	void setNavigationTimingEnabled(bool enabled) { navigation_timing_enabled_ = enabled; }
+
+	/*!
+	 * Asynchronously evaluate JavaScript in the context of the current page.
+	 * The scripts evaluated during one iteration of the event loop are sent to Android
+	 * UI thread at once, and their results are delivered by one javascriptEvaluated()
+	 * signal when all of them are done. Each result is a JSON value as returned by
+	 * WebView.evaluateJavascript(); on Android < 4.4 the scripts are run via
+	 * "javascript:" URLs and the results are null strings.
+	 * \return ID of the request (> 0) which is passed to javascriptEvaluated(), or 0 on failure.
+	 */
+	int evaluateJavascript(const QString & script);
+
+public slots:
+	//! Send the queued scripts to Java immediately instead of waiting for the event loop.
+	void flushJavascript();
+
+public:
+
 	/*
 	Unimplemented WebView functions:
 
@@ -226,6 +333,15 @@ signals:
 
 	void progressChanged(int percent);
 
+	//! Results of a batch of evaluateJavascript() calls; ids and results have the same size.
+	void javascriptEvaluated(QList<int> ids, QStringList results);
+
+	//! Emitted when the statistics of a finished page are complete (including Navigation Timing, if enabled).
+	void pageLoadStatisticsReady();
+
+private slots:
+	void requestNavigationTiming();
+
 protected:
 	//
 	// WebViewClient functions.
@@ -264,6 +380,7 @@ protected:
 	friend Q_DECL_EXPORT void JNICALL Java_onTooManyRedirects(JNIEnv * env, jobject jo, jlong nativeptr, jobject cancelMsg, jobject continueMsg);
 	friend Q_DECL_EXPORT void JNICALL Java_onUnhandledKeyEvent(JNIEnv * env, jobject j, jlong nativeptr, jobject event);
 	friend Q_DECL_EXPORT jobject JNICALL Java_shouldInterceptRequest(JNIEnv * env, jobject jo, jlong nativeptr, jobject url);
+	friend Q_DECL_EXPORT void JNICALL Java_releaseResourceBuffer(JNIEnv * env, jclass cls, jlong holder);
 	friend Q_DECL_EXPORT jboolean JNICALL Java_shouldOverrideKeyEvent(JNIEnv * env, jobject jo, jlong nativeptr, jobject event);
 	friend Q_DECL_EXPORT jboolean JNICALL Java_shouldOverrideUrlLoading(JNIEnv * env, jobject jo, jlong nativeptr, jobject url);
 
@@ -286,13 +403,47 @@ protected:
 	virtual void onCanGoBackReceived(bool can);
 	virtual void onCanGoForwardReceived(bool can);
 	virtual void onCanGoBackOrForwardReceived(bool can, int steps);
+	virtual void onJavascriptResults(const QList<int> & ids, const QStringList & results);
 
 	friend Q_DECL_EXPORT void JNICALL Java_onContentHeightReceived(JNIEnv * env, jobject jo, jlong nativeptr, jint height);
 	friend Q_DECL_EXPORT void JNICALL Java_onCanGoBackReceived(JNIEnv * env, jobject jo, jlong nativeptr, jboolean can);
 	friend Q_DECL_EXPORT void JNICALL Java_onCanGoForwardReceived(JNIEnv * env, jobject jo, jlong nativeptr, jboolean can);
 	friend Q_DECL_EXPORT void JNICALL Java_onCanGoBackOrForwardReceived(JNIEnv * env, jobject jo, jlong nativeptr, jboolean can, jint steps);
+	friend Q_DECL_EXPORT void JNICALL Java_onJavascriptResults(JNIEnv * env, jobject jo, jlong nativeptr, jintArray ids, jobjectArray results);
+
 
+private:
+	//! Wrap the resource into Java WebResourceResponse; returns a local reference or 0.
+	jobject createResourceResponse(JNIEnv * env, jobject jo, const QAndroidWebResourceResolver::Resource & resource);
+	//! Save the snapshot of the current page and show the one of \a url, if any.
+	void switchPageSnapshot(const QString & url);
+	void countPageLoadError();
 
 private:
 	bool ignore_ssl_errors_;
+	QList< QSharedPointer<QAndroidWebResourceResolver> > resource_resolvers_;
+	QMutex resource_resolvers_mutex_;
+	//! Document of loadStreamedData(); protected by resource_resolvers_mutex_.
+	QString streamed_document_url_;
+	QAndroidWebResourceResolver::Resource streamed_document_;
+	int streamed_document_counter_;
+	int last_javascript_id_;
+	QList<int> pending_javascript_ids_;
+	QStringList pending_javascripts_;
+	QTimer javascript_flush_timer_;
+	//! Snapshots of the pages by URL; the cost is image size in bytes.
+	QCache<QString, QImage> snapshot_cache_;
+	//! URL of the page shown now, to store its snapshot when it is left.
+	QString snapshot_page_url_;
+	mutable QMutex snapshot_cache_mutex_;
+	//! Page load timeline; updated in Android UI thread, protected by page_load_mutex_.
+	PageLoadStatistics page_load_statistics_;
+	QElapsedTimer page_load_timer_;
+	bool page_loading_;
+	volatile bool navigation_timing_enabled_;
+	int navigation_timing_request_id_;
+	mutable QMutex page_load_mutex_;
+	//! Header sets of loadUrl() cached on Java side by id, the most recently used first.
+	QList< QPair<int, QMap<QString, QString> > > header_sets_;
+	int last_header_set_id_;
 };
@@ -0,0 +1,246 @@
+/*
+  Offscreen Android Views library for Qt
+
+  Author:
+  Sergey A. Galin <sergey.galin@gmail.com>
+
+  Distrbuted under The BSD License
+
+  Copyright (c) 2014, DoubleGIS, LLC.
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+  * Neither the name of the DoubleGIS, LLC nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS
+  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+  THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <QtCore/QCryptographicHash>
+#include <QtCore/QDebug>
+#include <QtCore/QDir>
+#include <QtCore/QFile>
+#include <QtCore/QFileInfo>
+#include <QtCore/QMutexLocker>
+#include <QtCore/QUrl>
+#include "QAndroidWebResourceResolver.h"
+
+QString QAndroidWebResourceResolver::mimeTypeForFileName(const QString & file_name)
+{
+	QString ext = QFileInfo(file_name).suffix().toLower();
+	if (ext == QLatin1String("html") || ext == QLatin1String("htm"))
+	{
+		return QLatin1String("text/html");
+	}
+	if (ext == QLatin1String("js"))
+	{
+		return QLatin1String("application/javascript");
+	}
+	if (ext == QLatin1String("css"))
+	{
+		return QLatin1String("text/css");
+	}
+	if (ext == QLatin1String("json"))
+	{
+		return QLatin1String("application/json");
+	}
+	if (ext == QLatin1String("png"))
+	{
+		return QLatin1String("image/png");
+	}
+	if (ext == QLatin1String("jpg") || ext == QLatin1String("jpeg"))
+	{
+		return QLatin1String("image/jpeg");
+	}
+	if (ext == QLatin1String("gif"))
+	{
+		return QLatin1String("image/gif");
+	}
+	if (ext == QLatin1String("webp"))
+	{
+		return QLatin1String("image/webp");
+	}
+	if (ext == QLatin1String("svg"))
+	{
+		return QLatin1String("image/svg+xml");
+	}
+	if (ext == QLatin1String("woff"))
+	{
+		return QLatin1String("font/woff");
+	}
+	if (ext == QLatin1String("ttf"))
+	{
+		return QLatin1String("font/ttf");
+	}
+	if (ext == QLatin1String("txt"))
+	{
+		return QLatin1String("text/plain");
+	}
+	return QLatin1String("application/octet-stream");
+}
+
+static bool readWholeFile(const QString & file_name, QByteArray & out_data)
+{
+	QFile file(file_name);
+	if (!file.open(QIODevice::ReadOnly))
+	{
+		return false;
+	}
+	out_data = file.readAll();
+	return true;
+}
+
+//! Write via a temporary file, so concurrent readers never see a partially written file.
+static bool writeWholeFile(const QString & file_name, const QByteArray & data)
+{
+	QString temp_name = file_name + QLatin1String(".tmp");
+	QFile file(temp_name);
+	if (!file.open(QIODevice::WriteOnly | QIODevice::Truncate))
+	{
+		qWarning()<<"Failed to write web resource cache file:"<<temp_name;
+		return false;
+	}
+	bool ok = file.write(data) == data.size();
+	file.close();
+	if (ok)
+	{
+		QFile::remove(file_name);
+		ok = QFile::rename(temp_name, file_name);
+	}
+	if (!ok)
+	{
+		QFile::remove(temp_name);
+	}
+	return ok;
+}
+
+static QByteArray hexHash(const QByteArray & data)
+{
+	return QCryptographicHash::hash(data, QCryptographicHash::Sha1).toHex();
+}
+
+
+QAndroidFileWebResourceResolver::QAndroidFileWebResourceResolver(const QString & url_prefix, const QString & path_prefix)
+	: url_prefix_(url_prefix)
+	, path_prefix_(path_prefix)
+{
+}
+
+bool QAndroidFileWebResourceResolver::resolve(const QString & url, Resource & out_resource)
+{
+	if (!url.startsWith(url_prefix_))
+	{
+		return false;
+	}
+	QString relative = url.mid(url_prefix_.length());
+	for (int i = 0; i < relative.length(); ++i)
+	{
+		if (relative.at(i) == QLatin1Char('?') || relative.at(i) == QLatin1Char('#'))
+		{
+			relative.truncate(i);
+			break;
+		}
+	}
+	relative = QUrl::fromPercentEncoding(relative.toUtf8());
+	// Don't let the page read files outside of path_prefix_
+	if (relative.isEmpty() || relative.split(QLatin1Char('/')).contains(QLatin1String("..")))
+	{
+		return false;
+	}
+	QString file_name = path_prefix_ + relative;
+	if (!readWholeFile(file_name, out_resource.data))
+	{
+		return false;
+	}
+	out_resource.mime_type = mimeTypeForFileName(file_name);
+	out_resource.encoding = QString();
+	return true;
+}
+
+
+QAndroidWebResourceDiskCache::QAndroidWebResourceDiskCache(const QString & directory)
+	: directory_(directory)
+	, mutex_()
+{
+	QDir dir(directory_);
+	dir.mkpath(QLatin1String("index"));
+	dir.mkpath(QLatin1String("data"));
+}
+
+QString QAndroidWebResourceDiskCache::indexFileName(const QString & url) const
+{
+	return directory_ + QLatin1String("/index/") + QString::fromLatin1(hexHash(url.toUtf8()));
+}
+
+QString QAndroidWebResourceDiskCache::dataFileName(const QByteArray & content_hash) const
+{
+	return directory_ + QLatin1String("/data/") + QString::fromLatin1(content_hash);
+}
+
+bool QAndroidWebResourceDiskCache::store(const QString & url, const Resource & resource)
+{
+	QByteArray content_hash = hexHash(resource.data);
+	QMutexLocker locker(&mutex_);
+	QString data_file = dataFileName(content_hash);
+	if (!QFile::exists(data_file) && !writeWholeFile(data_file, resource.data))
+	{
+		return false;
+	}
+	// Index file: content hash, MIME type and encoding, one per line.
+	QByteArray index = content_hash + '\n' + resource.mime_type.toUtf8() + '\n' + resource.encoding.toUtf8() + '\n';
+	return writeWholeFile(indexFileName(url), index);
+}
+
+bool QAndroidWebResourceDiskCache::contains(const QString & url) const
+{
+	QMutexLocker locker(&mutex_);
+	return QFile::exists(indexFileName(url));
+}
+
+void QAndroidWebResourceDiskCache::remove(const QString & url)
+{
+	// Data files may be shared by several URLs, so they are kept.
+	QMutexLocker locker(&mutex_);
+	QFile::remove(indexFileName(url));
+}
+
+bool QAndroidWebResourceDiskCache::resolve(const QString & url, Resource & out_resource)
+{
+	QMutexLocker locker(&mutex_);
+	QByteArray index;
+	if (!readWholeFile(indexFileName(url), index))
+	{
+		return false;
+	}
+	QList<QByteArray> fields = index.split('\n');
+	if (fields.size() < 3 || fields.at(0).isEmpty())
+	{
+		qWarning()<<"Broken web resource cache index for:"<<url;
+		return false;
+	}
+	if (!readWholeFile(dataFileName(fields.at(0)), out_resource.data))
+	{
+		return false;
+	}
+	out_resource.mime_type = QString::fromUtf8(fields.at(1));
+	out_resource.encoding = QString::fromUtf8(fields.at(2));
+	return true;
+}
@@ -0,0 +1,109 @@
+/*
+  Offscreen Android Views library for Qt
+
+  Author:
+  Sergey A. Galin <sergey.galin@gmail.com>
+
+  Distrbuted under The BSD License
+
+  Copyright (c) 2014, DoubleGIS, LLC.
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+  * Neither the name of the DoubleGIS, LLC nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS
+  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+  THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include <QtCore/QByteArray>
+#include <QtCore/QMutex>
+#include <QtCore/QString>
+
+/*!
+ * Provides content for the resources requested by QAndroidOffscreenWebView, so they
+ * are served from the application instead of network (\see QAndroidOffscreenWebView::addResourceResolver()).
+ * \note resolve() is called in a WebView's own thread (not Qt GUI thread and not
+ * Android UI thread), so implementations must be thread-safe.
+ */
+class QAndroidWebResourceResolver
+{
+public:
+	struct Resource
+	{
+		QByteArray data;
+		//! If empty, "application/octet-stream" is used.
+		QString mime_type;
+		//! Charset for text data; may be empty.
+		QString encoding;
+	};
+
+	virtual ~QAndroidWebResourceResolver() {}
+
+	//! Return true and fill \a out_resource if the resolver has content for \a url.
+	virtual bool resolve(const QString & url, Resource & out_resource) = 0;
+
+	//! Guess MIME type of a web resource by its file name extension.
+	static QString mimeTypeForFileName(const QString & file_name);
+};
+
+/*!
+ * Serves URLs which start with \a url_prefix by files with the rest of the URL
+ * appended to \a path_prefix, e.g. "http://local/" => ":/web/" for Qt resources
+ * or "http://local/" => "assets:/web/" for Android assets.
+ */
+class QAndroidFileWebResourceResolver: public QAndroidWebResourceResolver
+{
+public:
+	QAndroidFileWebResourceResolver(const QString & url_prefix, const QString & path_prefix);
+	virtual bool resolve(const QString & url, Resource & out_resource);
+
+private:
+	const QString url_prefix_;
+	const QString path_prefix_;
+};
+
+/*!
+ * On-disk cache of web resources. Data is stored in files named by the hash
+ * of their content, so e.g. a shared JS or CSS file stored for several URLs
+ * takes space only once. URLs are mapped to the data by small index files.
+ * The cache is filled by store(); it never goes to network by itself.
+ */
+class QAndroidWebResourceDiskCache: public QAndroidWebResourceResolver
+{
+public:
+	explicit QAndroidWebResourceDiskCache(const QString & directory);
+
+	//! Save \a resource to be served for \a url.
+	bool store(const QString & url, const Resource & resource);
+	bool contains(const QString & url) const;
+	void remove(const QString & url);
+
+	virtual bool resolve(const QString & url, Resource & out_resource);
+
+private:
+	QString indexFileName(const QString & url) const;
+	QString dataFileName(const QByteArray & content_hash) const;
+
+	const QString directory_;
+	mutable QMutex mutex_;
+};
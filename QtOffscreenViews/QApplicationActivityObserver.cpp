@@ -81,6 +81,12 @@ void QApplicationActivityObserver::setApplicationActive(bool active)
 	}
 }
 
+void QApplicationActivityObserver::trimMemory(int level)
+{
+	qDebug()<<"QApplicationActivityObserver::trimMemory"<<level;
+	QMetaObject::invokeMethod(this, "memoryTrimRequested", Qt::QueuedConnection, Q_ARG(int, level));
+}
+
 bool QApplicationActivityObserver::eventFilter(QObject * obj, QEvent * evnt)
 {
 	if (evnt->type() == QEvent::ApplicationActivate)
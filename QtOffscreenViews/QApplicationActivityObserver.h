@@ -53,6 +53,18 @@ private:
 	QApplicationActivityObserver(): is_active_(true) {}
 
 public:
+	//! Levels of Android ComponentCallbacks2.onTrimMemory().
+	enum TrimMemoryLevel
+	{
+		TrimMemoryRunningModerate = 5,
+		TrimMemoryRunningLow = 10,
+		TrimMemoryRunningCritical = 15,
+		TrimMemoryUiHidden = 20,
+		TrimMemoryBackground = 40,
+		TrimMemoryModerate = 60,
+		TrimMemoryComplete = 80
+	};
+
 	/*!
 	 * Makes sure QApplicationActivityObserver instance exists, attemps to
 	 * install a QCoreApplication event filter if necessary, then returns
@@ -62,6 +74,12 @@ public:
 
 	bool isApplicationActive() const { return is_active_; }
 
+	/*!
+	 * Pass Android onTrimMemory() level to the observer; memoryTrimRequested() is
+	 * emitted in the thread of the observer. Can be called from any thread.
+	 */
+	void trimMemory(int level);
+
 private slots:
 	/*!
 	 * Sets current application activity status and emits applicationActiveStateChanged().
@@ -76,6 +94,12 @@ signals:
 	 */
 	void applicationActiveStateChanged();
 
+	/*!
+	 * Android asks the application to release memory it can live without.
+	 * \param level - one of TrimMemoryLevel values (higher is more urgent).
+	 */
+	void memoryTrimRequested(int level);
+
 protected:
 	bool eventFilter(QObject * obj, QEvent * event);
 
@@ -34,6 +34,7 @@
   THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <QStyleOptionGraphicsItem>
 #include "QAndroidOffscreenViewGraphicsWidget.h"
 
 QAndroidOffscreenViewGraphicsWidget::QAndroidOffscreenViewGraphicsWidget(QAndroidOffscreenView * view, bool interactive, QGraphicsItem *parent, Qt::WindowFlags wFlags)
@@ -48,7 +49,9 @@ QAndroidOffscreenViewGraphicsWidget::QAndroidOffscreenViewGraphicsWidget(QAndroi
 	setAcceptedMouseButtons(Qt::LeftButton);
 	setFocusPolicy(Qt::StrongFocus);
 	setFlag(QGraphicsItem::ItemSendsScenePositionChanges);
-	connect(aview_.data(), SIGNAL(updated()), this, SLOT(onOffscreenUpdated()));
+	// We need option->exposedRect in paint() to copy only the changed part of the bitmap
+	setFlag(QGraphicsItem::ItemUsesExtendedStyleOption);
+	connect(aview_.data(), SIGNAL(updated(QRect)), this, SLOT(onOffscreenUpdated(QRect)));
 }
 
 QAndroidOffscreenViewGraphicsWidget::~QAndroidOffscreenViewGraphicsWidget()
@@ -68,15 +71,21 @@ void QAndroidOffscreenViewGraphicsWidget::setEnabled(bool enabled)
 	QGraphicsWidget::setEnabled(enabled);
 }
 
-void QAndroidOffscreenViewGraphicsWidget::onOffscreenUpdated()
+void QAndroidOffscreenViewGraphicsWidget::onOffscreenUpdated(const QRect & dirty_rect)
 {
-	// qDebug()<<__PRETTY_FUNCTION__<<<<aview_->viewObjectName();
-	update();
+	// qDebug()<<__PRETTY_FUNCTION__<<<<aview_->viewObjectName()<<dirty_rect;
+	if (dirty_rect.isEmpty())
+	{
+		update();
+	}
+	else
+	{
+		update(QRectF(dirty_rect));
+	}
 }
 
 void QAndroidOffscreenViewGraphicsWidget::paint(QPainter * painter, const QStyleOptionGraphicsItem * option, QWidget * widget)
 {
-	Q_UNUSED(option);
 	Q_UNUSED(widget);
 	bool use_gl = painter->paintEngine()->type() == QPaintEngine::OpenGL2;
 
@@ -156,7 +165,12 @@ void QAndroidOffscreenViewGraphicsWidget::paint(QPainter * painter, const QStyle
 		const QImage * buffer = aview_->getBitmapBuffer();
 		if (buffer)
 		{
-			painter->drawImage(0, 0, *buffer);
+			// Only the exposed part of the bitmap is read
+			QRectF area = option->exposedRect & QRectF(buffer->rect());
+			if (!area.isEmpty())
+			{
+				painter->drawImage(area, *buffer, area);
+			}
 		}
 		else
 		{
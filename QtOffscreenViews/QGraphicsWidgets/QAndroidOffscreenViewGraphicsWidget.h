@@ -49,6 +49,8 @@ class QAndroidOffscreenViewGraphicsWidget
 	: public QGraphicsWidget
 {
 	Q_OBJECT
+	//! Max number of frames per second painted by the Android View; 0 (default) means no limit.
+	Q_PROPERTY(int maxUpdateRate READ maxUpdateRate WRITE setMaxUpdateRate)
 public:
 	QAndroidOffscreenViewGraphicsWidget(QAndroidOffscreenView * view, bool interactive, QGraphicsItem *parent = 0, Qt::WindowFlags wFlags = 0);
 	virtual ~QAndroidOffscreenViewGraphicsWidget();
@@ -56,6 +58,9 @@ public:
 	virtual void setVisible(bool visible);
 	virtual void setEnabled(bool enabled);
 
+	int maxUpdateRate() const { return aview_->maxUpdateRate(); }
+	void setMaxUpdateRate(int fps) { aview_->setMaxUpdateRate(fps); }
+
 	QAndroidOffscreenView * androidOffscreenView() { return aview_.data(); }
 	const QAndroidOffscreenView * androidOffscreenView() const { return aview_.data(); }
 
@@ -74,7 +79,7 @@ protected:
 	void updateViewPosition();
 
 private slots:
-	void onOffscreenUpdated();
+	void onOffscreenUpdated(const QRect & dirty_rect);
 
 private:
 	QScopedPointer<QAndroidOffscreenView> aview_;
@@ -0,0 +1,253 @@
+/*
+  Offscreen Android Views library for Qt
+
+  Author:
+  Sergey A. Galin <sergey.galin@gmail.com>
+
+  Distrbuted under The BSD License
+
+  Copyright (c) 2014, DoubleGIS, LLC.
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+  * Neither the name of the DoubleGIS, LLC nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS
+  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+  THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#include <QtCore/QDebug>
+#include "QOpenGLTextureHolder.h"
+#include "QOpenGLTextureAtlas.h"
+
+// Page size is limited by GL_MAX_TEXTURE_SIZE. The page is wide enough to keep a full-width
+// text field of a high-res phone screen, 4 MB for 32-bit pixels.
+static const int c_page_width = 2048;
+static const int c_page_height = 512;
+
+// Slots are separated by a gutter. Its texels are undefined (never written), so the holders
+// also inset texture coordinates by half a texel to keep linear filtering inside the slot.
+static const int c_gutter = 1;
+
+// Shelf height is rounded up to this, so the shelves can be reused for slightly different heights.
+static const int c_shelf_granularity = 8;
+
+QList<QWeakPointer<QOpenGLTextureAtlas> > QOpenGLTextureAtlas::pages_;
+
+static QSize pageSize()
+{
+	static QSize size;
+	if (size.isEmpty())
+	{
+		GLint max_size = 0;
+		glGetIntegerv(GL_MAX_TEXTURE_SIZE, &max_size);
+		size = QSize(qMin(c_page_width, int(max_size)), qMin(c_page_height, int(max_size)));
+	}
+	return size;
+}
+
+QOpenGLTextureAtlas::QOpenGLTextureAtlas(const QSize & size, GLenum format, GLenum pixel_type)
+	: texture_id_(0)
+	, size_(size)
+	, format_(format)
+	, pixel_type_(pixel_type)
+	, used_height_(0)
+	, slot_count_(0)
+{
+	qDebug()<<"Creating texture atlas page"<<size<<"format:"<<format<<"pixel type:"<<pixel_type;
+	glGenTextures(1, &texture_id_);
+	glBindTexture(GL_TEXTURE_2D, texture_id_);
+	glTexImage2D(GL_TEXTURE_2D, 0, static_cast<GLint>(format), size.width(), size.height(), 0, format, pixel_type, 0);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+	glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+	glBindTexture(GL_TEXTURE_2D, 0);
+}
+
+QOpenGLTextureAtlas::~QOpenGLTextureAtlas()
+{
+	qDebug()<<"Deleting texture atlas page"<<size_;
+	// Deleted together with the other orphaned textures (\see QOpenGLTextureHolder::deleteOrphanedTextures()).
+	QOpenGLTextureHolder::deleteTextureLater(texture_id_);
+}
+
+QSize QOpenGLTextureAtlas::maxSlotSize()
+{
+	QSize size = pageSize();
+	return QSize(size.width() - c_gutter, size.height() / 2 - c_gutter);
+}
+
+QSharedPointer<QOpenGLTextureAtlas> QOpenGLTextureAtlas::allocate(const QSize & size, GLenum format, GLenum pixel_type, QRect * out_rect)
+{
+	QSize max_size = maxSlotSize();
+	if (size.isEmpty() || size.width() > max_size.width() || size.height() > max_size.height())
+	{
+		return QSharedPointer<QOpenGLTextureAtlas>();
+	}
+	for (int i = 0; i < pages_.size(); )
+	{
+		QSharedPointer<QOpenGLTextureAtlas> page = pages_.at(i).toStrongRef();
+		if (page.isNull())
+		{
+			pages_.removeAt(i);
+			continue;
+		}
+		if (page->format_ == format && page->pixel_type_ == pixel_type && page->allocateSlot(size, out_rect))
+		{
+			return page;
+		}
+		++i;
+	}
+	QSharedPointer<QOpenGLTextureAtlas> page(new QOpenGLTextureAtlas(pageSize(), format, pixel_type));
+	if (!page->allocateSlot(size, out_rect))
+	{
+		return QSharedPointer<QOpenGLTextureAtlas>();
+	}
+	pages_.append(page.toWeakRef());
+	return page;
+}
+
+bool QOpenGLTextureAtlas::allocateSlot(const QSize & size, QRect * out_rect)
+{
+	const int width = size.width() + c_gutter;
+	const int height = size.height() + c_gutter;
+
+	// Don't put small items on much taller shelves to not waste the space.
+	for (int i = 0; i < shelves_.size(); ++i)
+	{
+		Shelf & shelf = shelves_[i];
+		if (shelf.height < height || shelf.height > height * 2)
+		{
+			continue;
+		}
+		for (int s = 0; s < shelf.free_slots.size(); ++s)
+		{
+			QRect slot = shelf.free_slots.at(s);
+			if (slot.width() >= width)
+			{
+				if (slot.width() > width)
+				{
+					shelf.free_slots[s] = QRect(slot.x() + width, slot.y(), slot.width() - width, slot.height());
+				}
+				else
+				{
+					shelf.free_slots.removeAt(s);
+				}
+				*out_rect = QRect(QPoint(slot.x(), shelf.y), size);
+				slot_count_++;
+				return true;
+			}
+		}
+		if (shelf.used_width + width <= size_.width())
+		{
+			*out_rect = QRect(QPoint(shelf.used_width, shelf.y), size);
+			shelf.used_width += width;
+			slot_count_++;
+			return true;
+		}
+	}
+
+	int shelf_height = ((height + c_shelf_granularity - 1) / c_shelf_granularity) * c_shelf_granularity;
+	if (used_height_ + shelf_height > size_.height())
+	{
+		shelf_height = height;
+		if (used_height_ + shelf_height > size_.height())
+		{
+			return false;
+		}
+	}
+	Shelf shelf(used_height_, shelf_height);
+	shelf.used_width = width;
+	shelves_.append(shelf);
+	used_height_ += shelf_height;
+	*out_rect = QRect(QPoint(0, shelf.y), size);
+	slot_count_++;
+	return true;
+}
+
+void QOpenGLTextureAtlas::release(const QRect & rect)
+{
+	for (int i = 0; i < shelves_.size(); ++i)
+	{
+		Shelf & shelf = shelves_[i];
+		if (shelf.y != rect.y())
+		{
+			continue;
+		}
+		QRect slot(rect.x(), shelf.y, rect.width() + c_gutter, shelf.height);
+		if (slot.x() + slot.width() == shelf.used_width)
+		{
+			// The last slot of the shelf: move the edge back, also over free slots before it.
+			shelf.used_width = slot.x();
+			bool merged = true;
+			while (merged)
+			{
+				merged = false;
+				for (int s = 0; s < shelf.free_slots.size(); ++s)
+				{
+					if (shelf.free_slots.at(s).x() + shelf.free_slots.at(s).width() == shelf.used_width)
+					{
+						shelf.used_width = shelf.free_slots.at(s).x();
+						shelf.free_slots.removeAt(s);
+						merged = true;
+						break;
+					}
+				}
+			}
+		}
+		else
+		{
+			shelf.free_slots.append(slot);
+		}
+		// Empty shelves at the bottom are given back so they can be re-created with another height.
+		while (!shelves_.isEmpty() && shelves_.last().used_width == 0)
+		{
+			used_height_ -= shelves_.last().height;
+			shelves_.removeLast();
+		}
+		slot_count_--;
+		return;
+	}
+	qWarning()<<"QOpenGLTextureAtlas: releasing unknown slot"<<rect;
+}
+
+void QOpenGLTextureAtlas::upload(const QRect & rect, const uchar * bits, int bytes_per_line, int first_line, int lines)
+{
+	if (lines <= 0 || first_line < 0 || first_line + lines > rect.height())
+	{
+		return;
+	}
+	// 16-bit lines may be aligned to 2 bytes only
+	GLint alignment = ((bytes_per_line % 4) == 0)? 4: 2;
+	if (alignment != 4)
+	{
+		glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+	}
+	glBindTexture(GL_TEXTURE_2D, texture_id_);
+	glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x(), rect.y() + first_line, rect.width(), lines,
+		format_, pixel_type_, bits + first_line * bytes_per_line);
+	glBindTexture(GL_TEXTURE_2D, 0);
+	if (alignment != 4)
+	{
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	}
+}
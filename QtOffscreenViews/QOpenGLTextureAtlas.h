@@ -0,0 +1,109 @@
+/*
+  Offscreen Android Views library for Qt
+
+  Author:
+  Sergey A. Galin <sergey.galin@gmail.com>
+
+  Distrbuted under The BSD License
+
+  Copyright (c) 2014, DoubleGIS, LLC.
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+  * Neither the name of the DoubleGIS, LLC nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS
+  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+  THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+#pragma once
+#include <GLES2/gl2.h>
+#include <QtCore/QList>
+#include <QtCore/QRect>
+#include <QtCore/QSharedPointer>
+#include <QtCore/QWeakPointer>
+
+/*!
+ * A page of a texture atlas: one GL_TEXTURE_2D which is shared by several
+ * QOpenGLTextureHolder's, each of them occupying a sub-rectangle (slot) of it.
+ * Slots are allocated by "shelves": rows of slots of similar height.
+ * Pages are created on demand and deleted when the last slot is released.
+ * \note All functions should be called with the correct OpenGL context.
+ */
+class QOpenGLTextureAtlas
+{
+public:
+	~QOpenGLTextureAtlas();
+
+	/*!
+	 * Allocate a slot of the given size in one of the atlas pages for the given
+	 * pixel format, creating a new page if necessary.
+	 * \return the page or null pointer if the size is too big for the atlas.
+	 */
+	static QSharedPointer<QOpenGLTextureAtlas> allocate(const QSize & size, GLenum format, GLenum pixel_type, QRect * out_rect);
+
+	//! Max size of a slot; larger images should use their own textures.
+	static QSize maxSlotSize();
+
+	//! Return the slot allocated by allocate() back to the page.
+	void release(const QRect & rect);
+
+	/*!
+	 * Load lines [first_line, first_line + lines) of an image into the slot.
+	 * The data must be in the page format and lines must be exactly rect.width() pixels long
+	 * (GL ES 2 can't skip the padding).
+	 */
+	void upload(const QRect & rect, const uchar * bits, int bytes_per_line, int first_line, int lines);
+
+	GLuint texture() const { return texture_id_; }
+	const QSize & size() const { return size_; }
+	GLenum format() const { return format_; }
+	GLenum pixelType() const { return pixel_type_; }
+	int slotCount() const { return slot_count_; }
+
+private:
+	QOpenGLTextureAtlas(const QSize & size, GLenum format, GLenum pixel_type);
+	bool allocateSlot(const QSize & size, QRect * out_rect);
+
+	struct Shelf
+	{
+		Shelf(int y, int height): y(y), height(height), used_width(0) {}
+		int y;
+		int height;
+		//! All slots of the shelf are to the left of this.
+		int used_width;
+		//! Released slots in the middle of the shelf (full shelf height).
+		QList<QRect> free_slots;
+	};
+
+	GLuint texture_id_;
+	QSize size_;
+	GLenum format_;
+	GLenum pixel_type_;
+	QList<Shelf> shelves_;
+	int used_height_;
+	int slot_count_;
+
+	static QList<QWeakPointer<QOpenGLTextureAtlas> > pages_;
+
+private:
+	Q_DISABLE_COPY(QOpenGLTextureAtlas)
+};
@@ -36,6 +36,7 @@
 
 #include <GLES2/gl2.h>
 #include <GLES2/gl2ext.h>
+#include <QtCore/QVector>
 #include <QtOpenGL/QGLWidget>
 #include "QOpenGLTextureHolder.h"
 
@@ -43,6 +44,11 @@ static const GLuint c_vertex_coordinates_attr  = 0;
 static const GLuint c_texture_coordinates_attr = 1;
 
 QMap<GLenum, QSharedPointer<QGLShaderProgram> > QOpenGLTextureHolder::blit_programs_;
+GLuint QOpenGLTextureHolder::blit_vertex_buffer_ = 0;
+QOpenGLTextureHolder::BlitStatistics QOpenGLTextureHolder::blit_statistics_;
+QMutex QOpenGLTextureHolder::orphaned_textures_mutex_;
+QVector<GLuint> QOpenGLTextureHolder::orphaned_textures_;
+QVector<QOpenGLTextureHolder::AtlasSlot> QOpenGLTextureHolder::orphaned_atlas_slots_;
 
 QOpenGLTextureHolder::QOpenGLTextureHolder(GLenum type, const QSize & size)
 	: texture_id_(0)
@@ -51,6 +57,9 @@ QOpenGLTextureHolder::QOpenGLTextureHolder(GLenum type, const QSize & size)
 	, a11_(1.0f), a12_(0)
 	, a21_(0), a22_(1.0f)
 	, b1_(0), b2_(0)
+	, uploaded_size_()
+	, uploaded_format_(0)
+	, uploaded_pixel_type_(0)
 {
 	Q_ASSERT(type == GL_TEXTURE_EXTERNAL_OES || type == GL_TEXTURE_2D);
 	allocateTexture();
@@ -61,6 +70,9 @@ QOpenGLTextureHolder::QOpenGLTextureHolder()
 	, texture_type_(GL_TEXTURE_2D)
 	, texture_size_(64, 64)
 	, a11_(1.0f), a12_(0), a21_(0), a22_(1.0f), b1_(0), b2_(0)
+	, uploaded_size_()
+	, uploaded_format_(0)
+	, uploaded_pixel_type_(0)
 {
 }
 
@@ -71,17 +83,77 @@ QOpenGLTextureHolder::~QOpenGLTextureHolder()
 
 void QOpenGLTextureHolder::deallocateTexture()
 {
-	if (texture_id_ != 0)
+	if (atlas_)
+	{
+		atlas_->release(atlas_rect_);
+		atlas_.clear();
+		atlas_rect_ = QRect();
+		texture_id_ = 0;
+	}
+	else if (texture_id_ != 0)
 	{
 		glDeleteTextures(1, &texture_id_);
 		texture_id_ = 0;
 	}
+	uploaded_size_ = QSize();
+	uploaded_format_ = 0;
+	uploaded_pixel_type_ = 0;
 	setTransformation(
 		1.0f, 0.0f,
 		0.0f, 1.0f,
 		0, 0);
 }
 
+void QOpenGLTextureHolder::deallocateTextureLater()
+{
+	if (atlas_)
+	{
+		// The page is shared with holders used in GL thread, so the slot is released there, too.
+		QMutexLocker locker(&orphaned_textures_mutex_);
+		orphaned_atlas_slots_.append(AtlasSlot(atlas_, atlas_rect_));
+		atlas_.clear();
+		atlas_rect_ = QRect();
+		texture_id_ = 0;
+	}
+	else if (texture_id_ != 0)
+	{
+		deleteTextureLater(texture_id_);
+		texture_id_ = 0;
+	}
+	deallocateTexture();
+}
+
+void QOpenGLTextureHolder::deleteTextureLater(GLuint texture_id)
+{
+	if (texture_id != 0)
+	{
+		QMutexLocker locker(&orphaned_textures_mutex_);
+		orphaned_textures_.append(texture_id);
+	}
+}
+
+void QOpenGLTextureHolder::deleteOrphanedTextures()
+{
+	QVector<AtlasSlot> released_slots;
+	{
+		QMutexLocker locker(&orphaned_textures_mutex_);
+		released_slots.swap(orphaned_atlas_slots_);
+	}
+	// (Without the lock: a page released for the last time calls deleteTextureLater().)
+	for (int i = 0; i < released_slots.size(); ++i)
+	{
+		released_slots.at(i).first->release(released_slots.at(i).second);
+	}
+	released_slots.clear();
+
+	QMutexLocker locker(&orphaned_textures_mutex_);
+	if (!orphaned_textures_.isEmpty())
+	{
+		glDeleteTextures(orphaned_textures_.size(), orphaned_textures_.constData());
+		orphaned_textures_.clear();
+	}
+}
+
 static inline void QRectFToVertexArray(const QRectF & r, GLfloat * array)
 {
 	qreal left = r.left();
@@ -191,11 +263,18 @@ QGLShaderProgram * QOpenGLTextureHolder::GetBlitProgram(GLenum target)
 
 		blit_program_ptr->link();
 
+		// The sampler always reads from unit 0, so the uniform is set only once.
+		if (blit_program_ptr->isLinked() && blit_program_ptr->bind())
+		{
+			blit_program_ptr->setUniformValue("imageTexture", 0 /*QT_IMAGE_TEXTURE_UNIT*/);
+			blit_program_ptr->release();
+		}
+
 		return blit_program_ptr.data();
 	#endif // ES 2.0
 }
 
-void QOpenGLTextureHolder::blitTexture(const QRect & targetRect, const QRect & sourceRect, bool reverse_y)
+void QOpenGLTextureHolder::blitTexture(const QRect & targetRect, const QRect & sourceRect, bool reverse_y) const
 {
 	if (!isAllocated())
 	{
@@ -225,7 +304,8 @@ void QOpenGLTextureHolder::blitTexture(const QRect & targetRect, const QRect & s
 			qWarning()<<"Failed to bind shader program, can't blit the texture.";
 			return;
 		}
-		blitProgram->setUniformValue("imageTexture", 0 /*QT_IMAGE_TEXTURE_UNIT*/);
+		blit_statistics_.program_binds++;
+		blit_statistics_.gl_calls += 4; // 3 x glDisable + glUseProgram
 
 		// The shader manager's blit program does not multiply the
 		// vertices by the pmv matrix, so we need to do the effect
@@ -253,6 +333,7 @@ void QOpenGLTextureHolder::blitTexture(const QRect & targetRect, const QRect & s
 		}
 		drawTexture(r, sourceRect, reverse_y);
 		blitProgram->release();
+		blit_statistics_.gl_calls++;
 	#else
 		glBindTexture(texture_type_, texture_id_);
 		// (In OpenGL coordinates Y is reversed)
@@ -274,14 +355,8 @@ void QOpenGLTextureHolder::blitTexture(const QRect & targetRect, const QRect & s
 	#endif
 }
 
-void QOpenGLTextureHolder::drawTexture(const QRectF & rect, const QRectF & bitmap_rect, bool reverse_y)
+void QOpenGLTextureHolder::textureCoordinates(const QRectF & bitmap_rect, bool reverse_y, GLfloat * texCoordArray) const
 {
-	if (!isAllocated())
-	{
-		qWarning()<<"Attempt to draw an unallocated texture!";
-		return;
-	}
-
 	// src - source rectangle (in the texture)
 	QRectF src = bitmap_rect.isEmpty()
 		// Source region not specified, will use whole texture
@@ -303,8 +378,6 @@ void QOpenGLTextureHolder::drawTexture(const QRectF & rect, const QRectF & bitma
 	GLfloat ty1 = src.top() / height;
 	GLfloat ty2 = src.bottom() / height;
 
-	GLfloat texCoordArray[4*2];
-
 	// Apply texture transformation. This basically reverses Y axis on all
 	// tested Android devices, but who knows if it is always that simple or not?
 	GLfloat tx1m = a11_ * tx1 + a12_ * ty1 + b1_;
@@ -326,6 +399,18 @@ void QOpenGLTextureHolder::drawTexture(const QRectF & rect, const QRectF & bitma
 	texCoordArray[5] = ty1m;
 	texCoordArray[6] = tx1m;
 	texCoordArray[7] = ty1m;
+}
+
+void QOpenGLTextureHolder::drawTexture(const QRectF & rect, const QRectF & bitmap_rect, bool reverse_y) const
+{
+	if (!isAllocated())
+	{
+		qWarning()<<"Attempt to draw an unallocated texture!";
+		return;
+	}
+
+	GLfloat texCoordArray[4*2];
+	textureCoordinates(bitmap_rect, reverse_y, texCoordArray);
 
 	// Put the rectangle coordinates into the vertex array for GL.
 	GLfloat vertexArray[4*2];
@@ -360,9 +445,162 @@ void QOpenGLTextureHolder::drawTexture(const QRectF & rect, const QRectF & bitma
 		glDisableVertexAttribArray(c_vertex_coordinates_attr);
 		glDisableVertexAttribArray(c_texture_coordinates_attr);
 		glBindTexture(texture_type_, 0);
+		blit_statistics_.texture_binds++;
+		blit_statistics_.draw_calls++;
+		blit_statistics_.gl_calls += 9;
 	#endif
 }
 
+void QOpenGLTextureHolder::blitTextures(const QSize & viewport_size, const QList<BlitItem> & items)
+{
+	deleteOrphanedTextures();
+	if (items.isEmpty() || viewport_size.isEmpty())
+	{
+		return;
+	}
+
+	#if !defined(QT_OPENGL_ES_2)
+		for (int i = 0; i < items.size(); ++i)
+		{
+			const BlitItem & item = items.at(i);
+			if (item.holder)
+			{
+				glViewport(item.target_rect.x(), item.target_rect.y(), item.target_rect.width(), item.target_rect.height());
+				item.holder->blitTexture(
+					QRect(QPoint(0, 0), item.target_rect.size()), item.source_rect, item.reverse_y);
+			}
+		}
+		glViewport(0, 0, viewport_size.width(), viewport_size.height());
+	#else
+		// Interleaved vertex data: 6 vertices (2 triangles) per quad, each vertex has
+		// 2 position and 2 texture coordinates. All quads go into one shared buffer.
+		static const int c_floats_per_vertex = 4;
+		static const int c_vertices_per_quad = 6;
+		static const int c_fan_to_triangles[c_vertices_per_quad] = {0, 1, 2, 0, 2, 3};
+
+		// Sort the items by texture type, so each shader program is bound only once.
+		QList<GLenum> types;
+		QVector<GLfloat> vertices;
+		QVector<const BlitItem *> quads;
+		vertices.reserve(items.size() * c_vertices_per_quad * c_floats_per_vertex);
+		quads.reserve(items.size());
+		for (int i = 0; i < items.size(); ++i)
+		{
+			const BlitItem & item = items.at(i);
+			if (!item.holder || !item.holder->isAllocated() || item.target_rect.isEmpty())
+			{
+				continue;
+			}
+			if (!types.contains(item.holder->getTextureType()))
+			{
+				types.append(item.holder->getTextureType());
+			}
+		}
+		QList<int> first_quad_of_type;
+		for (int t = 0; t < types.size(); ++t)
+		{
+			first_quad_of_type.append(quads.size());
+			for (int i = 0; i < items.size(); ++i)
+			{
+				const BlitItem & item = items.at(i);
+				if (!item.holder || !item.holder->isAllocated() || item.target_rect.isEmpty()
+					|| item.holder->getTextureType() != types.at(t))
+				{
+					continue;
+				}
+
+				// Target rectangle in window GL coordinates => normalized device coordinates.
+				// As in blitTexture(), rect's "top" is the upper edge on screen.
+				qreal vw = static_cast<qreal>(viewport_size.width());
+				qreal vh = static_cast<qreal>(viewport_size.height());
+				QRectF r;
+				r.setLeft((static_cast<qreal>(item.target_rect.x()) / vw) * 2.0f - 1.0f);
+				r.setRight((static_cast<qreal>(item.target_rect.x() + item.target_rect.width()) / vw) * 2.0f - 1.0f);
+				r.setBottom((static_cast<qreal>(item.target_rect.y()) / vh) * 2.0f - 1.0f);
+				r.setTop((static_cast<qreal>(item.target_rect.y() + item.target_rect.height()) / vh) * 2.0f - 1.0f);
+
+				GLfloat vertexArray[4*2];
+				GLfloat texCoordArray[4*2];
+				QRectFToVertexArray(r, vertexArray);
+				item.holder->textureCoordinates(item.source_rect, item.reverse_y, texCoordArray);
+				for (int v = 0; v < c_vertices_per_quad; ++v)
+				{
+					int corner = c_fan_to_triangles[v];
+					vertices.append(vertexArray[corner * 2]);
+					vertices.append(vertexArray[corner * 2 + 1]);
+					vertices.append(texCoordArray[corner * 2]);
+					vertices.append(texCoordArray[corner * 2 + 1]);
+				}
+				quads.append(&item);
+			}
+		}
+		first_quad_of_type.append(quads.size());
+		if (quads.isEmpty())
+		{
+			return;
+		}
+
+		glDisable(GL_STENCIL_TEST);
+		glDisable(GL_DEPTH_TEST);
+		glDisable(GL_BLEND);
+
+		if (!blit_vertex_buffer_)
+		{
+			glGenBuffers(1, &blit_vertex_buffer_);
+			blit_statistics_.gl_calls++;
+		}
+		glBindBuffer(GL_ARRAY_BUFFER, blit_vertex_buffer_);
+		glBufferData(GL_ARRAY_BUFFER, vertices.size() * sizeof(GLfloat), vertices.constData(), GL_STREAM_DRAW);
+		const GLsizei stride = c_floats_per_vertex * sizeof(GLfloat);
+		glVertexAttribPointer(c_vertex_coordinates_attr, 2, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const void *>(0));
+		glVertexAttribPointer(c_texture_coordinates_attr, 2, GL_FLOAT, GL_FALSE, stride, reinterpret_cast<const void *>(2 * sizeof(GLfloat)));
+		glEnableVertexAttribArray(c_vertex_coordinates_attr);
+		glEnableVertexAttribArray(c_texture_coordinates_attr);
+		blit_statistics_.gl_calls += 10;
+
+		for (int t = 0; t < types.size(); ++t)
+		{
+			QGLShaderProgram * blitProgram = GetBlitProgram(types.at(t));
+			if (!blitProgram || !blitProgram->isLinked() || !blitProgram->bind())
+			{
+				qWarning()<<"Failed to bind shader program, can't blit textures of type"<<types.at(t);
+				continue;
+			}
+			blit_statistics_.program_binds++;
+			blit_statistics_.gl_calls++;
+
+			GLuint bound_texture = 0;
+			for (int q = first_quad_of_type.at(t); q < first_quad_of_type.at(t + 1); ++q)
+			{
+				const QOpenGLTextureHolder * holder = quads.at(q)->holder;
+				if (holder->getTexture() != bound_texture)
+				{
+					bound_texture = holder->getTexture();
+					glBindTexture(holder->getTextureType(), bound_texture);
+					blit_statistics_.texture_binds++;
+					blit_statistics_.gl_calls++;
+				}
+				glDrawArrays(GL_TRIANGLES, q * c_vertices_per_quad, c_vertices_per_quad);
+				blit_statistics_.draw_calls++;
+				blit_statistics_.gl_calls++;
+			}
+			glBindTexture(types.at(t), 0);
+			blitProgram->release();
+			blit_statistics_.gl_calls += 2;
+		}
+
+		glDisableVertexAttribArray(c_vertex_coordinates_attr);
+		glDisableVertexAttribArray(c_texture_coordinates_attr);
+		glBindBuffer(GL_ARRAY_BUFFER, 0);
+		blit_statistics_.gl_calls += 3;
+	#endif
+}
+
+void QOpenGLTextureHolder::resetBlitStatistics()
+{
+	blit_statistics_ = BlitStatistics();
+}
+
 void QOpenGLTextureHolder::allocateTexture()
 {
 	deallocateTexture();
@@ -384,16 +622,11 @@ void QOpenGLTextureHolder::allocateTexture(GLenum type)
 void QOpenGLTextureHolder::allocateTexture(const QImage & qimage, GLenum texture_type, bool gl_prepared,
 	GLenum prepared_image_type, GLenum prepared_pixel_type)
 {
-	deallocateTexture();
 	if (qimage.isNull() || qimage.width() < 1 || qimage.height() < 1)
 	{
+		deallocateTexture();
 		return;
 	}
-	texture_type_ = texture_type;
-	texture_size_ = qimage.size();
-	a11_ = 1.0f; a12_ = 0.0f;
-	a21_ = 0.0f; a22_ = 1.0f;
-	b1_ = 0; b2_ = 0;
 
 	// Prepare image data in bits
 	const uchar * bits = 0;
@@ -401,13 +634,26 @@ void QOpenGLTextureHolder::allocateTexture(const QImage & qimage, GLenum texture
 	int width = 0, height = 0;
 	GLenum type = GL_RGBA;
 	GLenum pixel_type = GL_UNSIGNED_BYTE;
+	GLfloat stretch_x = 1.0f;
 	if (gl_prepared)
 	{
-		bits = qimage.bits();
+		bits = qimage.constBits();
 		width = qimage.width();
 		height = qimage.height();
 		type = prepared_image_type;
 		pixel_type = prepared_pixel_type;
+
+		// GL ES 2 has no GL_UNPACK_ROW_LENGTH, so an image with padded lines
+		// (e.g. living in a larger pooled Android bitmap) is uploaded with the padding
+		// and the extra pixels are cut off with the texture transformation.
+		int bytes_per_pixel = (pixel_type == GL_UNSIGNED_SHORT_5_6_5)? 2: 4;
+		int bytes_per_line = qimage.bytesPerLine();
+		if (bytes_per_line != width * bytes_per_pixel && (bytes_per_line % bytes_per_pixel) == 0)
+		{
+			int padded_width = bytes_per_line / bytes_per_pixel;
+			stretch_x = static_cast<GLfloat>(width) / static_cast<GLfloat>(padded_width);
+			width = padded_width;
+		}
 	}
 	else
 	{
@@ -415,20 +661,59 @@ void QOpenGLTextureHolder::allocateTexture(const QImage & qimage, GLenum texture
 		if (gl_image.isNull())
 		{
 			qCritical()<<"Failed to convert QImage to GL format!";
+			deallocateTexture();
 			return;
 		}
-		bits = gl_image.bits();
+		bits = gl_image.constBits();
 		width = gl_image.width();
 		height = gl_image.height();
 	}
 
-	// Create texture and load bits into its memory
-	glGenTextures(1, &texture_id_);
-	glBindTexture(texture_type, texture_id_);
-	glTexImage2D(texture_type, 0, static_cast<GLint>(type), width, height, 0, type, pixel_type, bits);
-	glTexParameteri(texture_type, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
-	glTexParameteri(texture_type, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
-	glBindTexture(texture_type, 0);
+	// Loading the image into the existing texture if the layout matches, to avoid
+	// re-creating the texture on every frame.
+	bool reuse_texture = texture_id_ != 0 && texture_type_ == texture_type
+		&& uploaded_size_ == QSize(width, height)
+		&& uploaded_format_ == type && uploaded_pixel_type_ == pixel_type;
+	if (!reuse_texture)
+	{
+		deallocateTexture();
+	}
+	texture_type_ = texture_type;
+	texture_size_ = qimage.size();
+	setTransformation(
+		stretch_x, 0.0f,
+		0.0f, 1.0f,
+		0, 0);
+
+	// 16-bit lines may be aligned to 2 bytes only
+	GLint alignment = (((width * ((pixel_type == GL_UNSIGNED_SHORT_5_6_5)? 2: 4)) % 4) == 0)? 4: 2;
+	if (alignment != 4)
+	{
+		glPixelStorei(GL_UNPACK_ALIGNMENT, alignment);
+	}
+	if (reuse_texture)
+	{
+		glBindTexture(texture_type, texture_id_);
+		glTexSubImage2D(texture_type, 0, 0, 0, width, height, type, pixel_type, bits);
+		glBindTexture(texture_type, 0);
+	}
+	else
+	{
+		// Create texture and load bits into its memory
+		glGenTextures(1, &texture_id_);
+		glBindTexture(texture_type, texture_id_);
+		glTexImage2D(texture_type, 0, static_cast<GLint>(type), width, height, 0, type, pixel_type, bits);
+		glTexParameteri(texture_type, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+		glTexParameteri(texture_type, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+		glBindTexture(texture_type, 0);
+		uploaded_size_ = QSize(width, height);
+		uploaded_format_ = type;
+		uploaded_pixel_type_ = pixel_type;
+	}
+	if (alignment != 4)
+	{
+		glPixelStorei(GL_UNPACK_ALIGNMENT, 4);
+	}
 }
 
 void QOpenGLTextureHolder::allocateTexture(const QImage & qimage, bool real_32bit_format_is_qt_abgr, GLenum texture_type)
@@ -443,14 +728,84 @@ void QOpenGLTextureHolder::allocateTexture(const QImage & qimage, bool real_32bi
 	allocateTexture(qimage, texture_type, avoid_gl_conversion, type, pixel_type);
 	if (avoid_gl_conversion)
 	{
-		// Fixing Y axis by setting this texture transformation.
+		// Fixing Y axis by setting this texture transformation
+		// (keeping horizontal scale for padded images).
 		setTransformation(
-			1.0f,  0.0f,
+			a11_,  0.0f,
 			0.0f, -1.0f,
 			0, 0);
 	}
 }
 
+bool QOpenGLTextureHolder::allocateTextureInAtlas(const QImage & qimage, bool real_32bit_format_is_qt_abgr, const QRect & dirty_rect)
+{
+	if (qimage.isNull() || qimage.width() < 1 || qimage.height() < 1)
+	{
+		return false;
+	}
+	GLenum format = GL_RGBA;
+	GLenum pixel_type = GL_UNSIGNED_BYTE;
+	int bytes_per_pixel = 4;
+	if (qimage.format() == QImage::Format_RGB16)
+	{
+		format = GL_RGB;
+		pixel_type = GL_UNSIGNED_SHORT_5_6_5;
+		bytes_per_pixel = 2;
+	}
+	else if (!real_32bit_format_is_qt_abgr
+		|| (qimage.format() != QImage::Format_ARGB32_Premultiplied && qimage.format() != QImage::Format_ARGB32))
+	{
+		return false;
+	}
+	if ((qimage.bytesPerLine() % bytes_per_pixel) != 0)
+	{
+		return false;
+	}
+
+	// The slot includes line padding, as GL ES 2 can't skip it during upload.
+	QSize slot_size(qimage.bytesPerLine() / bytes_per_pixel, qimage.height());
+	bool reuse_slot = atlas_ && atlas_->format() == format && atlas_->pixelType() == pixel_type
+		&& atlas_rect_.size() == slot_size;
+	if (!reuse_slot)
+	{
+		QRect rect;
+		QSharedPointer<QOpenGLTextureAtlas> atlas = QOpenGLTextureAtlas::allocate(slot_size, format, pixel_type, &rect);
+		if (!atlas)
+		{
+			return false;
+		}
+		deallocateTexture();
+		atlas_ = atlas;
+		atlas_rect_ = rect;
+		texture_id_ = atlas_->texture();
+		texture_type_ = GL_TEXTURE_2D;
+	}
+	texture_size_ = qimage.size();
+
+	// Map [0..1] of the image to the slot, reversing Y axis as the image is loaded top line first.
+	// The coordinates are inset by half a texel (from the edges to the centers of the edge
+	// texels), so GL_LINEAR never mixes in texels outside of the slot: the gutter and
+	// the neighbours may contain anything, e.g. pixels of the previous owner of the slot.
+	GLfloat page_width = static_cast<GLfloat>(atlas_->size().width());
+	GLfloat page_height = static_cast<GLfloat>(atlas_->size().height());
+	setTransformation(
+		static_cast<GLfloat>(qimage.width() - 1) / page_width, 0.0f,
+		0.0f, -static_cast<GLfloat>(qimage.height() - 1) / page_height,
+		(static_cast<GLfloat>(atlas_rect_.x()) + 0.5f) / page_width,
+		(static_cast<GLfloat>(atlas_rect_.y() + qimage.height()) - 0.5f) / page_height);
+
+	int first_line = 0;
+	int lines = qimage.height();
+	if (reuse_slot && !dirty_rect.isEmpty())
+	{
+		QRect dirty = dirty_rect & qimage.rect();
+		first_line = dirty.top();
+		lines = dirty.height();
+	}
+	atlas_->upload(atlas_rect_, qimage.constBits(), qimage.bytesPerLine(), first_line, lines);
+	return true;
+}
+
 void QOpenGLTextureHolder::allocateTexture(const QString & filename)
 {
 	allocateTexture(QImage(filename));
@@ -38,8 +38,13 @@
 #include <EGL/egl.h>
 #include <QtCore/QRect>
 #include <QtCore/QRectF>
+#include <QtCore/QList>
+#include <QtCore/QMutex>
+#include <QtCore/QPair>
+#include <QtCore/QVector>
 #include <QtCore/QSharedPointer>
 #include <QtOpenGL/QGLShaderProgram>
+#include "QOpenGLTextureAtlas.h"
 
 /*!
  * This class:
@@ -56,6 +61,34 @@
 class QOpenGLTextureHolder
 {
 public:
+	//! One texture to draw by blitTextures().
+	struct BlitItem
+	{
+		BlitItem(): holder(0), reverse_y(false) {}
+		BlitItem(const QOpenGLTextureHolder * h, const QRect & target, const QRect & source, bool reverse)
+			: holder(h), target_rect(target), source_rect(source), reverse_y(reverse) {}
+
+		const QOpenGLTextureHolder * holder;
+		//! Output rectangle in window GL coordinates (like glViewport() parameters).
+		QRect target_rect;
+		//! Source rectangle in the texture, as for blitTexture().
+		QRect source_rect;
+		bool reverse_y;
+	};
+
+	/*!
+	 * Counters of GL work done by blitTexture() and blitTextures().
+	 * Reset them once per frame via resetBlitStatistics() to get per-frame numbers.
+	 */
+	struct BlitStatistics
+	{
+		BlitStatistics(): gl_calls(0), program_binds(0), texture_binds(0), draw_calls(0) {}
+		quint64 gl_calls;
+		quint64 program_binds;
+		quint64 texture_binds;
+		quint64 draw_calls;
+	};
+
 	/*!
 	 * Allocates a texture and sets its supposed size.
 	 * \note This function should be called with correct OpenGL context.
@@ -91,7 +124,27 @@ public:
 	 * \param targetRect - output coordinates in OpenGL terms.
 	 * \param sourceRect - used to calculate source rectangle in the GL texture.
 	 */
-	void blitTexture(const QRect & targetRect, const QRect & sourceRect, bool reverse_y = false);
+	void blitTexture(const QRect & targetRect, const QRect & sourceRect, bool reverse_y = false) const;
+
+	/*!
+	 * Draw several textures in current GL context at once. Quads of all textures are
+	 * put into a single shared vertex buffer, and each shader program (one per texture type)
+	 * is bound only once. Unallocated holders are skipped.
+	 * \param viewport_size - size of current GL viewport, which should start at (0, 0).
+	 */
+	static void blitTextures(const QSize & viewport_size, const QList<BlitItem> & items);
+
+	/*!
+	 * Calculate transformed texture coordinates of the 4 corners of the source rect,
+	 * as they are used by blitTexture(). The corners go in order: top left, top right,
+	 * bottom right, bottom left (as seen on screen when reverse_y is false).
+	 * This can be used to draw the texture by some other means, e.g. in a scene graph node.
+	 * \param texCoordArray - array of 8 floats (4 x (s, t)).
+	 */
+	void textureCoordinates(const QRectF & bitmap_rect, bool reverse_y, GLfloat * texCoordArray) const;
+
+	static const BlitStatistics & blitStatistics() { return blit_statistics_; }
+	static void resetBlitStatistics();
 
 	//! Allocate a texture of the current texture type.
 	void allocateTexture();
@@ -101,9 +154,11 @@ public:
 
 	/*!
 	 * Allocate texture and load data from QImage using custom parameters.
+	 * If the texture is already allocated with the same size and format, the data
+	 * is loaded into it via glTexSubImage2D() instead of re-creating the texture.
 	 * \param gl_prepared - set to false to convert data from any QImage format to one supported
 	 *  by GL, or set to true to load data directly from qimage as described by prepared_image_type
-	 *  and prepared_pixel_type.
+	 *  and prepared_pixel_type. Prepared images may have lines padded to any number of pixels.
 	 */
 	void allocateTexture(const QImage & qimage, GLenum texture_type, bool gl_prepared,
 		GLenum prepared_image_type = GL_RGBA, GLenum prepared_pixel_type = GL_UNSIGNED_BYTE);
@@ -122,6 +177,21 @@ public:
 	 */
 	void allocateTexture(const QImage & qimage, bool real_32bit_format_is_qt_abgr = false, GLenum texture_type = GL_TEXTURE_2D);
 
+	/*!
+	 * Load data from QImage into a slot of a shared texture atlas page (\see QOpenGLTextureAtlas)
+	 * instead of own texture. Only images which can be loaded without conversion
+	 * (as described for allocateTexture(const QImage &, bool, GLenum)) and are small
+	 * enough are supported.
+	 * \param dirty_rect - if the image is already in the atlas, only the lines covered
+	 *  by this rect are loaded. Empty rect means the whole image.
+	 * \return false if the image can't be put into the atlas; in this case the holder is
+	 *  left unchanged and allocateTexture() should be used.
+	 */
+	bool allocateTextureInAtlas(const QImage & qimage, bool real_32bit_format_is_qt_abgr, const QRect & dirty_rect = QRect());
+
+	//! The texture is a shared atlas page which should not be deleted or resized directly.
+	bool isInAtlas() const { return !atlas_.isNull(); }
+
 	/*!
 	 * Allocate texture and load data from a file.
 	 */
@@ -130,6 +200,22 @@ public:
 	//! Deallocate texture, if it has been allocated. Also clears the transformation matrix.
 	void deallocateTexture();
 
+	/*!
+	 * Same as deallocateTexture(), but doesn't need GL context: the texture is deleted
+	 * (or its atlas slot is released) by the next deleteOrphanedTextures() call.
+	 * Thread-safe as long as nobody uses the holder.
+	 */
+	void deallocateTextureLater();
+
+	//! Schedule deletion of a texture to the next deleteOrphanedTextures() call. Thread-safe.
+	static void deleteTextureLater(GLuint texture_id);
+
+	/*!
+	 * Delete textures passed to deleteTextureLater() and release atlas slots left by
+	 * deallocateTextureLater(). Should be called with the correct GL context.
+	 */
+	static void deleteOrphanedTextures();
+
 	/*!
 	 * This function may be called during initialization of GL to prevent shader compilation
 	 * during first blitTexture() call.
@@ -138,7 +224,8 @@ public:
 
 private:
 	//! Helper for blitTexture().
-	void drawTexture(const QRectF & rect, const QRectF & bitmap_rect, bool reverse_y);
+	void drawTexture(const QRectF & rect, const QRectF & bitmap_rect, bool reverse_y) const;
+
 
 	//! Shader programs for drawTexture().
 	static QGLShaderProgram * GetBlitProgram(GLenum target);
@@ -149,7 +236,21 @@ protected:
 	QSize texture_size_;
 	// Texture transformation: (v) = (A)*(b).
 	GLfloat a11_, a12_, a21_, a22_, b1_, b2_;
+	// Layout of the data loaded by allocateTexture(QImage...), used to reuse the texture.
+	QSize uploaded_size_;
+	GLenum uploaded_format_, uploaded_pixel_type_;
+	// Atlas page and slot when the texture is in the atlas (texture_id_ is not owned then).
+	QSharedPointer<QOpenGLTextureAtlas> atlas_;
+	QRect atlas_rect_;
 	static QMap<GLenum, QSharedPointer<QGLShaderProgram> > blit_programs_;
+	//! Vertex buffer shared by all blitTextures() calls.
+	static GLuint blit_vertex_buffer_;
+	static BlitStatistics blit_statistics_;
+	static QMutex orphaned_textures_mutex_;
+	static QVector<GLuint> orphaned_textures_;
+	//! Atlas slots to be released in GL thread (the pages are not thread-safe).
+	typedef QPair<QSharedPointer<QOpenGLTextureAtlas>, QRect> AtlasSlot;
+	static QVector<AtlasSlot> orphaned_atlas_slots_;
 private:
 	Q_DISABLE_COPY(QOpenGLTextureHolder)
 };
@@ -35,66 +35,231 @@
 */
 
 #include <QtGui/QtGui>
-#include <QtQuick/QSGTransformNode>
-#include <QtQuick/QSGSimpleTextureNode>
+#include <GLES2/gl2ext.h>
+#include <QtQuick/QSGGeometryNode>
+#include <QtQuick/QSGMaterial>
+#include <QtQuick/QSGSimpleRectNode>
 #include <QtQuick/QQuickWindow>
+#include <QAndroidOffscreenViewPool.h>
 #include "QQuickAndroidOffscreenView.h"
 
 namespace {
 
-class TexureHolderNode
-	: public QSGSimpleTextureNode
+/*!
+ * Scene graph material which samples the texture of QOpenGLTextureHolder directly
+ * (GL_TEXTURE_2D or GL_TEXTURE_EXTERNAL_OES). The texture is not owned by the material.
+ */
+class OffscreenViewTextureMaterial
+	: public QSGMaterial
 {
 public:
-	TexureHolderNode() {}
-	QScopedPointer<QOpenGLFramebufferObject> fbo_;
+	OffscreenViewTextureMaterial(GLenum texture_type)
+		: texture_type_(texture_type)
+		, texture_id_(0)
+	{
+	}
+
+	GLenum textureType() const { return texture_type_; }
+	GLuint textureId() const { return texture_id_; }
+	void setTextureId(GLuint id) { texture_id_ = id; }
+
+	virtual QSGMaterialType * type() const
+	{
+		static QSGMaterialType type_2d, type_oes;
+		return (texture_type_ == GL_TEXTURE_EXTERNAL_OES)? &type_oes: &type_2d;
+	}
+
+	virtual QSGMaterialShader * createShader() const;
+
+	virtual int compare(const QSGMaterial * other) const
+	{
+		const OffscreenViewTextureMaterial * o = static_cast<const OffscreenViewTextureMaterial *>(other);
+		return int(texture_id_) - int(o->texture_id_);
+	}
+
+private:
+	GLenum texture_type_;
+	GLuint texture_id_;
 };
 
-static void ClearOpenGLState()
+class OffscreenViewTextureShader
+	: public QSGMaterialShader
 {
-	glBindBuffer(GL_ARRAY_BUFFER, 0);
-	glBindBuffer(GL_ELEMENT_ARRAY_BUFFER, 0);
+public:
+	OffscreenViewTextureShader(GLenum texture_type)
+		: texture_type_(texture_type)
+		, matrix_id_(-1)
+		, opacity_id_(-1)
+	{
+	}
 
-	GLint maxAttribs;
-	glGetIntegerv(GL_MAX_VERTEX_ATTRIBS, &maxAttribs);
-	for (GLuint i = 0; GLint(i) < maxAttribs; ++i)
+	virtual const char * const * attributeNames() const
 	{
-		glVertexAttribPointer(i, 4, GL_FLOAT, GL_FALSE, 0, 0); //-V112
-		glDisableVertexAttribArray(i);
+		static const char * const names[] = { "qt_VertexPosition", "qt_VertexTexCoord", 0 };
+		return names;
 	}
 
-	glActiveTexture(GL_TEXTURE0);
-	glBindTexture(GL_TEXTURE_2D, 0);
+	virtual void initialize()
+	{
+		QSGMaterialShader::initialize();
+		matrix_id_ = program()->uniformLocation("qt_Matrix");
+		opacity_id_ = program()->uniformLocation("qt_Opacity");
+		program()->bind();
+		program()->setUniformValue("imageTexture", 0);
+	}
 
-	glDisable(GL_DEPTH_TEST);
-	glDisable(GL_STENCIL_TEST);
-	glDisable(GL_SCISSOR_TEST);
+	virtual void updateState(const RenderState & state, QSGMaterial * new_material, QSGMaterial * old_material)
+	{
+		if (state.isMatrixDirty())
+		{
+			program()->setUniformValue(matrix_id_, state.combinedMatrix());
+		}
+		if (state.isOpacityDirty())
+		{
+			program()->setUniformValue(opacity_id_, state.opacity());
+		}
+		OffscreenViewTextureMaterial * m = static_cast<OffscreenViewTextureMaterial *>(new_material);
+		OffscreenViewTextureMaterial * o = static_cast<OffscreenViewTextureMaterial *>(old_material);
+		if (!o || o->textureId() != m->textureId())
+		{
+			glBindTexture(m->textureType(), m->textureId());
+		}
+	}
 
-	glDepthMask(true);
-	glDepthFunc(GL_LESS);
-	glClearDepthf(1);
+protected:
+	virtual const char * vertexShader() const
+	{
+		return
+			"attribute highp vec4 qt_VertexPosition; \n"
+			"attribute highp vec2 qt_VertexTexCoord; \n"
+			"uniform highp mat4 qt_Matrix; \n"
+			"varying highp vec2 textureCoords; \n"
+			"void main() \n"
+			"{ \n"
+			"  textureCoords = qt_VertexTexCoord; \n"
+			"  gl_Position = qt_Matrix * qt_VertexPosition; \n"
+			"}\n";
+	}
 
-	glStencilMask(0xff);
-	glStencilOp(GL_KEEP, GL_KEEP, GL_KEEP);
-	glStencilFunc(GL_ALWAYS, 0, 0xff);
+	virtual const char * fragmentShader() const
+	{
+		// #extension directive must go before any other code.
+		if (texture_type_ == GL_TEXTURE_EXTERNAL_OES)
+		{
+			return
+				"#extension GL_OES_EGL_image_external : require \n"
+				"varying highp vec2 textureCoords; \n"
+				"uniform samplerExternalOES imageTexture; \n"
+				"uniform lowp float qt_Opacity; \n"
+				"void main() \n"
+				"{ \n"
+				"  gl_FragColor = texture2D(imageTexture, textureCoords) * qt_Opacity; \n"
+				"}\n";
+		}
+		return
+			"varying highp vec2 textureCoords; \n"
+			"uniform sampler2D imageTexture; \n"
+			"uniform lowp float qt_Opacity; \n"
+			"void main() \n"
+			"{ \n"
+			"  gl_FragColor = texture2D(imageTexture, textureCoords) * qt_Opacity; \n"
+			"}\n";
+	}
 
-	glEnable(GL_BLEND);
-	glBlendFunc(GL_ONE, GL_ONE);
+private:
+	GLenum texture_type_;
+	int matrix_id_;
+	int opacity_id_;
+};
 
-	glUseProgram(0);
+QSGMaterialShader * OffscreenViewTextureMaterial::createShader() const
+{
+	return new OffscreenViewTextureShader(texture_type_);
 }
 
+/*!
+ * Draws texture of the view over a rectangle of the fill color. The texture is sampled
+ * with the transformation from QOpenGLTextureHolder (including SurfaceTexture transform
+ * matrix in GL mode), so no intermediate framebuffer is needed.
+ */
+class OffscreenViewNode
+	: public QSGSimpleRectNode
+{
+public:
+	OffscreenViewNode()
+		: texture_node_(0)
+		, geometry_(QSGGeometry::defaultAttributes_TexturedPoint2D(), 4)
+	{
+		geometry_.setDrawingMode(GL_TRIANGLE_STRIP);
+	}
+
+	~OffscreenViewNode()
+	{
+		hideTexture();
+	}
+
+	//! Show the texture of the holder, which should be allocated.
+	void showTexture(const QOpenGLTextureHolder & holder, const QRectF & rect, const QSize & source_size, bool opaque)
+	{
+		if (texture_node_ && material_->textureType() != holder.getTextureType())
+		{
+			hideTexture();
+		}
+		if (!texture_node_)
+		{
+			material_.reset(new OffscreenViewTextureMaterial(holder.getTextureType()));
+			texture_node_ = new QSGGeometryNode();
+			texture_node_->setGeometry(&geometry_);
+			texture_node_->setMaterial(material_.data());
+			appendChildNode(texture_node_);
+		}
+		material_->setFlag(QSGMaterial::Blending, !opaque);
+		material_->setTextureId(holder.getTexture());
+
+		// Corners: top left, top right, bottom right, bottom left.
+		GLfloat tc[4*2];
+		holder.textureCoordinates(QRectF(QPointF(0, 0), source_size), false, tc);
+		// Triangle strip: top left, bottom left, top right, bottom right.
+		QSGGeometry::TexturedPoint2D * v = geometry_.vertexDataAsTexturedPoint2D();
+		v[0].set(rect.left(), rect.top(), tc[0], tc[1]);
+		v[1].set(rect.left(), rect.bottom(), tc[6], tc[7]);
+		v[2].set(rect.right(), rect.top(), tc[2], tc[3]);
+		v[3].set(rect.right(), rect.bottom(), tc[4], tc[5]);
+		texture_node_->markDirty(QSGNode::DirtyGeometry | QSGNode::DirtyMaterial);
+	}
+
+	//! Show only the fill color.
+	void hideTexture()
+	{
+		if (texture_node_)
+		{
+			removeChildNode(texture_node_);
+			delete texture_node_;
+			texture_node_ = 0;
+			material_.reset();
+		}
+	}
+
+private:
+	QSGGeometryNode * texture_node_;
+	QScopedPointer<OffscreenViewTextureMaterial> material_;
+	QSGGeometry geometry_;
+};
+
 } // anonymous namespace
 
 
 
 
 QQuickAndroidOffscreenView::QQuickAndroidOffscreenView(QAndroidOffscreenView * aview)
-	: aview_(aview)
+	: aview_(aview, &QAndroidOffscreenViewPool::releaseView)
 	, is_interactive_(true) // TODO
 	, mouse_tracking_(false)
 	, redraw_texture_needed_(true)
+	, shown_in_window_(true)
 	, last_set_position_(0, 0) // View always at (0, 0) by default.
+	, statistics_interval_(0)
+	, statistics_timer_()
 {
 	setFlag(QQuickItem::ItemHasContents, true);
 	setAcceptedMouseButtons(Qt::LeftButton);
@@ -105,7 +270,13 @@ QQuickAndroidOffscreenView::QQuickAndroidOffscreenView(QAndroidOffscreenView * a
 	connect(this, SIGNAL(visibleChanged()), this, SLOT(updateAndroidViewVisibility()));
 	connect(aview_.data(), SIGNAL(visibleRectReceived(int,int)), this, SLOT(onVisibleRectReceived(int,int)));
 	connect(aview_.data(), SIGNAL(viewCreated()), this, SLOT(onViewCreated()));
+	connect(&statistics_timer_, SIGNAL(timeout()), this, SIGNAL(frameStatisticsChanged()));
 	aview_->setAttachingMode(is_interactive_);
+	// A view taken from QAndroidOffscreenViewPool may be already created
+	if (aview_->isCreated())
+	{
+		QMetaObject::invokeMethod(this, "onViewCreated", Qt::QueuedConnection);
+	}
 }
 
 void QQuickAndroidOffscreenView::setBackgroundColor(const QColor & color)
@@ -119,10 +290,105 @@ void QQuickAndroidOffscreenView::setBackgroundColor(const QColor & color)
 	}
 }
 
+void QQuickAndroidOffscreenView::setStatisticsInterval(int msec)
+{
+	msec = qMax(0, msec);
+	if (msec != statistics_interval_)
+	{
+		statistics_interval_ = msec;
+		if (msec > 0)
+		{
+			statistics_timer_.start(msec);
+		}
+		else
+		{
+			statistics_timer_.stop();
+		}
+		emit statisticsIntervalChanged(msec);
+	}
+}
+
+void QQuickAndroidOffscreenView::setMaxUpdateRate(int fps)
+{
+	if (fps != androidView()->maxUpdateRate())
+	{
+		androidView()->setMaxUpdateRate(fps);
+		emit maxUpdateRateChanged(androidView()->maxUpdateRate());
+	}
+}
+
+void QQuickAndroidOffscreenView::setVsyncPacing(bool enabled)
+{
+	if (enabled != androidView()->vsyncPacing())
+	{
+		androidView()->setVsyncPacing(enabled);
+		emit vsyncPacingChanged(enabled);
+	}
+}
+
 void QQuickAndroidOffscreenView::onTextureUpdated()
 {
 	redraw_texture_needed_ = true;
-	QMetaObject::invokeMethod(this, "update", Qt::AutoConnection);
+	// The texture will be taken when the item is shown again.
+	if (shown_in_window_)
+	{
+		QMetaObject::invokeMethod(this, "update", Qt::AutoConnection);
+	}
+}
+
+bool QQuickAndroidOffscreenView::calculateShownInWindow() const
+{
+	QQuickWindow * w = window();
+	if (!w || !isVisible() || width() <= 0 || height() <= 0)
+	{
+		return false;
+	}
+
+	// isVisible() already accounts parents, but opacity has to be multiplied manually.
+	qreal effective_opacity = 1.0;
+	for (const QQuickItem * item = this; item; item = item->parentItem())
+	{
+		effective_opacity *= item->opacity();
+	}
+	if (effective_opacity <= 0.0)
+	{
+		return false;
+	}
+
+	QRectF rect = mapRectToScene(QRectF(0, 0, width(), height()));
+	rect &= QRectF(0, 0, w->width(), w->height());
+	for (const QQuickItem * item = parentItem(); item && !rect.isEmpty(); item = item->parentItem())
+	{
+		if (item->clip())
+		{
+			rect &= item->mapRectToScene(QRectF(0, 0, item->width(), item->height()));
+		}
+	}
+	return !rect.isEmpty();
+}
+
+void QQuickAndroidOffscreenView::updateShownInWindow()
+{
+	// Note: we can't track when the item is covered by other opaque items;
+	// only the cases which could be checked cheaply are handled.
+	bool shown = calculateShownInWindow();
+	if (shown != shown_in_window_)
+	{
+		shown_in_window_ = shown;
+		aview_->setPaintingPaused(!shown);
+		if (shown)
+		{
+			redraw_texture_needed_ = true;
+			update();
+		}
+		emit shownInWindowChanged(shown);
+	}
+}
+
+void QQuickAndroidOffscreenView::onAfterAnimating()
+{
+	aview_->flushTouchEvents();
+	updateShownInWindow();
 }
 
 void QQuickAndroidOffscreenView::onVisibleRectReceived(int width, int height)
@@ -160,6 +426,11 @@ void QQuickAndroidOffscreenView::mouseMoveEvent(QMouseEvent * event)
 		// qDebug()<<__PRETTY_FUNCTION__;
 		QPoint pos = event->pos();
 		aview_->mouse(QAndroidOffscreenView::ANDROID_MOTIONEVENT_ACTION_MOVE, pos.x(), pos.y());
+		if (connected_window_ && aview_->touchBatching())
+		{
+			// The moves are sent to Java before the next frame (\see onAfterAnimating())
+			connected_window_->update();
+		}
 		event->accept();
 	}
 }
@@ -194,6 +465,24 @@ void QQuickAndroidOffscreenView::mouseReleaseEvent(QMouseEvent * event)
 
 void QQuickAndroidOffscreenView::itemChange(QQuickItem::ItemChange change, const QQuickItem::ItemChangeData & value)
 {
+	if (change == QQuickItem::ItemSceneChange)
+	{
+		// Position, opacity, visibility or clipping of any of the parents may change
+		// without notifying us, so we have to re-check the visibility before every frame.
+		// afterAnimating() is emitted in GUI thread before the scene is synchronized.
+		// The same hook is used to send the move events collected during the frame.
+		if (connected_window_)
+		{
+			disconnect(connected_window_, SIGNAL(afterAnimating()), this, SLOT(onAfterAnimating()));
+		}
+		connected_window_ = value.window;
+		if (connected_window_)
+		{
+			connect(connected_window_, SIGNAL(afterAnimating()), this, SLOT(onAfterAnimating()));
+		}
+		aview_->setTouchFlushedByFrames(connected_window_ != 0);
+		QMetaObject::invokeMethod(this, "updateShownInWindow", Qt::QueuedConnection);
+	}
 	/*
 	We would like to do this and setFlag(ItemSendsScenePositionChanges, true) in constructor,
 	but it's not available in Qt Quick 2.
@@ -220,68 +509,45 @@ QSGNode * QQuickAndroidOffscreenView::updatePaintNode(QSGNode * node, UpdatePain
 		}
 	}
 
-	// ********************************************************************************************
-	// Note: in theory, we could feed our texture right into the node, but unfortunately the Qt
-	// classes don't have the functionality to use a read-only texture id.
-	// So this would require writing our own implementation of textured SG node with black jack
-	// and kittens from scratch.
-	// As I don't have time for that right now, let's just live with drawing our texture over Qt
-	// texture. It doesn't cost that much performance.
-	// ********************************************************************************************
-
 	// Create our painting node
-	TexureHolderNode * n = static_cast<TexureHolderNode *>(node);
-	if (!n) // Мы ещё не создавали узел
+	OffscreenViewNode * n = static_cast<OffscreenViewNode *>(node);
+	if (!n)
 	{
 		if (width() <= 0 || height() <= 0)
 		{
 			return nullptr;
 		}
-		n = new TexureHolderNode();
+		n = new OffscreenViewNode();
 	}
 
-	// Remove buffer if it has wrong size
-	if (n->fbo_ && (n->fbo_->width() != width() || n->fbo_->height() != height()))
+	QRectF rect(0, 0, width(), height());
+	QColor background = getBackgroundColor();
+	if (n->rect() != rect)
 	{
-		n->fbo_.reset();
+		n->setRect(rect);
+		redraw_texture_needed_ = true;
 	}
-
-	// Create new buffer if necessary
-	if (n->fbo_.isNull())
+	if (n->color() != background)
 	{
-		QSize fboSize(qMax<int>(1, int(width())), qMax<int>(1, int(height())));
-		QOpenGLFramebufferObjectFormat format;
-		format.setAttachment(QOpenGLFramebufferObject::NoAttachment); // CombinedDepthStencil
-		n->fbo_.reset(new QOpenGLFramebufferObject(fboSize, format));
-		n->setTexture(
-			window()->createTextureFromId(
-				n->fbo_->texture(),
-				n->fbo_->size(),
-				QQuickWindow::TextureHasAlphaChannel));
-		n->setFiltering(QSGTexture::Nearest);
-		n->setRect(0, 0, width(), height());
-		redraw_texture_needed_ = true;
+		n->setColor(background);
 	}
 
-	if (redraw_texture_needed_)
+	// Not taking new frames while the item is not shown; the node keeps the last frame.
+	if (redraw_texture_needed_ && shown_in_window_)
 	{
 		redraw_texture_needed_ = false;
-		n->fbo_->bind();
+		if (aview_ && aview_->updateGLTextureInHolder())
 		{
-			glViewport(0, 0, n->fbo_->width(), n->fbo_->height());
-			ClearOpenGLState();
-
-			QColor c = getBackgroundColor();
-			glClearColor(c.redF(), c.greenF(), c.blueF(), c.alphaF());
-			glClear(GL_COLOR_BUFFER_BIT);
-
-			if (aview_)
-			{
-				aview_->paintGL(0, 0, static_cast<int>(width()), static_cast<int>(height()), true);
-			}
+			n->showTexture(
+				aview_->getGLTextureHolder()
+				, rect
+				, QSize(static_cast<int>(width()), static_cast<int>(height()))
+				, background.alpha() == 255);
+		}
+		else
+		{
+			n->hideTexture();
 		}
-		n->fbo_->bindDefault();
-		n->markDirty(QSGNode::DirtyMaterial);
 	}
 
 	return n;
@@ -35,9 +35,13 @@
 */
 
 #pragma once
+#include <QtCore/QPointer>
 #include <QtCore/QSharedPointer>
+#include <QtCore/QTimer>
+#include <QtCore/QVariantMap>
 #include <QtGui/QFocusEvent>
 #include <QtQuick/QQuickItem>
+#include <QtQuick/QQuickWindow>
 #include <QAndroidOffscreenView.h>
 
 /*!
@@ -47,6 +51,18 @@ class QQuickAndroidOffscreenView : public QQuickItem
 {
 	Q_OBJECT
 	Q_PROPERTY(QColor backgroundColor READ getBackgroundColor WRITE setBackgroundColor NOTIFY backgroundColorChanged)
+	//! Interval of frameStatistics updates in ms; 0 (default) disables the updates.
+	Q_PROPERTY(int statisticsInterval READ statisticsInterval WRITE setStatisticsInterval NOTIFY statisticsIntervalChanged)
+	//! Frame counters of the view (see QAndroidOffscreenView::FrameStatistics), e.g. for an on-screen overlay.
+	Q_PROPERTY(QVariantMap frameStatistics READ frameStatistics NOTIFY frameStatisticsChanged)
+	//! False when the item is hidden, fully transparent or clipped out; Android View is not painted then.
+	Q_PROPERTY(bool shownInWindow READ isShownInWindow NOTIFY shownInWindowChanged)
+	//! Max number of frames per second painted by the Android View; 0 (default) means no limit.
+	Q_PROPERTY(int maxUpdateRate READ maxUpdateRate WRITE setMaxUpdateRate NOTIFY maxUpdateRateChanged)
+	//! Paint the Android View once per display frame (see QAndroidOffscreenView::setVsyncPacing()).
+	Q_PROPERTY(bool vsyncPacing READ vsyncPacing WRITE setVsyncPacing NOTIFY vsyncPacingChanged)
+	//! Share one texture with other small views (see QAndroidOffscreenView::setUseTextureAtlas()); set it on creation.
+	Q_PROPERTY(bool useTextureAtlas READ useTextureAtlas WRITE setUseTextureAtlas)
 
 public:
 	QQuickAndroidOffscreenView(QAndroidOffscreenView * aview);
@@ -54,6 +70,19 @@ public:
 	QColor getBackgroundColor() const { return androidView()->fillColor(); }
 	void setBackgroundColor(const QColor & color);
 
+	int statisticsInterval() const { return statistics_interval_; }
+	void setStatisticsInterval(int msec);
+	QVariantMap frameStatistics() const { return androidView()->frameStatistics().toVariantMap(); }
+
+	bool isShownInWindow() const { return shown_in_window_; }
+
+	int maxUpdateRate() const { return androidView()->maxUpdateRate(); }
+	void setMaxUpdateRate(int fps);
+	bool vsyncPacing() const { return androidView()->vsyncPacing(); }
+	void setVsyncPacing(bool enabled);
+	bool useTextureAtlas() const { return androidView()->useTextureAtlas(); }
+	void setUseTextureAtlas(bool use) { androidView()->setUseTextureAtlas(use); }
+
 public slots:
 	/*!
 	 * This function must be called from QML after screen position has been changed
@@ -90,10 +119,20 @@ public slots:
 	// Test function for lib developers, don't use it
 	void testFunction() { androidView()->testFunction(); }
 
+	void resetFrameStatistics() { androidView()->resetFrameStatistics(); emit frameStatisticsChanged(); }
+
+	//! Periodically print frame statistics to debug log; 0 disables logging.
+	void setStatisticsLogInterval(int msec) { androidView()->setStatisticsLogInterval(msec); }
+
 signals:
 	void viewCreated();
 	void backgroundColorChanged(QColor color);
 	void visibleRectReceived(int visible_width, int visible_height);
+	void statisticsIntervalChanged(int msec);
+	void frameStatisticsChanged();
+	void shownInWindowChanged(bool shown);
+	void maxUpdateRateChanged(int fps);
+	void vsyncPacingChanged(bool enabled);
 
 protected:
 	QAndroidOffscreenView * androidView() { return aview_.data(); }
@@ -109,17 +148,28 @@ protected:
 
 	QSGNode * updatePaintNode(QSGNode * node, UpdatePaintNodeData * nodedata);
 
+	//! Check if any part of the item can be seen in the window, taking into account
+	//! effective visibility and opacity and clipping by the parent items.
+	bool calculateShownInWindow() const;
+
 protected slots:
 	virtual void updateAndroidViewVisibility();
 	virtual void updateAndroidEnabled();
 	virtual void onTextureUpdated();
 	virtual void onVisibleRectReceived(int width, int height);
 	virtual void onViewCreated();
+	virtual void updateShownInWindow();
+	//! Called before each frame of the window.
+	virtual void onAfterAnimating();
 
 private:
 	QSharedPointer<QAndroidOffscreenView> aview_;
 	bool is_interactive_;
 	bool mouse_tracking_;
 	bool redraw_texture_needed_;
+	bool shown_in_window_;
+	QPointer<QQuickWindow> connected_window_;
 	QPoint last_set_position_;
+	int statistics_interval_;
+	QTimer statistics_timer_;
 };
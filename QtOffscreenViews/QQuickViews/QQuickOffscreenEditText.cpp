@@ -34,10 +34,11 @@
   THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <QAndroidOffscreenViewPool.h>
 #include "QQuickOffscreenEditText.h"
 
 QQuickAndroidOffscreenEditText::QQuickAndroidOffscreenEditText()
-	: QQuickAndroidOffscreenView(new QAndroidOffscreenEditText("EditTextInQuick", QSize(512, 64)))
+	: QQuickAndroidOffscreenView(QAndroidOffscreenViewPool::instance()->acquire<QAndroidOffscreenEditText>("EditTextInQuick", QSize(512, 64)))
 {
 	connect(androidEditText(), SIGNAL(onTextChanged(QString,int,int,int)), this, SLOT(etTextChanged(QString,int,int,int)));
 	connect(androidEditText(), SIGNAL(onKeyBack(bool)), this, SLOT(etKeyBack(bool)));
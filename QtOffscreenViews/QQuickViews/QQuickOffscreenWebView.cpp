@@ -34,10 +34,11 @@
   THE POSSIBILITY OF SUCH DAMAGE.
 */
 
+#include <QAndroidOffscreenViewPool.h>
 #include "QQuickOffscreenWebView.h"
 
 QQuickAndroidOffscreenWebView::QQuickAndroidOffscreenWebView()
-	: QQuickAndroidOffscreenView(new QAndroidOffscreenWebView("WebViewInQuick", QSize(512, 512)))
+	: QQuickAndroidOffscreenView(QAndroidOffscreenViewPool::instance()->acquire<QAndroidOffscreenWebView>("WebViewInQuick", QSize(512, 512)))
 {
 	connect(androidWebView(), SIGNAL(pageStarted(const QString &)), this, SLOT(wwPageStarted(const QString &)));
 	connect(androidWebView(), SIGNAL(pageFinished(const QString &)), this, SLOT(wwPageFinished(const QString &)));
@@ -1,9 +1,14 @@
 HEADERS += \
     QOpenGLTextureHolder.h \
+    QOpenGLTextureAtlas.h \
     QAndroidOffscreenView.h \
     QAndroidOffscreenWebView.h \
     QAndroidOffscreenEditText.h \
     QAndroidJniImagePair.h \
+    QAndroidJniBitmapPool.h \
+    QAndroidJniNativesRegistry.h \
+    QAndroidOffscreenViewPool.h \
+    QAndroidWebResourceResolver.h \
     QApplicationActivityObserver.h \
     QGraphicsWidgets/QAndroidOffscreenViewGraphicsWidget.h \
     QGraphicsWidgets/QOffscreenEditTextGraphicsWidget.h \
@@ -11,10 +16,15 @@ HEADERS += \
 
 SOURCES += \
     QOpenGLTextureHolder.cpp \
+    QOpenGLTextureAtlas.cpp \
     QAndroidOffscreenView.cpp \
     QAndroidOffscreenWebView.cpp \
     QAndroidOffscreenEditText.cpp \
     QAndroidJniImagePair.cpp \
+    QAndroidJniBitmapPool.cpp \
+    QAndroidJniNativesRegistry.cpp \
+    QAndroidOffscreenViewPool.cpp \
+    QAndroidWebResourceResolver.cpp \
     QApplicationActivityObserver.cpp \
     QGraphicsWidgets/QAndroidOffscreenViewGraphicsWidget.cpp \
     QGraphicsWidgets/QOffscreenEditTextGraphicsWidget.cpp \
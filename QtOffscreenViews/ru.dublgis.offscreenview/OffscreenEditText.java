@@ -39,6 +39,7 @@ package ru.dublgis.offscreenview;
 import java.lang.reflect.Field;
 import android.app.Activity;
 import android.content.Context;
+import android.content.res.ColorStateList;
 import android.graphics.Rect;
 import android.graphics.Typeface;
 import android.os.Handler;
@@ -46,6 +47,7 @@ import android.text.Editable;
 import android.text.InputType;
 import android.text.TextWatcher;
 import android.text.method.PasswordTransformationMethod;
+import android.util.TypedValue;
 import android.view.inputmethod.EditorInfo;
 import android.view.ViewGroup;
 import android.view.KeyEvent;
@@ -73,7 +75,52 @@ class OffscreenEditText extends OffscreenView
         SYSTEM_DRAW_NEVER = 0,
         SYSTEM_DRAW_ALWAYS = 1,
         SYSTEM_DRAW_HACKY = 2;
+
+    // Must match QAndroidOffscreenEditText::Style::Field in C++.
+    static final int
+        STYLE_TEXT_SIZE = 0x0001,
+        STYLE_TYPEFACE = 0x0002,
+        STYLE_CURSOR_VISIBLE = 0x0004,
+        STYLE_INPUT_TYPE = 0x0008,
+        STYLE_MAX_LINES = 0x0010,
+        STYLE_PADDING = 0x0020,
+        STYLE_SELECT_ALL_ON_FOCUS = 0x0040,
+        STYLE_SINGLE_LINE = 0x0080,
+        STYLE_TEXT_COLOR = 0x0100,
+        STYLE_GRAVITY = 0x0200,
+        STYLE_HIGHLIGHT_COLOR = 0x0400,
+        STYLE_HINT = 0x0800,
+        STYLE_HINT_TEXT_COLOR = 0x1000,
+        STYLE_IME_OPTIONS = 0x2000;
+
+    // Must match QAndroidOffscreenEditText::Style::IntIndex in C++.
+    // The ints are followed by (field, a, b) triples of line mode changes in order of the calls.
+    static final int
+        STYLE_INT_TEXT_SIZE_UNIT = 0,
+        STYLE_INT_TYPEFACE_STYLE = 1,
+        STYLE_INT_CURSOR_VISIBLE = 2,
+        STYLE_INT_PADDING_LEFT = 3,
+        STYLE_INT_PADDING_TOP = 4,
+        STYLE_INT_PADDING_RIGHT = 5,
+        STYLE_INT_PADDING_BOTTOM = 6,
+        STYLE_INT_SELECT_ALL_ON_FOCUS = 7,
+        STYLE_INT_TEXT_COLOR = 8,
+        STYLE_INT_GRAVITY = 9,
+        STYLE_INT_HIGHLIGHT_COLOR = 10,
+        STYLE_INT_HINT_TEXT_COLOR = 11,
+        STYLE_INT_IME_AND = 12,
+        STYLE_INT_IME_OR = 13,
+        STYLE_INT_COUNT = 14;
     private int system_draw_ = SYSTEM_DRAW_HACKY;
+    volatile private boolean text_delta_mode_ = true;           // threads: c++ & ui
+
+    // Style properties of the freshly created view, restored by resetForReuse().
+    private int default_input_type_ = 0, default_ime_options_ = 0, default_gravity_ = 0, default_highlight_color_ = 0; // threads: ui
+    private int[] default_padding_ = new int[4];                // threads: ui
+    private float default_text_size_ = 0;                       // threads: ui
+    private Typeface default_typeface_ = null;                  // threads: ui
+    private ColorStateList default_text_colors_ = null, default_hint_text_colors_ = null; // threads: ui
+    private CharSequence default_hint_ = null;                  // threads: ui
 
     class MyEditText extends EditText
     {
@@ -98,7 +145,15 @@ class OffscreenEditText extends OffscreenView
                 {
                     text_ = str;
                 }
-                nativeOnTextChanged(getNativePtr(), str, start, before, count);
+                if (text_delta_mode_)
+                {
+                    // Passing only the changed part to C++ which keeps its own copy of the text
+                    nativeOnTextDelta(getNativePtr(), str.substring(start, start + count), start, before, count, str.length());
+                }
+                else
+                {
+                    nativeOnTextChanged(getNativePtr(), str, start, before, count);
+                }
             }
         }
 
@@ -200,7 +255,7 @@ class OffscreenEditText extends OffscreenView
         public void invalidate(Rect dirty)
         {
             super.invalidate(dirty);
-            invalidateOffscreenView();
+            invalidateOffscreenView(dirty.left, dirty.top, dirty.right, dirty.bottom);
         }
 
         @Override
@@ -217,7 +272,7 @@ class OffscreenEditText extends OffscreenView
                 // Log.i(TAG, "MyEditText.invalidate: ignoring invisible rectangle");
                 return;
             }
-            invalidateOffscreenView();
+            invalidateOffscreenView(l, t, r, b);
         }
 
         @Override
@@ -363,7 +418,21 @@ class OffscreenEditText extends OffscreenView
     @Override
     public void doCreateView()
     {
-        setView(new MyEditText(getActivity()));
+        MyEditText et = new MyEditText(getActivity());
+        default_input_type_ = et.getInputType();
+        default_ime_options_ = et.getImeOptions();
+        default_gravity_ = et.getGravity();
+        default_highlight_color_ = et.getHighlightColor();
+        default_padding_[0] = et.getPaddingLeft();
+        default_padding_[1] = et.getPaddingTop();
+        default_padding_[2] = et.getPaddingRight();
+        default_padding_[3] = et.getPaddingBottom();
+        default_text_size_ = et.getTextSize();
+        default_typeface_ = et.getTypeface();
+        default_text_colors_ = et.getTextColors();
+        default_hint_text_colors_ = et.getHintTextColors();
+        default_hint_ = et.getHint();
+        setView(et);
     }
 
     @Override
@@ -376,6 +445,7 @@ class OffscreenEditText extends OffscreenView
 
 
     public native void nativeOnTextChanged(long nativePtr, String s, int start, int before, int count);
+    public native void nativeOnTextDelta(long nativePtr, String inserted, int start, int before, int count, int length);
     public native boolean nativeOnKey(long nativePtr, boolean down, int keyCode);
     public native void nativeOnEditorAction(long nativePtr, int action);
 
@@ -406,6 +476,12 @@ class OffscreenEditText extends OffscreenView
         });
     }
 
+    //! If enabled, C++ receives only the changed part of the text in nativeOnTextDelta().
+    void setTextDeltaMode(final boolean enabled)
+    {
+        text_delta_mode_ = enabled;
+    }
+
     String getText()
     {
         synchronized(text_)
@@ -876,6 +952,132 @@ class OffscreenEditText extends OffscreenView
         });
     }
 
+    // From C++: clear the text and restore the properties which can be set via
+    // QAndroidOffscreenEditText::Style, for a view returned to the pool.
+    void resetForReuse()
+    {
+        synchronized(text_)
+        {
+            text_ = "";
+        }
+        runViewAction(new Runnable(){
+            @Override
+            public void run(){
+                MyEditText et = (MyEditText)getView();
+                et.setText("");
+                need_to_reflow_text_ = false;
+                need_to_reflow_hint_ = false;
+                // setSingleLine(false) also resets max lines
+                et.setInputType(default_input_type_);
+                single_line_ = false;
+                et.setSingleLine(false);
+                et.setImeOptions(default_ime_options_);
+                et.setTypeface(default_typeface_);
+                et.setTextSize(TypedValue.COMPLEX_UNIT_PX, default_text_size_);
+                et.setTextColor(default_text_colors_);
+                et.setHintTextColor(default_hint_text_colors_);
+                et.setHighlightColor(default_highlight_color_);
+                et.setHint(default_hint_);
+                et.setPadding(default_padding_[0], default_padding_[1], default_padding_[2], default_padding_[3]);
+                et.setGravity(default_gravity_);
+                et.setCursorVisible(true);
+                et.setSelectAllOnFocus(false);
+                et.reflowWorkaround();
+                invalidateOffscreenView();
+            }
+        });
+    }
+
+    // Applies a set of properties packed by QAndroidOffscreenEditText::applyStyle()
+    // in one UI thread runnable, so the view is relaid out and repainted only once.
+    void applyStyle(final int fields, final int[] ints, final float text_size, final String[] strings)
+    {
+        runViewAction(new Runnable(){
+            @Override
+            public void run(){
+                MyEditText et = (MyEditText)getView();
+                // These change each other, so they are applied in the order of the C++ calls
+                for (int i = STYLE_INT_COUNT; i + 2 < ints.length; i += 3)
+                {
+                    switch (ints[i])
+                    {
+                        case STYLE_INPUT_TYPE:
+                            et.setInputType((et.getInputType() & ints[i + 1]) | ints[i + 2]);
+                            break;
+                        case STYLE_SINGLE_LINE:
+                            single_line_ = ints[i + 1] != 0;
+                            et.setSingleLine(single_line_);
+                            break;
+                        case STYLE_MAX_LINES:
+                            single_line_ = (ints[i + 1] == 1);
+                            et.setMaxLines(ints[i + 1]);
+                            break;
+                        default:
+                            Log.e(TAG, "applyStyle: unknown line mode field " + ints[i]);
+                            break;
+                    }
+                }
+                if ((fields & STYLE_IME_OPTIONS) != 0)
+                {
+                    et.setImeOptions((et.getImeOptions() & ints[STYLE_INT_IME_AND]) | ints[STYLE_INT_IME_OR]);
+                }
+                if ((fields & STYLE_TYPEFACE) != 0)
+                {
+                    final String name = strings[0];
+                    try
+                    {
+                        et.setTypeface(Typeface.create((name != null && name.length() > 0)? name: null, ints[STYLE_INT_TYPEFACE_STYLE]));
+                    }
+                    catch (final Throwable e)
+                    {
+                        Log.e(TAG, "Failed to create Typeface with name " + name + ": " + e);
+                    }
+                }
+                if ((fields & STYLE_TEXT_SIZE) != 0)
+                {
+                    et.setTextSize(ints[STYLE_INT_TEXT_SIZE_UNIT], text_size);
+                }
+                if ((fields & STYLE_TEXT_COLOR) != 0)
+                {
+                    et.setTextColor(ints[STYLE_INT_TEXT_COLOR]);
+                }
+                if ((fields & STYLE_HINT_TEXT_COLOR) != 0)
+                {
+                    et.setHintTextColor(ints[STYLE_INT_HINT_TEXT_COLOR]);
+                }
+                if ((fields & STYLE_HIGHLIGHT_COLOR) != 0)
+                {
+                    et.setHighlightColor(ints[STYLE_INT_HIGHLIGHT_COLOR]);
+                }
+                if ((fields & STYLE_HINT) != 0)
+                {
+                    et.setHint(strings[1]);
+                }
+                if ((fields & STYLE_PADDING) != 0)
+                {
+                    et.setPadding(ints[STYLE_INT_PADDING_LEFT], ints[STYLE_INT_PADDING_TOP], ints[STYLE_INT_PADDING_RIGHT], ints[STYLE_INT_PADDING_BOTTOM]);
+                }
+                if ((fields & STYLE_GRAVITY) != 0)
+                {
+                    et.setGravity(ints[STYLE_INT_GRAVITY]);
+                }
+                if ((fields & STYLE_CURSOR_VISIBLE) != 0)
+                {
+                    et.setCursorVisible(ints[STYLE_INT_CURSOR_VISIBLE] != 0);
+                }
+                if ((fields & STYLE_SELECT_ALL_ON_FOCUS) != 0)
+                {
+                    et.setSelectAllOnFocus(ints[STYLE_INT_SELECT_ALL_ON_FOCUS] != 0);
+                }
+                if ((fields & STYLE_SINGLE_LINE) != 0)
+                {
+                    et.reflowWorkaround();
+                }
+                invalidateOffscreenView();
+            }
+        });
+    }
+
     void setPasswordMode()
     {
         runViewAction(new Runnable(){
@@ -37,6 +37,8 @@
 package ru.dublgis.offscreenview;
 
 import java.lang.Thread;
+import java.nio.ByteBuffer;
+import java.nio.ByteOrder;
 import java.util.ArrayList;
 import java.util.Iterator;
 import android.app.Activity;
@@ -55,6 +57,8 @@ import android.view.Surface;
 import android.view.WindowManager;
 import android.view.inputmethod.InputMethodManager;
 import android.graphics.Canvas;
+import android.graphics.Paint;
+import android.graphics.PaintFlagsDrawFilter;
 import android.graphics.PorterDuff;
 import android.graphics.Color;
 
@@ -72,7 +76,8 @@ public abstract class OffscreenView
 
     final private Object texture_mutex_ = new Object();
     private int gl_texture_id_ = 0;
-    protected OffscreenRenderingSurface rendering_surface_ = null;
+    volatile protected OffscreenRenderingSurface rendering_surface_ = null; // threads: c++ & ui
+    volatile private boolean drawing_ = false;                               // threads: c++ & ui
 
     // This should always be the inner lock without any other our mutexes locked inside.
     final protected Object view_variables_mutex_ = new Object();
@@ -96,11 +101,43 @@ public abstract class OffscreenView
     private int last_painted_height_ = 0;
     private int last_texture_width_ = 0;
     private int last_texture_height_ = 0;
+    private long last_painted_timestamp_ns_ = 0;
+    private long last_texture_timestamp_ns_ = 0;
+
+    // Dirty rectangles, in offscreen buffer coordinates.
+    final private Rect invalidated_rect_ = new Rect();   // Invalidated since the last paint; guarded by itself
+    final private Rect published_dirty_ = new Rect();    // Painted since the last frame taken by C++; guarded by texture_mutex_
+    volatile private boolean invalidated_whole_view_ = true;     // threads: c++ & ui
+    private int last_paint_scroll_x_ = 0;                // threads: ui
+    private int last_paint_scroll_y_ = 0;                // threads: ui
+
+    // Frame state shared with C++ (see updateFrameState()). Layout (native byte order):
+    // float[16] texture transform matrix, int width, int height, int buffer index,
+    // int (padding), long frame timestamp (System.nanoTime()), int[4] dirty rect
+    // (left, top, right, bottom; empty if unknown).
+    private static final int FRAME_STATE_WIDTH_OFFSET = 64;
+    private static final int FRAME_STATE_HEIGHT_OFFSET = 68;
+    private static final int FRAME_STATE_BUFFER_INDEX_OFFSET = 72;
+    private static final int FRAME_STATE_TIMESTAMP_OFFSET = 80;
+    private static final int FRAME_STATE_DIRTY_OFFSET = 88;
+    private static final int FRAME_STATE_SIZE = 104;
+    private ByteBuffer frame_state_ = null;
+
+    // Opcodes of the command list passed to executeCommands(). Must match
+    // QAndroidOffscreenView::CommandKind.
+    private static final int COMMAND_SET_POSITION = 0;
+    private static final int COMMAND_SET_VISIBLE = 1;
+    private static final int COMMAND_SET_ENABLED = 2;
+    private static final int COMMAND_SET_SCROLL_X = 3;
+    private static final int COMMAND_SET_SCROLL_Y = 4;
+    private static final int COMMAND_SET_FOCUSED = 5;
+    private static final int COMMAND_QUERY_VISIBLE_RECT = 6;
 
     private MyLayout layout_ = null;                             // threads: ui
     volatile private String object_name_ = "UnnamedView";
     volatile private boolean last_visibility_ = false;           // threads: c++ & ui
     volatile private boolean last_enabled_ = true;               // threads: c++ & ui
+    volatile private boolean painting_paused_ = false;           // threads: c++ & ui
     volatile private boolean offscreen_touch_ = false;           // threads: ui
     volatile private boolean is_attached_ = false;               // threads: ui
     volatile private boolean attaching_mode_ = true;             // threads: c++ & ui
@@ -322,6 +359,12 @@ public abstract class OffscreenView
                     }
                     layout_.addView(view);
                     uiAttachViewToQtScreen();
+
+                    if (!trim_memory_callbacks_registered_ && activity != null && getApiLevel() >= 14)
+                    {
+                        TrimMemoryCallbacks.register(activity);
+                        trim_memory_callbacks_registered_ = true;
+                    }
                 }
 
                 // No need to lock view_existence_mutex_ because we are sure that the view
@@ -580,34 +623,66 @@ public abstract class OffscreenView
             @Override
             public void run()
             {
-                final View v = getView();
-                if (v != null)
+                uiSetVisible();
+            }
+        });
+    }
+
+    //! Apply last_visibility_ to the View.
+    private void uiSetVisible()
+    {
+        final View v = getView();
+        if (v != null)
+        {
+            final int android_visiblity = (last_visibility_)? View.VISIBLE: View.INVISIBLE;
+            if (android_visiblity != v.getVisibility())
+            {
+                if (!last_visibility_)
                 {
-                    final int android_visiblity = (last_visibility_)? View.VISIBLE: View.INVISIBLE;
-                    if (android_visiblity != v.getVisibility())
-                    {
-                        if (!last_visibility_)
-                        {
-                            Log.v(TAG, "setVisible: detaching hidden view " + object_name_);
-                            uiDetachViewFromQtScreen();
-                        }
-                        v.setVisibility(android_visiblity);
-                        if (last_visibility_)
-                        {
-                            if (attaching_mode_)
-                            {
-                                uiAttachViewToQtScreen();
-                            }
-                            invalidateOffscreenView();
-                        }
-                    }
-                    else
+                    Log.v(TAG, "setVisible: detaching hidden view " + object_name_);
+                    uiDetachViewFromQtScreen();
+                }
+                v.setVisibility(android_visiblity);
+                if (last_visibility_)
+                {
+                    if (attaching_mode_)
                     {
-                        Log.i(TAG, "setVisible: already \"" + last_visibility_ + "\" for " + object_name_);
+                        uiAttachViewToQtScreen();
                     }
+                    invalidateOffscreenView();
                 }
             }
-        });
+            else
+            {
+                Log.i(TAG, "setVisible: already \"" + last_visibility_ + "\" for " + object_name_);
+            }
+        }
+    }
+
+    //! Returns true if painting is paused by setPaintingPaused().
+    public boolean isPaintingPaused()
+    {
+        return painting_paused_;
+    }
+
+    /*!
+     * Pause / resume drawing of the View into the offscreen buffer. Unlike setVisible(false),
+     * this doesn't hide or detach the View, so it keeps working and will be repainted
+     * to its latest state as soon as painting is resumed.
+     * Used by C++ side when the view is not shown in the Qt window (clipped out,
+     * transparent and so on).
+     */
+    public void setPaintingPaused(final boolean paused)
+    {
+        if (paused == painting_paused_)
+        {
+            return;
+        }
+        painting_paused_ = paused;
+        if (!paused)
+        {
+            invalidateOffscreenView();
+        }
     }
 
     public boolean isEnabled()
@@ -622,31 +697,165 @@ public abstract class OffscreenView
             @Override
             public void run()
             {
-                try
-                {
-                    final View v = getView();
-                    if (v != null)
-                    {
-                        if (!enabled)
-                        {
-                            uiHideKeyboardFromView();
-                        }
-                        v.setEnabled(enabled);
-                    }
-                }
-                catch (final Throwable e)
+                uiSetEnabled(enabled);
+            }
+        });
+    }
+
+    private void uiSetEnabled(final boolean enabled)
+    {
+        try
+        {
+            final View v = getView();
+            if (v != null)
+            {
+                if (!enabled)
                 {
-                    Log.e(TAG, "setEnabled exception: ", e);
+                    uiHideKeyboardFromView();
                 }
+                v.setEnabled(enabled);
             }
-        });
+        }
+        catch (final Throwable e)
+        {
+            Log.e(TAG, "setEnabled exception: ", e);
+        }
     }
 
     private int last_texture_invalidation_ = 0;
     private boolean invalidated_ = true;
+    volatile private int min_paint_interval_ms_ = 0;            // threads: c++ & ui
+    volatile private boolean vsync_pacing_ = false;              // threads: c++ & ui
+    private long last_paint_uptime_ms_ = 0;                      // threads: ui
+    private boolean deferred_paint_scheduled_ = false;           // threads: ui
+    private boolean vsync_paint_scheduled_ = false;              // threads: ui
+
+    /*!
+     * Limit the rate of painting the View into the offscreen buffer; invalidations
+     * which come more often are coalesced into one deferred paint. 0 means no limit.
+     */
+    public void setMaxFrameRate(final int fps)
+    {
+        min_paint_interval_ms_ = (fps > 0)? 1000 / fps: 0;
+    }
+
+    /*!
+     * If enabled, the View is painted at most once per display frame, in the beginning
+     * of the frame (Choreographer callback). Requires API 16, ignored on older devices.
+     */
+    public void setVsyncPacing(final boolean enabled)
+    {
+        vsync_pacing_ = enabled;
+    }
+
+    private static boolean trim_memory_callbacks_registered_ = false;   // threads: ui
+
+    //! Isolates ComponentCallbacks2 (API 14+) so OffscreenView still loads on older devices.
+    private static class TrimMemoryCallbacks
+    {
+        static void register(final Context context)
+        {
+            context.getApplicationContext().registerComponentCallbacks(new android.content.ComponentCallbacks2() {
+                @Override
+                public void onTrimMemory(int level)
+                {
+                    notifyTrimMemory(level);
+                }
+
+                @Override
+                public void onLowMemory()
+                {
+                    notifyTrimMemory(android.content.ComponentCallbacks2.TRIM_MEMORY_COMPLETE);
+                }
+
+                @Override
+                public void onConfigurationChanged(android.content.res.Configuration config)
+                {
+                }
+            });
+        }
+    }
+
+    private static void notifyTrimMemory(int level)
+    {
+        try
+        {
+            nativeOnTrimMemory(level);
+        }
+        catch (final Throwable e)
+        {
+            Log.e(TAG, "notifyTrimMemory exception: ", e);
+        }
+    }
+
+    //! Isolates Choreographer (API 16+) so OffscreenView still loads on older devices.
+    private static class VsyncScheduler
+    {
+        static void postFrameCallback(final Runnable runnable)
+        {
+            android.view.Choreographer.getInstance().postFrameCallback(new android.view.Choreographer.FrameCallback() {
+                @Override
+                public void doFrame(long frame_time_ns)
+                {
+                    runnable.run();
+                }
+            });
+        }
+    }
+
+    //! Returns true if painting has to be postponed to stay within setMaxFrameRate() limit. UI thread.
+    private boolean deferPaintForFrameRate()
+    {
+        final int interval = min_paint_interval_ms_;
+        if (interval <= 0)
+        {
+            return false;
+        }
+        final long wait = last_paint_uptime_ms_ + interval - SystemClock.uptimeMillis();
+        if (wait <= 0)
+        {
+            return false;
+        }
+        invalidated_ = true;
+        if (!deferred_paint_scheduled_)
+        {
+            deferred_paint_scheduled_ = true;
+            new Handler().postDelayed(new Runnable(){
+                @Override
+                public void run()
+                {
+                    deferred_paint_scheduled_ = false;
+                    invalidateOffscreenView();
+                }
+            }, wait);
+        }
+        return true;
+    }
+
+    /*!
+     * Same as invalidateOffscreenView(), but only the given part of the View is marked as changed.
+     * The coordinates are the same as for View.invalidate(int, int, int, int), i.e. scroll is included.
+     */
+    protected void invalidateOffscreenView(final int l, final int t, final int r, final int b)
+    {
+        final View v = getView();
+        final int sx = (v != null)? v.getScrollX(): 0;
+        final int sy = (v != null)? v.getScrollY(): 0;
+        synchronized (invalidated_rect_)
+        {
+            invalidated_rect_.union(l - sx, t - sy, r - sx, b - sy);
+        }
+        scheduleOffscreenViewPaint();
+    }
 
     //! Schedules doDrawViewOnTexture() with filtering out extra calls.
     protected void invalidateOffscreenView()
+    {
+        invalidated_whole_view_ = true;
+        scheduleOffscreenViewPaint();
+    }
+
+    private void scheduleOffscreenViewPaint()
     {
         // Log.i(TAG, "invalidateOffscreenView "+object_name_+", last := "+last_texture_invalidation_);
         runOnUiThread(new Runnable(){
@@ -655,7 +864,7 @@ public abstract class OffscreenView
             {
                 last_texture_invalidation_ = (last_texture_invalidation_ >= 2000000000)? 0: last_texture_invalidation_ + 1;
                 invalidated_ = true;
-                new Handler().post(new Runnable(){
+                final Runnable paint = new Runnable(){
                     private final int invalidation_ = last_texture_invalidation_;
                     @Override
                     public void run()
@@ -674,9 +883,17 @@ public abstract class OffscreenView
                         {
                             //Log.i(TAG, "invalidateOffscreenView "+object_name_+" RUNNABLE: inval="+invalidation_+", last="+last_texture_invalidation_+
                              //  ", invalidated="+invalidated_);
+                            if (deferPaintForFrameRate())
+                            {
+                                return;
+                            }
                             invalidated_ = false;
                             boolean drawn = doDrawViewOnTexture();
-                            if (!drawn)
+                            if (drawn)
+                            {
+                                last_paint_uptime_ms_ = SystemClock.uptimeMillis();
+                            }
+                            else
                             {
                                 // Log.i(TAG, "invalidateOffscreenView: "+object_name_+" Failed to draw the View.");
                                 invalidated_ = true;
@@ -688,7 +905,28 @@ public abstract class OffscreenView
                             //   ", invalidated="+invalidated_);
                         }
                     }
-                });
+                };
+                if (vsync_pacing_ && Build.VERSION.SDK_INT >= 16)
+                {
+                    // All invalidations until the next frame are handled by one paint,
+                    // as invalidated_ is already set.
+                    if (!vsync_paint_scheduled_)
+                    {
+                        vsync_paint_scheduled_ = true;
+                        VsyncScheduler.postFrameCallback(new Runnable(){
+                            @Override
+                            public void run()
+                            {
+                                vsync_paint_scheduled_ = false;
+                                paint.run();
+                            }
+                        });
+                    }
+                }
+                else
+                {
+                    new Handler().post(paint);
+                }
             }
         });
     }
@@ -725,6 +963,13 @@ public abstract class OffscreenView
                 return false;
             }
 
+            // Nobody would see the result. Note: setPaintingPaused(false) will schedule
+            // one more paint.
+            if (painting_paused_)
+            {
+                return false;
+            }
+
             final View v = getView();
             if (v != null && v.getVisibility() != View.VISIBLE)
             {
@@ -735,7 +980,9 @@ public abstract class OffscreenView
 
             try
             {
-                // long t = System.nanoTime();
+                // Used by C++ side to measure painting time.
+                final long paint_started_ns = System.nanoTime();
+                drawing_ = true;
                 Canvas canvas = rendering_surface_.lockCanvas();
                 if (canvas == null)
                 {
@@ -757,6 +1004,14 @@ public abstract class OffscreenView
                                 scroll_y_ = v.getScrollY();
                             }
                             canvas.translate(-scroll_x_, -scroll_y_);
+                            if (scroll_x_ != last_paint_scroll_x_ || scroll_y_ != last_paint_scroll_y_
+                                || v.getWidth() != last_painted_width_ || v.getHeight() != last_painted_height_)
+                            {
+                                // Scrolling and resizing don't necessarily invalidate the View
+                                invalidated_whole_view_ = true;
+                                last_paint_scroll_x_ = scroll_x_;
+                                last_paint_scroll_y_ = scroll_y_;
+                            }
 
                             callViewPaintMethod(canvas);
 
@@ -764,6 +1019,7 @@ public abstract class OffscreenView
                             {
                                 last_painted_width_ = v.getWidth();
                                 last_painted_height_ = v.getHeight();
+                                last_painted_timestamp_ns_ = paint_started_ns;
                             }
 
                             result = true;
@@ -784,21 +1040,66 @@ public abstract class OffscreenView
                     }
 
                     rendering_surface_.unlockCanvas(canvas);
-                    // t = System.nanoTime() - t;
+                    final Rect dirty = takePaintedDirtyRect(v);
+                    published_dirty_.union(dirty);
                     // Tell C++ part that we have a new image
-                    nativeUpdate(getNativePtr());
-
-                    // Log.i(TAG, "doDrawViewOnTexture: success, t="+t/1000000.0+"ms");
+                    nativeUpdate(getNativePtr(), paint_started_ns, dirty.left, dirty.top, dirty.right, dirty.bottom);
                 }
             }
             catch (final Throwable e)
             {
                 Log.e(TAG, "doDrawViewOnTexture exception:", e);
             }
+            finally
+            {
+                drawing_ = false;
+            }
         }
         return result;
     }
 
+    /*!
+     * Returns the part of the buffer changed by the paint which has just been done and resets
+     * the accumulated invalidations. Should be called in Android UI thread.
+     */
+    private Rect takePaintedDirtyRect(final View v)
+    {
+        final Rect dirty = new Rect();
+        final int w, h;
+        if (v != null)
+        {
+            w = v.getWidth();
+            h = v.getHeight();
+        }
+        else
+        {
+            synchronized (view_variables_mutex_)
+            {
+                w = view_width_;
+                h = view_height_;
+            }
+        }
+        synchronized (invalidated_rect_)
+        {
+            if (invalidated_whole_view_ || v == null || invalidated_rect_.isEmpty())
+            {
+                dirty.set(0, 0, w, h);
+            }
+            else
+            {
+                dirty.set(invalidated_rect_);
+                if (!dirty.intersect(0, 0, w, h))
+                {
+                    // Empty dirty rect means "unknown" for C++, so just report the whole view
+                    dirty.set(0, 0, w, h);
+                }
+            }
+            invalidated_whole_view_ = false;
+            invalidated_rect_.setEmpty();
+        }
+        return dirty;
+    }
+
     //! Called from C++ to get current texture.
     public boolean updateTexture()
     {
@@ -814,6 +1115,92 @@ public abstract class OffscreenView
     }
 
 
+    //! Called from C++ to share memory for updateFrameState() results; null to stop sharing.
+    public void setFrameStateBuffer(final ByteBuffer buffer)
+    {
+        synchronized (texture_transform_mutex_)
+        {
+            if (buffer != null && buffer.capacity() < FRAME_STATE_SIZE)
+            {
+                Log.e(TAG, "setFrameStateBuffer: buffer is too small for " + object_name_);
+                frame_state_ = null;
+                return;
+            }
+            frame_state_ = (buffer != null)? buffer.order(ByteOrder.nativeOrder()): null;
+        }
+    }
+
+    /*!
+     * Called from C++ instead of updateTexture() + getTextureTransformMatrix() + getLastTextureWidth()
+     * + getLastTextureHeight() (GL mode) or getQtPaintingTexture() + getLastTextureWidth()
+     * + getLastTextureHeight() (Bitmap mode), so the whole frame state is received in a single JNI call.
+     * The results are written into the buffer set by setFrameStateBuffer().
+     * \return true if there is a new frame.
+     */
+    public boolean updateFrameState(final boolean bitmap_mode)
+    {
+        // This is called from Qt render thread, which should not wait for Android UI thread
+        // painting the view. GL mode doesn't need texture_mutex_ at all (SurfaceTexture has
+        // its own synchronization); in Bitmap mode we just report there's no new frame yet
+        // if the view is being painted now. nativeUpdate() will tell C++ when it is done.
+        final OffscreenRenderingSurface surface = rendering_surface_;
+        if (surface == null)
+        {
+            return false;
+        }
+        int buffer_index = -1;
+        final Rect dirty = new Rect();
+        if (bitmap_mode)
+        {
+            synchronized (texture_mutex_)
+            {
+                // Checking under the lock: lockCanvas() needs texture_mutex_ too, so the
+                // painting can't start between the check and taking the buffer.
+                if (drawing_)
+                {
+                    return false;
+                }
+                buffer_index = surface.getQtPaintingTexture();
+                if (buffer_index >= 0)
+                {
+                    dirty.set(published_dirty_);
+                    published_dirty_.setEmpty();
+                }
+            }
+            if (buffer_index < 0)
+            {
+                return false;
+            }
+        }
+        else if (!surface.updateTexture())
+        {
+            return false;
+        }
+        synchronized (texture_transform_mutex_)
+        {
+            if (frame_state_ == null)
+            {
+                return false;
+            }
+            if (!bitmap_mode)
+            {
+                for (int i = 0; i < 16; ++i)
+                {
+                    frame_state_.putFloat(i * 4, surface.getTextureTransformMatrix(i));
+                }
+            }
+            frame_state_.putInt(FRAME_STATE_WIDTH_OFFSET, last_texture_width_);
+            frame_state_.putInt(FRAME_STATE_HEIGHT_OFFSET, last_texture_height_);
+            frame_state_.putInt(FRAME_STATE_BUFFER_INDEX_OFFSET, buffer_index);
+            frame_state_.putLong(FRAME_STATE_TIMESTAMP_OFFSET, last_texture_timestamp_ns_);
+            frame_state_.putInt(FRAME_STATE_DIRTY_OFFSET, dirty.left);
+            frame_state_.putInt(FRAME_STATE_DIRTY_OFFSET + 4, dirty.top);
+            frame_state_.putInt(FRAME_STATE_DIRTY_OFFSET + 8, dirty.right);
+            frame_state_.putInt(FRAME_STATE_DIRTY_OFFSET + 12, dirty.bottom);
+        }
+        return true;
+    }
+
     /*! Called from C++ to get texture coordinate transformation matrix (filled in updateTexture()).
         This function should be called after updateTexture(). */
     public float getTextureTransformMatrix(int index)
@@ -845,14 +1232,18 @@ public abstract class OffscreenView
         }
     }
 
-    //! Called from C++
-    public void setBitmaps(final Bitmap bitmap_a, final Bitmap bitmap_b)
+    /*!
+     * Called from C++. Returns false if the previous bitmaps are still being painted on;
+     * in this case C++ should not reuse them until the next nativeUpdate().
+     */
+    public boolean setBitmaps(final Bitmap bitmap_a, final Bitmap bitmap_b)
     {
         synchronized (texture_mutex_) {
             if (rendering_surface_ != null) {
-                rendering_surface_.setBitmaps(bitmap_a, bitmap_b);
+                return rendering_surface_.setBitmaps(bitmap_a, bitmap_b);
             }
         }
+        return true;
     }
 
     //! Called from C++
@@ -896,21 +1287,58 @@ public abstract class OffscreenView
             }
             // Log.i(TAG, "ProcessMouseEvent("+action+", "+x+", "+y+") time of press = "+mouse_time_of_press_+", t="+t);
             final MotionEvent event = MotionEvent.obtain(mouse_time_of_press_ /* downTime*/, t /* eventTime */, action, x, y, 0 /*metaState*/);
-            runOnUiThread(new Runnable() {
-                @Override
-                public void run()
+            dispatchOffscreenTouchEvent(view, event);
+        }
+    }
+
+    /*!
+     * Called from C++ with move events collected during a frame: (uptime millis, x, y) for each event.
+     * The events are delivered to the View as one MotionEvent with history.
+     */
+    public void ProcessMouseEventBatch(final long[] samples)
+    {
+        if (getNativePtr() == 0)
+        {
+            Log.i(TAG, "ProcessMouseEventBatch: zero native ptr, ignoring.");
+            return;
+        }
+        if (samples == null || samples.length < 3)
+        {
+            return;
+        }
+        final View view = getView();
+        if (view != null)
+        {
+            if (mouse_time_of_press_ == 0)
+            {
+                mouse_time_of_press_ = samples[0];
+            }
+            final MotionEvent event = MotionEvent.obtain(mouse_time_of_press_ /* downTime*/, samples[0] /* eventTime */,
+                MotionEvent.ACTION_MOVE, (float)samples[1], (float)samples[2], 0 /*metaState*/);
+            for (int i = 3; i + 2 < samples.length; i += 3)
+            {
+                event.addBatch(samples[i], (float)samples[i + 1], (float)samples[i + 2], 1.0f /*pressure*/, 1.0f /*size*/, 0 /*metaState*/);
+            }
+            dispatchOffscreenTouchEvent(view, event);
+        }
+    }
+
+    private void dispatchOffscreenTouchEvent(final View view, final MotionEvent event)
+    {
+        runOnUiThread(new Runnable() {
+            @Override
+            public void run()
+            {
+                offscreen_touch_ = true;
+                view.onTouchEvent(event);
+                offscreen_touch_ = false;
+                if (!attaching_mode_)
                 {
-                    offscreen_touch_ = true;
-                    view.onTouchEvent(event);
-                    offscreen_touch_ = false;
-                    if (!attaching_mode_)
-                    {
-                        // If the view has only been scrolled, it won't call invalidate(). So we just force it to repaint for now.
-                        doDrawViewOnTexture();
-                    }
+                    // If the view has only been scrolled, it won't call invalidate(). So we just force it to repaint for now.
+                    doDrawViewOnTexture();
                 }
-            });
-        }
+            }
+        });
     }
 
     /*//! Called from C++
@@ -931,36 +1359,41 @@ public abstract class OffscreenView
             @Override
             public void run()
             {
-                Log.i(TAG, "setFocused(" + focused + ") " + object_name_ + ", show keyboard on focus: "
-                    + show_keyboard_on_focus_in_ + ": run");
-                final View v = getView();
-                if (v != null)
+                uiSetFocused(focused);
+            }
+        });
+    }
+
+    private void uiSetFocused(final boolean focused)
+    {
+        Log.i(TAG, "setFocused(" + focused + ") " + object_name_ + ", show keyboard on focus: "
+            + show_keyboard_on_focus_in_ + ": run");
+        final View v = getView();
+        if (v != null)
+        {
+            if (focused)
+            {
+                v.setFocusable(true);
+                v.setFocusableInTouchMode(true);
+                v.requestFocus();
+                if (show_keyboard_on_focus_in_)
                 {
-                    if (focused)
-                    {
-                        v.setFocusable(true);
-                        v.setFocusableInTouchMode(true);
-                        v.requestFocus();
-                        if (show_keyboard_on_focus_in_)
-                        {
-                            uiShowKeyboard();
-                        }
-                    }
-                    else
-                    {
-                        // boolean was_focused = v.isFocused();
-                        v.setFocusable(false);
-                        v.setFocusableInTouchMode(false);
-                        v.clearFocus();
-                        if (hide_keyboard_on_focus_loss_)
-                        {
-                            uiHideKeyboardFromView();
-                        }
-                    }
-                    invalidateOffscreenView();
+                    uiShowKeyboard();
                 }
             }
-        });
+            else
+            {
+                // boolean was_focused = v.isFocused();
+                v.setFocusable(false);
+                v.setFocusableInTouchMode(false);
+                v.clearFocus();
+                if (hide_keyboard_on_focus_loss_)
+                {
+                    uiHideKeyboardFromView();
+                }
+            }
+            invalidateOffscreenView();
+        }
     }
 
     /*!
@@ -1107,26 +1540,31 @@ public abstract class OffscreenView
             @Override
             public void run()
             {
-                synchronized (view_variables_mutex_)
-                {
-                    if (view_left_ != left || view_top_ != top)
-                    {
-                        view_left_ = left;
-                        view_top_ = top;
-                    }
-                    else
-                    {
-                        return;
-                    }
-                }
-                if (layout_ != null)
-                {
-                    layout_.requestLayout();
-                }
+                uiSetPosition(left, top);
             }
         });
     }
 
+    private void uiSetPosition(final int left, final int top)
+    {
+        synchronized (view_variables_mutex_)
+        {
+            if (view_left_ != left || view_top_ != top)
+            {
+                view_left_ = left;
+                view_top_ = top;
+            }
+            else
+            {
+                return;
+            }
+        }
+        if (layout_ != null)
+        {
+            layout_.requestLayout();
+        }
+    }
+
     public boolean isViewCreated()
     {
         return getView() != null;
@@ -1199,7 +1637,7 @@ public abstract class OffscreenView
         }
     }
     // C++ function called from Java to tell that the texture has new contents.
-    // abstract public native void nativeUpdate(long nativeptr);
+    // abstract public native void nativeUpdate(long nativeptr, long paint_started_ns, int dirty_left, int dirty_top, int dirty_right, int dirty_bottom);
 
     protected interface OffscreenRenderingSurface
     {
@@ -1217,7 +1655,8 @@ public abstract class OffscreenView
         //
         // Bitmap mode
         //
-        abstract public void setBitmaps(final Bitmap bitmap_a, final Bitmap bitmap_b);
+        //! Returns false if a bitmap being replaced is being painted on now.
+        abstract public boolean setBitmaps(final Bitmap bitmap_a, final Bitmap bitmap_b);
         abstract public int getQtPaintingTexture();
     }
 
@@ -1226,8 +1665,12 @@ public abstract class OffscreenView
         Bitmap bitmap_a_ = null;
         Bitmap bitmap_b_ = null;
         int draw_bitmap_ = 0;
+        // Bitmap between lockCanvas() and unlockCanvas(), or null
+        Bitmap painting_bitmap_ = null;
         boolean has_texture_ = false;
         int last_drawn_bitmap_ = -1;
+        // Reduces banding of gradients drawn on 16-bit bitmaps
+        final PaintFlagsDrawFilter dither_filter_ = new PaintFlagsDrawFilter(0, Paint.DITHER_FLAG);
 
         public OffscreenBitmapRenderingSurface()
         {
@@ -1245,7 +1688,13 @@ public abstract class OffscreenView
                 Bitmap bitmap = (draw_bitmap_ == 0)? bitmap_a_: bitmap_b_;
                 // Log.i(TAG, "lockCanvas: locking "+object_name_+" texture="+draw_bitmap_);
                 last_drawn_bitmap_ = draw_bitmap_;
-                return new Canvas(bitmap);
+                painting_bitmap_ = bitmap;
+                Canvas canvas = new Canvas(bitmap);
+                if (bitmap.getConfig() == Bitmap.Config.RGB_565)
+                {
+                    canvas.setDrawFilter(dither_filter_);
+                }
+                return canvas;
             }
         }
 
@@ -1254,12 +1703,14 @@ public abstract class OffscreenView
         {
             synchronized (texture_mutex_)
             {
+                painting_bitmap_ = null;
                 // Marking that we have a painted texture
                 has_texture_ = true;
                 synchronized (texture_transform_mutex_)
                 {
                     last_texture_width_ = last_painted_width_;
                     last_texture_height_ = last_painted_height_;
+                    last_texture_timestamp_ns_ = last_painted_timestamp_ns_;
                 }
             }
         }
@@ -1312,7 +1763,7 @@ public abstract class OffscreenView
         }
 
         @Override
-        public void setBitmaps(final Bitmap bitmap_a, final Bitmap bitmap_b)
+        public boolean setBitmaps(final Bitmap bitmap_a, final Bitmap bitmap_b)
         {
             synchronized (texture_mutex_)
             {
@@ -1325,6 +1776,7 @@ public abstract class OffscreenView
                     has_texture_ = false;
                     last_drawn_bitmap_ = -1;
                 }
+                return painting_bitmap_ == null || painting_bitmap_ == bitmap_a || painting_bitmap_ == bitmap_b;
             }
         }
     }
@@ -1410,6 +1862,7 @@ public abstract class OffscreenView
                     surface_texture_.getTransformMatrix(mtx_);
                     last_texture_width_ = last_painted_width_;
                     last_texture_height_ = last_painted_height_;
+                    last_texture_timestamp_ns_ = last_painted_timestamp_ns_;
                 }
                 return true;
             }
@@ -1444,8 +1897,9 @@ public abstract class OffscreenView
         }
 
         @Override
-        public void setBitmaps(final Bitmap bitmap_a, final Bitmap bitmap_b)
+        public boolean setBitmaps(final Bitmap bitmap_a, final Bitmap bitmap_b)
         {
+            return true;
         }
 
         @Override
@@ -1468,17 +1922,22 @@ public abstract class OffscreenView
             @Override
             public void run()
             {
-                final View v = getView();
-                if (v != null)
-                {
-                    Rect rect = new Rect();
-                    v.getWindowVisibleDisplayFrame(rect);
-                    nativeOnVisibleRect(getNativePtr(), rect.left, rect.top, rect.right, rect.bottom);
-                }
+                uiQueryVisibleRect();
             }
         });
     }
 
+    private void uiQueryVisibleRect()
+    {
+        final View v = getView();
+        if (v != null)
+        {
+            Rect rect = new Rect();
+            v.getWindowVisibleDisplayFrame(rect);
+            nativeOnVisibleRect(getNativePtr(), rect.left, rect.top, rect.right, rect.bottom);
+        }
+    }
+
     public void setSoftInputMode(final int mode)
     {
         final Activity a = getActivity();
@@ -1497,25 +1956,98 @@ public abstract class OffscreenView
             @Override
             public void run()
             {
-                final View v = getView();
-                if (v != null)
-                {
-                    v.setScrollX(x);
-                }
+                uiSetScrollX(x);
             }
         });
     }
 
+    private void uiSetScrollX(final int x)
+    {
+        final View v = getView();
+        if (v != null)
+        {
+            v.setScrollX(x);
+        }
+    }
+
     public void setScrollY(final int y)
     {
         runViewAction(new Runnable() {
             @Override
             public void run()
             {
-                final View v = getView();
-                if (v != null)
+                uiSetScrollY(y);
+            }
+        });
+    }
+
+    private void uiSetScrollY(final int y)
+    {
+        final View v = getView();
+        if (v != null)
+        {
+            v.setScrollY(y);
+        }
+    }
+
+    /*!
+     * Called from C++ with the commands buffered during a Qt frame: (opcode, a, b) for
+     * each command, see COMMAND_* constants. All commands are executed in one UI thread
+     * Runnable, in the order they have been recorded.
+     */
+    public void executeCommands(final int[] commands)
+    {
+        if (commands == null || commands.length < 3)
+        {
+            return;
+        }
+        // The flags are read by C++ thread, so set them right away like setVisible() / setEnabled() do.
+        for (int i = 0; i + 2 < commands.length; i += 3)
+        {
+            if (commands[i] == COMMAND_SET_VISIBLE)
+            {
+                last_visibility_ = commands[i + 1] != 0;
+            }
+            else if (commands[i] == COMMAND_SET_ENABLED)
+            {
+                last_enabled_ = commands[i + 1] != 0;
+            }
+        }
+        runViewAction(new Runnable() {
+            @Override
+            public void run()
+            {
+                for (int i = 0; i + 2 < commands.length; i += 3)
                 {
-                    v.setScrollY(y);
+                    final int a = commands[i + 1];
+                    final int b = commands[i + 2];
+                    switch (commands[i])
+                    {
+                        case COMMAND_SET_POSITION:
+                            uiSetPosition(a, b);
+                            break;
+                        case COMMAND_SET_VISIBLE:
+                            uiSetVisible();
+                            break;
+                        case COMMAND_SET_ENABLED:
+                            uiSetEnabled(a != 0);
+                            break;
+                        case COMMAND_SET_SCROLL_X:
+                            uiSetScrollX(a);
+                            break;
+                        case COMMAND_SET_SCROLL_Y:
+                            uiSetScrollY(a);
+                            break;
+                        case COMMAND_SET_FOCUSED:
+                            uiSetFocused(a != 0);
+                            break;
+                        case COMMAND_QUERY_VISIBLE_RECT:
+                            uiQueryVisibleRect();
+                            break;
+                        default:
+                            Log.e(TAG, "executeCommands: unknown command " + commands[i] + " for " + object_name_);
+                            break;
+                    }
                 }
             }
         });
@@ -1552,8 +2084,9 @@ public abstract class OffscreenView
         }
     }
 
-    public native void nativeUpdate(long nativeptr);
+    public native void nativeUpdate(long nativeptr, long paint_started_ns, int dirty_left, int dirty_top, int dirty_right, int dirty_bottom);
     public native Activity getActivity();
     public native void nativeViewCreated(long nativeptr);
     public native void nativeOnVisibleRect(long nativeptr, int left, int top, int right, int bottom);
+    public static native void nativeOnTrimMemory(int level);
 }
@@ -36,6 +36,8 @@
 
 package ru.dublgis.offscreenview;
 
+import java.io.InputStream;
+import java.nio.ByteBuffer;
 import java.util.Map;
 import java.util.HashMap;
 import android.content.Context;
@@ -46,6 +48,7 @@ import android.os.Message;
 import android.view.View;
 import android.view.KeyEvent;
 import android.view.MotionEvent;
+import android.webkit.ValueCallback;
 import android.webkit.WebView;
 import android.webkit.WebViewClient;
 import android.webkit.WebChromeClient;
@@ -59,6 +62,85 @@ import ru.dublgis.androidhelpers.Log;
 
 class OffscreenWebView extends OffscreenView
 {
+    /*!
+     * Stream which reads a direct ByteBuffer pointing to C++ memory. The memory is
+     * owned by C++ and released when the stream is closed (or garbage-collected).
+     */
+    private static class NativeBufferInputStream extends InputStream
+    {
+        private ByteBuffer buffer_;
+        private long holder_;
+
+        NativeBufferInputStream(final ByteBuffer buffer, final long holder)
+        {
+            buffer_ = buffer;
+            holder_ = holder;
+        }
+
+        @Override
+        public synchronized int available()
+        {
+            return (buffer_ != null)? buffer_.remaining(): 0;
+        }
+
+        @Override
+        public synchronized int read()
+        {
+            if (buffer_ == null || !buffer_.hasRemaining())
+            {
+                return -1;
+            }
+            return buffer_.get() & 0xFF;
+        }
+
+        @Override
+        public synchronized int read(byte[] b, int off, int len)
+        {
+            if (len == 0)
+            {
+                return 0;
+            }
+            if (buffer_ == null || !buffer_.hasRemaining())
+            {
+                return -1;
+            }
+            final int count = Math.min(len, buffer_.remaining());
+            buffer_.get(b, off, count);
+            return count;
+        }
+
+        @Override
+        public synchronized void close()
+        {
+            buffer_ = null;
+            if (holder_ != 0)
+            {
+                releaseResourceBuffer(holder_);
+                holder_ = 0;
+            }
+        }
+
+        @Override
+        protected void finalize() throws Throwable
+        {
+            try
+            {
+                close();
+            }
+            finally
+            {
+                super.finalize();
+            }
+        }
+    }
+
+    // Header sets of loadUrl() by ids given by C++.
+    private HashMap<Integer, Map<String, String>> header_sets_ = new HashMap<Integer, Map<String, String>>();  // threads: ui
+
+    // Set by resetForReuse(): history is cleared once about:blank is loaded, because
+    // WebView.clearHistory() keeps the current entry which is still the old page.
+    private boolean clear_history_on_blank_ = false;  // threads: ui
+
     // http://developer.android.com/reference/android/webkit/WebView.html
     class MyWebView extends WebView
     {
@@ -71,7 +153,15 @@ class OffscreenWebView extends OffscreenView
             @Override
             public void onLoadResource(WebView view, String url) { OffscreenWebView.this.onLoadResource(getNativePtr(), url); }
             @Override
-            public void onPageFinished(WebView view, String url) { OffscreenWebView.this.onPageFinished(getNativePtr(), url); }
+            public void onPageFinished(WebView view, String url)
+            {
+                if (clear_history_on_blank_ && "about:blank".equals(url))
+                {
+                    clear_history_on_blank_ = false;
+                    view.clearHistory();
+                }
+                OffscreenWebView.this.onPageFinished(getNativePtr(), url);
+            }
             @Override
             public void onPageStarted(WebView view, String url, Bitmap favicon) { OffscreenWebView.this.onPageStarted(getNativePtr(), url, favicon); }
             @Override
@@ -204,7 +294,7 @@ class OffscreenWebView extends OffscreenView
         {
             Log.i(TAG, "MyWebView.invalidate(Rect dirty)");
             super.invalidate(dirty);
-            invalidateOffscreenView();
+            invalidateOffscreenView(dirty.left, dirty.top, dirty.right, dirty.bottom);
         }
 
         // Old WebKit updating here
@@ -222,7 +312,7 @@ class OffscreenWebView extends OffscreenView
                 // Log.i(TAG, "MyWebView.invalidate: ignoring invisible rectangle");
                 return;
             }
-            invalidateOffscreenView();
+            invalidateOffscreenView(l, t, r, b);
         }
 
         // Old & new WebKit updating
@@ -323,6 +413,24 @@ class OffscreenWebView extends OffscreenView
         });
     }
 
+    // From C++: forget everything left by the previous user of a pooled view.
+    public void resetForReuse()
+    {
+        runViewAction(new Runnable() {
+            @Override
+            public void run()
+            {
+                MyWebView wv = (MyWebView)getView();
+                header_sets_.clear();
+                wv.stopLoading();
+                wv.clearFormData();
+                wv.clearHistory();
+                clear_history_on_blank_ = true;
+                wv.loadUrl("about:blank");
+            }
+        });
+    }
+
     // From C++
     public void setWebContentsDebuggingEnabled(final boolean value)
     {
@@ -336,16 +444,10 @@ class OffscreenWebView extends OffscreenView
         });
     }
 
-    // From C++
-    /*!
-     * \param additionalHttpHeaders contains additional HTTP headers in this format:
-     * header1\n
-     * value\1n
-     * header2\n
-     * value2\n
-     * ...
-     */
-    public void loadUrl(final String url, final String additionalHttpHeaders)
+    // From C++: load URL with a header set which has not been sent before; the set is cached
+    // under the id given by C++ and the set with evicted_id (if not 0) is dropped.
+    // The headers array contains names and values interleaved.
+    public void loadUrlWithNewHeaderSet(final String url, final int id, final int evicted_id, final String[] headers)
     {
         Log.i(TAG, "loadUrl: scheduling");
         runViewAction(new Runnable() {
@@ -353,11 +455,35 @@ class OffscreenWebView extends OffscreenView
             public void run()
             {
                 Log.i(TAG, "loadUrl: RUN");
+                if (evicted_id != 0)
+                {
+                    header_sets_.remove(evicted_id);
+                }
                 Map<String, String> ma = new HashMap<String, String>();
-                String[] parts = additionalHttpHeaders.split("\n");
-                for (int i = 0, h = 0, v = 1; i < parts.length / 2; i++, h += 2, v += 2)
+                for (int i = 0; i + 1 < headers.length; i += 2)
                 {
-                    ma.put(parts[h], parts[v]);
+                    ma.put(headers[i], headers[i + 1]);
+                }
+                header_sets_.put(id, ma);
+                ((MyWebView)getView()).loadUrl(url, ma);
+            }
+        });
+    }
+
+    // From C++: load URL with a header set cached by loadUrlWithNewHeaderSet().
+    public void loadUrlWithHeaderSet(final String url, final int id)
+    {
+        Log.i(TAG, "loadUrl: scheduling");
+        runViewAction(new Runnable() {
+            @Override
+            public void run()
+            {
+                Log.i(TAG, "loadUrl: RUN");
+                Map<String, String> ma = header_sets_.get(id);
+                if (ma == null)
+                {
+                    Log.e(TAG, "loadUrl: unknown header set " + id);
+                    ma = new HashMap<String, String>();
                 }
                 ((MyWebView)getView()).loadUrl(url, ma);
             }
@@ -477,6 +603,46 @@ class OffscreenWebView extends OffscreenView
         });
     }
 
+    // From C++: evaluate a batch of scripts in one UI thread runnable and report
+    // all results in one onJavascriptResults() call when the last one is done.
+    public void evaluateJavascriptBatch(final int[] ids, final String[] scripts)
+    {
+        runViewAction(new Runnable() {
+            @Override
+            public void run()
+            {
+                final MyWebView wv = (MyWebView)getView();
+                final String[] results = new String[scripts.length];
+                if (getApiLevel() < 19)
+                {
+                    // No evaluateJavascript() and no results on old Androids.
+                    for (int i = 0; i < scripts.length; ++i)
+                    {
+                        wv.loadUrl("javascript:" + scripts[i]);
+                    }
+                    onJavascriptResults(getNativePtr(), ids, results);
+                    return;
+                }
+                final int[] remaining = new int[] { scripts.length };
+                for (int i = 0; i < scripts.length; ++i)
+                {
+                    final int index = i;
+                    wv.evaluateJavascript(scripts[i], new ValueCallback<String>() {
+                        @Override
+                        public void onReceiveValue(String value)
+                        {
+                            results[index] = value;
+                            if (--remaining[0] == 0)
+                            {
+                                onJavascriptResults(getNativePtr(), ids, results);
+                            }
+                        }
+                    });
+                }
+            }
+        });
+    }
+
     // WebViewClient
     public native void doUpdateVisitedHistory(long nativeptr, String url, boolean isReload);
     public native void onFormResubmission(long nativeptr, Message dontResend, Message resend);
@@ -491,9 +657,16 @@ class OffscreenWebView extends OffscreenView
     public native void onTooManyRedirects(long nativeptr, Message cancelMsg, Message continueMsg);
     public native void onUnhandledKeyEvent(long nativeptr, KeyEvent event);
     public native WebResourceResponse shouldInterceptRequest(long nativeptr, String url);
+    public static native void releaseResourceBuffer(long holder);
     public native boolean shouldOverrideKeyEvent(long nativeptr, KeyEvent event);
     public native boolean shouldOverrideUrlLoading(long nativeptr, String url);
 
+    //! Called from C++ shouldInterceptRequest() to pass a resource from C++ memory to WebView. The data may be null.
+    public WebResourceResponse createNativeResourceResponse(final String mime_type, final String encoding, final ByteBuffer data, final long holder)
+    {
+        return new WebResourceResponse(mime_type, encoding, new NativeBufferInputStream(data, holder));
+    }
+
     // WebChromeClient
     public native void onProgressChanged(long nativeptr, WebView view, int newProgress);
 
@@ -502,5 +675,6 @@ class OffscreenWebView extends OffscreenView
     public native void onCanGoBackReceived(long nativeptr, boolean can);
     public native void onCanGoForwardReceived(long nativeptr, boolean can);
     public native void onCanGoBackOrForwardReceived(long nativeptr, boolean can, int steps);
+    public native void onJavascriptResults(long nativeptr, int[] ids, String[] results);
 }
 
@@ -0,0 +1,204 @@
+/*
+  Offscreen Android Views library for Qt
+
+  Author:
+  Sergey A. Galin <sergey.galin@gmail.com>
+
+  Distrbuted under The BSD License
+
+  Copyright (c) 2014, DoubleGIS, LLC.
+  All rights reserved.
+
+  Redistribution and use in source and binary forms, with or without
+  modification, are permitted provided that the following conditions are met:
+
+  * Redistributions of source code must retain the above copyright notice,
+    this list of conditions and the following disclaimer.
+  * Redistributions in binary form must reproduce the above copyright notice,
+    this list of conditions and the following disclaimer in the documentation
+    and/or other materials provided with the distribution.
+  * Neither the name of the DoubleGIS, LLC nor the names of its contributors
+    may be used to endorse or promote products derived from this software
+    without specific prior written permission.
+
+  THIS SOFTWARE IS PROVIDED BY THE COPYRIGHT HOLDERS AND CONTRIBUTORS "AS IS"
+  AND ANY EXPRESS OR IMPLIED WARRANTIES, INCLUDING, BUT NOT LIMITED TO,
+  THE IMPLIED WARRANTIES OF MERCHANTABILITY AND FITNESS FOR A PARTICULAR PURPOSE
+  ARE DISCLAIMED. IN NO EVENT SHALL THE COPYRIGHT HOLDER OR CONTRIBUTORS
+  BE LIABLE FOR ANY DIRECT, INDIRECT, INCIDENTAL, SPECIAL, EXEMPLARY, OR
+  CONSEQUENTIAL DAMAGES (INCLUDING, BUT NOT LIMITED TO, PROCUREMENT OF
+  SUBSTITUTE GOODS OR SERVICES; LOSS OF USE, DATA, OR PROFITS; OR BUSINESS
+  INTERRUPTION) HOWEVER CAUSED AND ON ANY THEORY OF LIABILITY, WHETHER IN
+  CONTRACT, STRICT LIABILITY, OR TORT (INCLUDING NEGLIGENCE OR OTHERWISE)
+  ARISING IN ANY WAY OUT OF THE USE OF THIS SOFTWARE, EVEN IF ADVISED OF
+  THE POSSIBILITY OF SUCH DAMAGE.
+*/
+
+/*
+ * Host test of QAndroidJniNativesRegistry: a fake JNIEnv counts RegisterNatives calls.
+ */
+
+#include <pthread.h>
+#include <stdio.h>
+#include <string.h>
+#include <jni.h>
+#include "QAndroidJniNativesRegistry.h"
+
+static int s_failures = 0;
+
+#define CHECK(condition) \
+	do { \
+		if (!(condition)) \
+		{ \
+			fprintf(stderr, "%s:%d: CHECK failed: %s\n", __FILE__, __LINE__, #condition); \
+			++s_failures; \
+		} \
+	} while (0)
+
+static pthread_mutex_t s_fake_mutex = PTHREAD_MUTEX_INITIALIZER;
+static int s_register_natives_calls = 0;
+static jint s_register_natives_result = 0;
+static jboolean s_throw_exception = JNI_FALSE;
+static jboolean s_pending_exception = JNI_FALSE;
+
+static jint JNICALL fakeRegisterNatives(JNIEnv *, jclass, const JNINativeMethod *, jint)
+{
+	pthread_mutex_lock(&s_fake_mutex);
+	++s_register_natives_calls;
+	s_pending_exception = s_throw_exception;
+	jint result = s_register_natives_result;
+	pthread_mutex_unlock(&s_fake_mutex);
+	return result;
+}
+
+static jboolean JNICALL fakeExceptionCheck(JNIEnv *)
+{
+	return s_pending_exception;
+}
+
+static void JNICALL fakeExceptionClear(JNIEnv *)
+{
+	s_pending_exception = JNI_FALSE;
+}
+
+static int registerNativesCalls()
+{
+	pthread_mutex_lock(&s_fake_mutex);
+	int result = s_register_natives_calls;
+	pthread_mutex_unlock(&s_fake_mutex);
+	return result;
+}
+
+static JNINativeInterface_ s_fake_interface;
+static JNIEnv s_fake_env;
+// Any non-null value will do, the fake never dereferences it.
+static jclass const s_fake_class = reinterpret_cast<jclass>(&s_fake_env);
+
+static void initFakeEnv()
+{
+	memset(&s_fake_interface, 0, sizeof(s_fake_interface));
+	s_fake_interface.RegisterNatives = fakeRegisterNatives;
+	s_fake_interface.ExceptionCheck = fakeExceptionCheck;
+	s_fake_interface.ExceptionClear = fakeExceptionClear;
+	s_fake_env.functions = &s_fake_interface;
+}
+
+static void JNICALL nativeStub(JNIEnv *, jobject)
+{
+}
+
+static JNINativeMethod s_methods[] = {
+	{const_cast<char*>("nativeStub"), const_cast<char*>("()V"), reinterpret_cast<void*>(nativeStub)},
+};
+
+static bool registerStub(const char * class_name)
+{
+	return QAndroidJniNativesRegistry::registerNatives(&s_fake_env, s_fake_class, class_name, s_methods, 1);
+}
+
+static void testRegistersOncePerClass()
+{
+	int calls = registerNativesCalls();
+	CHECK(!QAndroidJniNativesRegistry::isRegistered("test/EditText"));
+	// E.g. a screen with a lot of text fields
+	for (int i = 0; i < 50; ++i)
+	{
+		CHECK(registerStub("test/EditText"));
+	}
+	CHECK(registerNativesCalls() == calls + 1);
+	CHECK(QAndroidJniNativesRegistry::isRegistered("test/EditText"));
+
+	CHECK(registerStub("test/WebView"));
+	CHECK(registerStub("test/WebView"));
+	CHECK(registerNativesCalls() == calls + 2);
+}
+
+static void testFailureIsRetried()
+{
+	int calls = registerNativesCalls();
+	s_register_natives_result = -1;
+	CHECK(!registerStub("test/Failing"));
+	CHECK(!QAndroidJniNativesRegistry::isRegistered("test/Failing"));
+	s_register_natives_result = 0;
+	s_throw_exception = JNI_TRUE;
+	CHECK(!registerStub("test/Failing"));
+	CHECK(s_pending_exception == JNI_FALSE); // Cleared by the registry
+	s_throw_exception = JNI_FALSE;
+	CHECK(registerStub("test/Failing"));
+	CHECK(registerStub("test/Failing"));
+	CHECK(registerNativesCalls() == calls + 3);
+}
+
+static void testNullArguments()
+{
+	int calls = registerNativesCalls();
+	CHECK(!QAndroidJniNativesRegistry::registerNatives(0, s_fake_class, "test/NullEnv", s_methods, 1));
+	CHECK(!QAndroidJniNativesRegistry::registerNatives(&s_fake_env, 0, "test/NullClass", s_methods, 1));
+	CHECK(!QAndroidJniNativesRegistry::registerNatives(&s_fake_env, s_fake_class, 0, s_methods, 1));
+	CHECK(registerNativesCalls() == calls);
+	// A registered class doesn't need the class object anymore
+	CHECK(registerStub("test/Registered"));
+	CHECK(QAndroidJniNativesRegistry::registerNatives(0, 0, "test/Registered", s_methods, 1));
+	CHECK(registerNativesCalls() == calls + 1);
+}
+
+static void * registerFromThread(void *)
+{
+	for (int i = 0; i < 100; ++i)
+	{
+		CHECK(registerStub("test/Concurrent"));
+	}
+	return 0;
+}
+
+static void testConcurrentRegistration()
+{
+	int calls = registerNativesCalls();
+	static const int c_threads = 8;
+	pthread_t threads[c_threads];
+	for (int i = 0; i < c_threads; ++i)
+	{
+		CHECK(pthread_create(&threads[i], 0, registerFromThread, 0) == 0);
+	}
+	for (int i = 0; i < c_threads; ++i)
+	{
+		pthread_join(threads[i], 0);
+	}
+	CHECK(registerNativesCalls() == calls + 1);
+}
+
+int main()
+{
+	initFakeEnv();
+	testRegistersOncePerClass();
+	testFailureIsRetried();
+	testNullArguments();
+	testConcurrentRegistration();
+	if (s_failures)
+	{
+		fprintf(stderr, "tst_QAndroidJniNativesRegistry: %d check(s) failed\n", s_failures);
+		return 1;
+	}
+	printf("tst_QAndroidJniNativesRegistry: OK (%d RegisterNatives calls)\n", registerNativesCalls());
+	return 0;
+}
@@ -0,0 +1,15 @@
+# Host test: built with the desktop compiler, needs only jni.h of a JDK.
+#   JAVA_HOME=/path/to/jdk qmake && make check
+
+TEMPLATE = app
+TARGET = tst_QAndroidJniNativesRegistry
+CONFIG += console testcase
+CONFIG -= qt app_bundle
+
+INCLUDEPATH += $$(JAVA_HOME)/include $$(JAVA_HOME)/include/linux ../..
+LIBS += -lpthread
+
+HEADERS += ../../QAndroidJniNativesRegistry.h
+SOURCES += \
+    tst_QAndroidJniNativesRegistry.cpp \
+    ../../QAndroidJniNativesRegistry.cpp
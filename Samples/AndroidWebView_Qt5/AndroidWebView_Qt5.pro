@@ -23,10 +23,15 @@ SOURCES += \
     ../../QtOffscreenViews/QAndroidOffscreenView.cpp \
     ../../QtOffscreenViews/QAndroidOffscreenWebView.cpp \
     ../../QtOffscreenViews/QOpenGLTextureHolder.cpp \
+    ../../QtOffscreenViews/QOpenGLTextureAtlas.cpp \
 	../../QJniHelpers/QAndroidQPAPluginGap.cpp \
     ../../QtOffscreenViews/QAndroidOffscreenEditText.cpp \
 	../../QJniHelpers/QJniHelpers.cpp \
     ../../QtOffscreenViews/QAndroidJniImagePair.cpp \
+    ../../QtOffscreenViews/QAndroidJniBitmapPool.cpp \
+    ../../QtOffscreenViews/QAndroidOffscreenViewPool.cpp \
+    ../../QtOffscreenViews/QAndroidJniNativesRegistry.cpp \
+    ../../QtOffscreenViews/QAndroidWebResourceResolver.cpp \
     ../../QtOffscreenViews/QQuickViews/QQuickAndroidOffscreenView.cpp \
     ../../QtOffscreenViews/QQuickViews/QQuickOffscreenEditText.cpp \
     ../../QtOffscreenViews/QQuickViews/QQuickOffscreenWebView.cpp \
@@ -35,10 +40,15 @@ HEADERS += \
     ../../QtOffscreenViews/QAndroidOffscreenView.h \
     ../../QtOffscreenViews/QAndroidOffscreenWebView.h \
     ../../QtOffscreenViews/QOpenGLTextureHolder.h \
+    ../../QtOffscreenViews/QOpenGLTextureAtlas.h \
 	../../QJniHelpers/QAndroidQPAPluginGap.h \
     ../../QtOffscreenViews/QAndroidOffscreenEditText.h \
 	../../QJniHelpers/QJniHelpers.h \
     ../../QtOffscreenViews/QAndroidJniImagePair.h \
+    ../../QtOffscreenViews/QAndroidJniBitmapPool.h \
+    ../../QtOffscreenViews/QAndroidOffscreenViewPool.h \
+    ../../QtOffscreenViews/QAndroidJniNativesRegistry.h \
+    ../../QtOffscreenViews/QAndroidWebResourceResolver.h \
     ../../QtOffscreenViews/QQuickViews/QQuickAndroidOffscreenView.h \
     ../../QtOffscreenViews/QQuickViews/QQuickOffscreenEditText.h \
     ../../QtOffscreenViews/QQuickViews/QQuickOffscreenWebView.h \